@@ -0,0 +1,2160 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Each node carries its level instead of a color: leaves are on
+   level one, a left child is one level below its parent and a right
+   child is on the same level or one below, but never two right
+   links in a row on the same level.
+   The subtree size is not part of the node: trees that keep sizes
+   store it right behind the node, see __size_slot. A node takes 48
+   bytes on 64-bit targets, 56 with a subtree size.
+*/
+typedef struct __tree_node_struct_t *tree_node_t;
+struct __tree_node_struct_t
+{
+  void *key;
+  void *value;
+  tree_node_t parent;
+  tree_node_t left;
+  tree_node_t right;
+  size_t level;
+};
+
+/* Subtree size of a node of a ranked tree, stored right behind the
+   node and before its inline entry, if any.
+*/
+static inline size_t *__size_slot(tree_node_t node)
+{
+  return (size_t *)(node + 1);
+}
+
+#define AA_TREE_DEFAULT_NODES_PER_SLAB ((size_t)1024)
+
+/* Number of lookups aa_tree_search_batch advances in lockstep. */
+#define AA_TREE_SEARCH_GROUP ((size_t)16)
+
+#if defined(__GNUC__)
+#define __prefetch(address) __builtin_prefetch(address)
+#else
+#define __prefetch(address) ((void)(address))
+#endif
+
+typedef struct __node_slab_struct_t *node_slab_t;
+struct __node_slab_struct_t
+{
+  node_slab_t next;
+  size_t capacity;
+  size_t used;
+  struct __tree_node_struct_t nodes[];
+};
+
+typedef struct __node_arena_struct_t *node_arena_t;
+struct __node_arena_struct_t
+{
+  node_slab_t slabs;
+  tree_node_t free_list;
+  size_t node_size;
+  size_t nodes_per_slab;
+  size_t number_slabs;
+  size_t nodes_reserved;
+  size_t nodes_in_use;
+};
+
+struct __aa_tree_struct_t
+{
+  tree_node_t root;
+  node_arena_t arena;
+  size_t number_entries;
+  int ranked;
+  int inline_entries;
+  size_t key_size;
+  size_t value_size;
+};
+
+#include "aatrees.h"
+
+static size_t __size(tree_node_t node)
+{
+  return (node == NULL) ? ((size_t)0) : *__size_slot(node);
+}
+
+/* Rounds a byte count up so that whatever follows stays aligned
+   like a node.
+*/
+static size_t __align_up(size_t n)
+{
+  size_t a = sizeof(void *);
+  return ((n + a - ((size_t)1)) / a) * a;
+}
+
+static node_arena_t __node_arena_create(size_t nodes_per_slab, size_t node_size)
+{
+  node_arena_t arena;
+  arena = calloc(1, sizeof(*arena));
+  if (arena == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  if (nodes_per_slab == ((size_t)0))
+    nodes_per_slab = AA_TREE_DEFAULT_NODES_PER_SLAB;
+  arena->slabs = NULL;
+  arena->free_list = NULL;
+  arena->node_size = node_size;
+  arena->nodes_per_slab = nodes_per_slab;
+  return arena;
+}
+
+static void __node_arena_delete(node_arena_t arena)
+{
+  node_slab_t slab, next;
+  for (slab = arena->slabs; slab != NULL; slab = next)
+  {
+    next = slab->next;
+    free(slab);
+  }
+  free(arena);
+}
+
+/* Forgets every node of the arena. The largest slab is kept for
+   reuse, the others are released.
+*/
+static void __node_arena_reset(node_arena_t arena)
+{
+  node_slab_t slab, next, keep;
+
+  keep = arena->slabs;
+  for (slab = arena->slabs; slab != NULL; slab = slab->next)
+  {
+    if (slab->capacity > keep->capacity)
+      keep = slab;
+  }
+  for (slab = arena->slabs; slab != NULL; slab = next)
+  {
+    next = slab->next;
+    if (slab != keep)
+      free(slab);
+  }
+
+  arena->slabs = keep;
+  arena->free_list = NULL;
+  arena->number_slabs = (size_t)0;
+  arena->nodes_reserved = (size_t)0;
+  arena->nodes_in_use = (size_t)0;
+  if (keep != NULL)
+  {
+    keep->next = NULL;
+    keep->used = (size_t)0;
+    arena->number_slabs = (size_t)1;
+    arena->nodes_reserved = keep->capacity;
+  }
+}
+
+/* Adds a slab of capacity nodes in front of the slab list, so that
+   the next allocations are carved from it.
+*/
+static node_slab_t __node_arena_grow(node_arena_t arena, size_t capacity)
+{
+  node_slab_t slab;
+  slab = malloc(sizeof(*slab) + capacity * arena->node_size);
+  if (slab == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  slab->next = arena->slabs;
+  slab->capacity = capacity;
+  slab->used = (size_t)0;
+  arena->slabs = slab;
+  arena->number_slabs++;
+  arena->nodes_reserved += capacity;
+  return slab;
+}
+
+static tree_node_t __node_arena_alloc(node_arena_t arena)
+{
+  node_slab_t slab;
+  tree_node_t node;
+
+  if (arena->free_list != NULL)
+  {
+    // Reuse a node released by a previous remove.
+    node = arena->free_list;
+    arena->free_list = node->left;
+    arena->nodes_in_use++;
+    return node;
+  }
+
+  slab = arena->slabs;
+  if ((slab == NULL) || (slab->used >= slab->capacity))
+    slab = __node_arena_grow(arena, arena->nodes_per_slab);
+
+  node = (tree_node_t)(((unsigned char *)slab->nodes) + slab->used * arena->node_size);
+  slab->used++;
+  arena->nodes_in_use++;
+  return node;
+}
+
+static void __node_arena_free(node_arena_t arena, tree_node_t node)
+{
+  node->left = arena->free_list;
+  arena->free_list = node;
+  arena->nodes_in_use--;
+}
+
+/* Bytes a node of the tree takes: the node, then its subtree size if
+   the tree is ranked, then its inline key and value if any.
+*/
+static size_t __aa_tree_node_size(aa_tree_t tree)
+{
+  size_t node_size;
+
+  node_size = sizeof(struct __tree_node_struct_t);
+  if (tree->ranked)
+    node_size += sizeof(size_t);
+  if (tree->inline_entries)
+    node_size += __align_up(tree->key_size) + __align_up(tree->value_size);
+  return node_size;
+}
+
+static tree_node_t __aa_tree_node_alloc(aa_tree_t tree)
+{
+  tree_node_t node;
+
+  if (tree->arena != NULL)
+    return __node_arena_alloc(tree->arena);
+
+  node = calloc(1, __aa_tree_node_size(tree));
+  if (node == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  return node;
+}
+
+static void __aa_tree_node_free(aa_tree_t tree, tree_node_t node)
+{
+  if (tree->arena != NULL)
+  {
+    __node_arena_free(tree->arena, node);
+    return;
+  }
+  free(node);
+}
+
+aa_tree_t aa_tree_create()
+{
+  aa_tree_t tree;
+  tree = calloc(1, sizeof(*tree));
+  if (tree == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  tree->root = NULL;
+  tree->arena = NULL;
+  tree->number_entries = (size_t)0;
+  tree->ranked = 0;
+  tree->inline_entries = 0;
+  tree->key_size = (size_t)0;
+  tree->value_size = (size_t)0;
+  return tree;
+}
+
+aa_tree_t aa_tree_create_with_allocator(size_t nodes_per_slab)
+{
+  aa_tree_t tree;
+  tree = aa_tree_create();
+  tree->arena = __node_arena_create(nodes_per_slab, __aa_tree_node_size(tree));
+  return tree;
+}
+
+aa_tree_t aa_tree_create_inline(size_t key_size,
+                                size_t value_size,
+                                size_t nodes_per_slab)
+{
+  aa_tree_t tree;
+
+  tree = aa_tree_create();
+  tree->inline_entries = 1;
+  tree->key_size = key_size;
+  tree->value_size = value_size;
+  tree->arena = __node_arena_create(nodes_per_slab, __aa_tree_node_size(tree));
+  return tree;
+}
+
+/* Points the key and value of a node of an inline tree at the
+   storage behind the node and its subtree size.
+*/
+static void __aa_tree_inline_entry(aa_tree_t tree, tree_node_t node)
+{
+  node->key = (void *)(node + 1);
+  if (tree->ranked)
+    node->key = (void *)(((unsigned char *)node->key) + sizeof(size_t));
+  node->value = (void *)(((unsigned char *)node->key) + __align_up(tree->key_size));
+}
+
+/* Stores a key and a value in a fresh node, either by copying them
+   into the node's inline storage or through the copy functions.
+*/
+static void __aa_tree_store_entry(aa_tree_t tree,
+                                  tree_node_t node,
+                                  void *key,
+                                  void *value,
+                                  void *(*copy_key)(void *, void *),
+                                  void *(*copy_value)(void *, void *),
+                                  void *data)
+{
+  if (tree->inline_entries)
+  {
+    __aa_tree_inline_entry(tree, node);
+    memcpy(node->key, key, tree->key_size);
+    memcpy(node->value, value, tree->value_size);
+    return;
+  }
+  node->key = copy_key(key, data);
+  node->value = copy_value(value, data);
+}
+
+static void __aa_tree_release_entry(aa_tree_t tree,
+                                    tree_node_t node,
+                                    void (*delete_key)(void *, void *),
+                                    void (*delete_value)(void *, void *),
+                                    void *data)
+{
+  if (tree->inline_entries)
+    return;
+  if (delete_key != NULL)
+    delete_key(node->key, data);
+  if (delete_value != NULL)
+    delete_value(node->value, data);
+}
+
+void aa_tree_allocator_stats(aa_tree_allocator_stats_t *stats,
+                             aa_tree_t tree)
+{
+  node_arena_t arena = tree->arena;
+
+  stats->node_size = __aa_tree_node_size(tree);
+  if (arena == NULL)
+  {
+    stats->number_slabs = (size_t)0;
+    stats->nodes_per_slab = (size_t)0;
+    stats->nodes_reserved = (size_t)0;
+    stats->nodes_in_use = (size_t)0;
+    stats->nodes_free = (size_t)0;
+    stats->bytes_reserved = (size_t)0;
+    return;
+  }
+  stats->number_slabs = arena->number_slabs;
+  stats->nodes_per_slab = arena->nodes_per_slab;
+  stats->nodes_reserved = arena->nodes_reserved;
+  stats->nodes_in_use = arena->nodes_in_use;
+  stats->nodes_free = arena->nodes_reserved - arena->nodes_in_use;
+  stats->bytes_reserved = arena->number_slabs * sizeof(struct __node_slab_struct_t) +
+                          arena->nodes_reserved * arena->node_size;
+}
+
+static size_t __floor_log2(size_t n);
+
+static tree_node_t __aa_tree_build_aux(aa_tree_t tree,
+                                       void **keys,
+                                       void **values,
+                                       size_t lo,
+                                       size_t hi,
+                                       tree_node_t parent,
+                                       void *(*copy_key)(void *, void *),
+                                       void *(*copy_value)(void *, void *),
+                                       void *data)
+{
+  tree_node_t node;
+  size_t mid;
+
+  if (lo >= hi)
+    return NULL;
+
+  mid = lo + (hi - lo - ((size_t)1)) / ((size_t)2);
+  node = __node_arena_alloc(tree->arena);
+  __aa_tree_store_entry(tree, node, keys[mid], values[mid], copy_key, copy_value, data);
+  node->parent = parent;
+  if (tree->ranked)
+    *__size_slot(node) = hi - lo;
+  node->level = __floor_log2(hi - lo + ((size_t)1));
+  node->left = __aa_tree_build_aux(tree, keys, values, lo, mid,
+                                   node, copy_key, copy_value, data);
+  node->right = __aa_tree_build_aux(tree, keys, values, mid + ((size_t)1), hi,
+                                    node, copy_key, copy_value, data);
+  return node;
+}
+
+aa_tree_t aa_tree_build_sorted(void **keys,
+                               void **values,
+                               size_t n,
+                               void *(*copy_key)(void *, void *),
+                               void *(*copy_value)(void *, void *),
+                               void *data)
+{
+  aa_tree_t tree;
+
+  tree = aa_tree_create_with_allocator((size_t)0);
+  if (n == ((size_t)0))
+    return tree;
+  __node_arena_grow(tree->arena, n);
+
+  /* Splitting every range of s entries at its lower middle leaves
+     floor((s - 1) / 2) entries on the left and floor(s / 2) on the
+     right. Giving such a subtree the level floor(log2(s + 1)) puts
+     the left child exactly one level lower, the right child one
+     level lower or on the same level, and the right grandchild
+     always lower, as the AA properties require.
+  */
+  tree->root = __aa_tree_build_aux(tree, keys, values, (size_t)0, n,
+                                   NULL, copy_key, copy_value, data);
+  tree->number_entries = n;
+  return tree;
+}
+
+static void left_rotate(aa_tree_t tree, tree_node_t x);
+static void right_rotate(aa_tree_t tree, tree_node_t y);
+
+/* Releases all entries of a tree, leaving it empty. Runs in O(n)
+   with constant extra memory: the walk goes down to a leaf, unhooks
+   it from its parent and climbs back through the parent pointer.
+*/
+static void __aa_tree_clear_aux(aa_tree_t tree,
+                                void (*delete_key)(void *, void *),
+                                void (*delete_value)(void *, void *),
+                                void *data)
+{
+  tree_node_t node, parent;
+
+  // Nothing to do per node if the arena takes the nodes back at once.
+  if ((tree->arena != NULL) &&
+      (tree->inline_entries || ((delete_key == NULL) && (delete_value == NULL))))
+  {
+    __node_arena_reset(tree->arena);
+    tree->root = NULL;
+    tree->number_entries = (size_t)0;
+    return;
+  }
+
+  node = tree->root;
+  while (node != NULL)
+  {
+    if (node->left != NULL)
+    {
+      node = node->left;
+    }
+    else if (node->right != NULL)
+    {
+      node = node->right;
+    }
+    else
+    {
+      parent = node->parent;
+      if (parent != NULL)
+      {
+        if (parent->left == node)
+          parent->left = NULL;
+        else
+          parent->right = NULL;
+      }
+      __aa_tree_release_entry(tree, node, delete_key, delete_value, data);
+      if (tree->arena == NULL)
+        free(node);
+      node = parent;
+    }
+  }
+
+  if (tree->arena != NULL)
+    __node_arena_reset(tree->arena);
+  tree->root = NULL;
+  tree->number_entries = (size_t)0;
+}
+
+void aa_tree_delete(aa_tree_t tree,
+                    void (*delete_key)(void *, void *),
+                    void (*delete_value)(void *, void *),
+                    void *data)
+{
+  __aa_tree_clear_aux(tree, delete_key, delete_value, data);
+  if (tree->arena != NULL)
+    __node_arena_delete(tree->arena);
+  free(tree);
+}
+
+void aa_tree_clear(aa_tree_t tree,
+                   void (*delete_key)(void *, void *),
+                   void (*delete_value)(void *, void *),
+                   void *data)
+{
+  __aa_tree_clear_aux(tree, delete_key, delete_value, data);
+}
+
+size_t aa_tree_number_entries(aa_tree_t tree)
+{
+  return tree->number_entries;
+}
+
+/* Moves the subtree rooted at node from the allocator of other to
+   the one of tree, copying each node together with its inline entry
+   into the layout of tree, and computing the subtree sizes if tree
+   keeps them.
+*/
+static tree_node_t __aa_tree_relocate(aa_tree_t tree,
+                                      aa_tree_t other,
+                                      tree_node_t node,
+                                      tree_node_t parent)
+{
+  tree_node_t copy;
+
+  if (node == NULL)
+    return NULL;
+
+  copy = __aa_tree_node_alloc(tree);
+  copy->key = node->key;
+  copy->value = node->value;
+  copy->level = node->level;
+  if (tree->inline_entries)
+  {
+    __aa_tree_inline_entry(tree, copy);
+    memcpy(copy->key, node->key, tree->key_size);
+    memcpy(copy->value, node->value, tree->value_size);
+  }
+  copy->parent = parent;
+  copy->left = __aa_tree_relocate(tree, other, node->left, copy);
+  copy->right = __aa_tree_relocate(tree, other, node->right, copy);
+  if (tree->ranked)
+    *__size_slot(copy) = __size(copy->left) + __size(copy->right) + ((size_t)1);
+  __aa_tree_node_free(other, node);
+  return copy;
+}
+
+void aa_tree_set_ranked(aa_tree_t tree, int ranked)
+{
+  struct __aa_tree_struct_t old;
+
+  ranked = (ranked != 0);
+  if (tree->ranked == ranked)
+    return;
+
+  // The nodes change size, so they all move to a new allocator.
+  old = *tree;
+  tree->ranked = ranked;
+  if (old.arena != NULL)
+    tree->arena = __node_arena_create(old.arena->nodes_per_slab, __aa_tree_node_size(tree));
+  tree->root = __aa_tree_relocate(tree, &old, old.root, NULL);
+  if (old.arena != NULL)
+    __node_arena_delete(old.arena);
+}
+
+static tree_node_t __aa_tree_search_aux(tree_node_t node,
+                                        void *key,
+                                        int (*compare_key)(void *, void *, void *),
+                                        void *data)
+{
+  int cmp;
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if (cmp == 0)
+      return node;
+    node = (cmp < 0) ? node->left : node->right;
+  }
+  return NULL;
+}
+
+/* Returns the node with the smallest key greater than or equal to
+   key (inclusive) resp. strictly greater than key, or NULL.
+*/
+static tree_node_t __aa_tree_first_after(tree_node_t node,
+                                         void *key,
+                                         int inclusive,
+                                         int (*compare_key)(void *, void *, void *),
+                                         void *data)
+{
+  tree_node_t best = NULL;
+  int cmp;
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if ((cmp < 0) || ((cmp == 0) && inclusive))
+    {
+      best = node;
+      if (cmp == 0)
+        break;
+      node = node->left;
+    }
+    else
+    {
+      node = node->right;
+    }
+  }
+  return best;
+}
+
+/* Returns the node with the largest key less than or equal to
+   key (inclusive) resp. strictly less than key, or NULL.
+*/
+static tree_node_t __aa_tree_last_before(tree_node_t node,
+                                         void *key,
+                                         int inclusive,
+                                         int (*compare_key)(void *, void *, void *),
+                                         void *data)
+{
+  tree_node_t best = NULL;
+  int cmp;
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if ((cmp > 0) || ((cmp == 0) && inclusive))
+    {
+      best = node;
+      if (cmp == 0)
+        break;
+      node = node->right;
+    }
+    else
+    {
+      node = node->left;
+    }
+  }
+  return best;
+}
+
+static void __aa_tree_report(void **found_key,
+                             void **found_value,
+                             aa_tree_position_t *position,
+                             tree_node_t node)
+{
+  if (position != NULL)
+    *position = (aa_tree_position_t)node;
+  if (node == NULL)
+  {
+    *found_key = NULL;
+    *found_value = NULL;
+    return;
+  }
+  *found_key = node->key;
+  *found_value = node->value;
+}
+
+void aa_tree_lower_bound(void **found_key,
+                         void **found_value,
+                         aa_tree_position_t *position,
+                         aa_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data)
+{
+  __aa_tree_report(found_key, found_value, position,
+                   __aa_tree_first_after(tree->root, key, 1, compare_key, data));
+}
+
+void aa_tree_upper_bound(void **found_key,
+                         void **found_value,
+                         aa_tree_position_t *position,
+                         aa_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data)
+{
+  __aa_tree_report(found_key, found_value, position,
+                   __aa_tree_first_after(tree->root, key, 0, compare_key, data));
+}
+
+void aa_tree_floor(void **found_key,
+                   void **found_value,
+                   aa_tree_position_t *position,
+                   aa_tree_t tree,
+                   void *key,
+                   int (*compare_key)(void *, void *, void *),
+                   void *data)
+{
+  __aa_tree_report(found_key, found_value, position,
+                   __aa_tree_last_before(tree->root, key, 1, compare_key, data));
+}
+
+void aa_tree_ceiling(void **found_key,
+                     void **found_value,
+                     aa_tree_position_t *position,
+                     aa_tree_t tree,
+                     void *key,
+                     int (*compare_key)(void *, void *, void *),
+                     void *data)
+{
+  aa_tree_lower_bound(found_key, found_value, position,
+                      tree, key, compare_key, data);
+}
+
+void *aa_tree_position_key(aa_tree_position_t position)
+{
+  return ((tree_node_t)position)->key;
+}
+
+void *aa_tree_position_value(aa_tree_position_t position)
+{
+  return ((tree_node_t)position)->value;
+}
+
+void *aa_tree_search(aa_tree_t tree,
+                     void *key,
+                     int (*compare_key)(void *, void *, void *),
+                     void *data)
+{
+  tree_node_t node;
+  node = __aa_tree_search_aux(tree->root, key, compare_key, data);
+  if (node == NULL)
+    return NULL;
+  return node->value;
+}
+
+/* Runs the lookups of a batch in groups. Within a group, every
+   lookup takes one step per round: first the keys of the current
+   nodes of all lookups are prefetched, then each lookup compares
+   against its node and prefetches the child it moves to. The cache
+   misses of one lookup are thus overlapped with the work on the
+   other lookups of the group instead of stalling each lookup in
+   turn.
+*/
+void aa_tree_search_batch(void **values,
+                          aa_tree_t tree,
+                          void **keys,
+                          size_t n,
+                          int (*compare_key)(void *, void *, void *),
+                          void *data)
+{
+  tree_node_t nodes[AA_TREE_SEARCH_GROUP];
+  size_t start, group, i, active;
+  int cmp;
+
+  for (start = 0; start < n; start += group)
+  {
+    group = n - start;
+    if (group > AA_TREE_SEARCH_GROUP)
+      group = AA_TREE_SEARCH_GROUP;
+
+    for (i = 0; i < group; i++)
+    {
+      nodes[i] = tree->root;
+      values[start + i] = NULL;
+    }
+
+    for (active = (tree->root == NULL) ? 0 : group; active > 0;)
+    {
+      for (i = 0; i < group; i++)
+      {
+        if (nodes[i] != NULL)
+          __prefetch(nodes[i]->key);
+      }
+
+      active = 0;
+      for (i = 0; i < group; i++)
+      {
+        if (nodes[i] == NULL)
+          continue;
+        cmp = compare_key(keys[start + i], nodes[i]->key, data);
+        if (cmp == 0)
+        {
+          values[start + i] = nodes[i]->value;
+          nodes[i] = NULL;
+          continue;
+        }
+        nodes[i] = (cmp < 0) ? nodes[i]->left : nodes[i]->right;
+        if (nodes[i] != NULL)
+        {
+          __prefetch(nodes[i]);
+          active++;
+        }
+      }
+    }
+  }
+}
+
+void aa_tree_minimum(void **min_key,
+                     void **min_value,
+                     aa_tree_t tree)
+{
+  tree_node_t node;
+
+  if (tree->root == NULL)
+  {
+    *min_key = NULL;
+    *min_value = NULL;
+    return;
+  }
+
+  for (node = tree->root; node->left != NULL; node = node->left)
+    ;
+
+  *min_key = node->key;
+  *min_value = node->value;
+}
+
+void aa_tree_maximum(void **max_key,
+                     void **max_value,
+                     aa_tree_t tree)
+{
+  tree_node_t node;
+
+  if (tree->root == NULL)
+  {
+    *max_key = NULL;
+    *max_value = NULL;
+    return;
+  }
+
+  for (node = tree->root; node->right != NULL; node = node->right)
+    ;
+
+  *max_key = node->key;
+  *max_value = node->value;
+}
+
+/* In-order neighbours of a node, following the parent pointers.
+   Walking the whole tree this way touches every edge twice, so a
+   step costs amortized O(1).
+*/
+static tree_node_t __aa_tree_next(tree_node_t x)
+{
+  tree_node_t y;
+
+  if (x->right != NULL)
+  {
+    for (y = x->right; y->left != NULL; y = y->left)
+      ;
+    return y;
+  }
+
+  for (y = x->parent; ((y != NULL) && (x == y->right));)
+  {
+    x = y;
+    y = y->parent;
+  }
+  return y;
+}
+
+static tree_node_t __aa_tree_prev(tree_node_t x)
+{
+  tree_node_t y;
+
+  if (x->left != NULL)
+  {
+    for (y = x->left; y->right != NULL; y = y->right)
+      ;
+    return y;
+  }
+
+  for (y = x->parent; ((y != NULL) && (x == y->left));)
+  {
+    x = y;
+    y = y->parent;
+  }
+  return y;
+}
+
+static tree_node_t __aa_tree_first(tree_node_t node)
+{
+  if (node == NULL)
+    return NULL;
+  while (node->left != NULL)
+    node = node->left;
+  return node;
+}
+
+static tree_node_t __aa_tree_last(tree_node_t node)
+{
+  if (node == NULL)
+    return NULL;
+  while (node->right != NULL)
+    node = node->right;
+  return node;
+}
+
+void aa_tree_predecessor(void **prec_key,
+                         void **prec_value,
+                         aa_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data)
+{
+  tree_node_t x, y;
+
+  x = __aa_tree_search_aux(tree->root, key, compare_key, data);
+
+  if (x == NULL)
+  {
+    *prec_key = NULL;
+    *prec_value = NULL;
+    return;
+  }
+
+  y = __aa_tree_prev(x);
+  if (y == NULL)
+  {
+    *prec_key = NULL;
+    *prec_value = NULL;
+    return;
+  }
+  *prec_key = y->key;
+  *prec_value = y->value;
+}
+
+void aa_tree_successor(void **succ_key,
+                       void **succ_value,
+                       aa_tree_t tree,
+                       void *key,
+                       int (*compare_key)(void *, void *, void *),
+                       void *data)
+{
+  tree_node_t x, y;
+
+  x = __aa_tree_search_aux(tree->root, key, compare_key, data);
+
+  if (x == NULL)
+  {
+    *succ_key = NULL;
+    *succ_value = NULL;
+    return;
+  }
+
+  y = __aa_tree_next(x);
+  if (y == NULL)
+  {
+    *succ_key = NULL;
+    *succ_value = NULL;
+    return;
+  }
+  *succ_key = y->key;
+  *succ_value = y->value;
+}
+
+int aa_tree_cursor_begin(aa_tree_cursor_t *cursor,
+                         aa_tree_t tree)
+{
+  cursor->tree = tree;
+  cursor->position = (aa_tree_position_t)__aa_tree_first(tree->root);
+  return cursor->position != NULL;
+}
+
+int aa_tree_cursor_end(aa_tree_cursor_t *cursor,
+                       aa_tree_t tree)
+{
+  cursor->tree = tree;
+  cursor->position = NULL;
+  return 0;
+}
+
+int aa_tree_cursor_seek(aa_tree_cursor_t *cursor,
+                        aa_tree_t tree,
+                        void *key,
+                        int (*compare_key)(void *, void *, void *),
+                        void *data)
+{
+  cursor->tree = tree;
+  cursor->position = (aa_tree_position_t)__aa_tree_first_after(tree->root, key, 1,
+                                                               compare_key, data);
+  return cursor->position != NULL;
+}
+
+int aa_tree_cursor_at(aa_tree_cursor_t *cursor,
+                      aa_tree_t tree,
+                      aa_tree_position_t position)
+{
+  cursor->tree = tree;
+  cursor->position = position;
+  return cursor->position != NULL;
+}
+
+int aa_tree_cursor_next(aa_tree_cursor_t *cursor)
+{
+  tree_node_t node = (tree_node_t)cursor->position;
+
+  if (node == NULL)
+    node = __aa_tree_first(cursor->tree->root);
+  else
+    node = __aa_tree_next(node);
+  cursor->position = (aa_tree_position_t)node;
+  return node != NULL;
+}
+
+int aa_tree_cursor_prev(aa_tree_cursor_t *cursor)
+{
+  tree_node_t node = (tree_node_t)cursor->position;
+
+  if (node == NULL)
+    node = __aa_tree_last(cursor->tree->root);
+  else
+    node = __aa_tree_prev(node);
+  cursor->position = (aa_tree_position_t)node;
+  return node != NULL;
+}
+
+int aa_tree_cursor_valid(aa_tree_cursor_t *cursor)
+{
+  return cursor->position != NULL;
+}
+
+void *aa_tree_cursor_key(aa_tree_cursor_t *cursor)
+{
+  return ((tree_node_t)cursor->position)->key;
+}
+
+void *aa_tree_cursor_value(aa_tree_cursor_t *cursor)
+{
+  return ((tree_node_t)cursor->position)->value;
+}
+
+void aa_tree_select(void **found_key,
+                    void **found_value,
+                    aa_tree_position_t *position,
+                    aa_tree_t tree,
+                    size_t k)
+{
+  tree_node_t node = tree->root;
+  size_t l;
+
+  // Without subtree sizes, step through the first k entries.
+  if (!tree->ranked)
+  {
+    for (node = __aa_tree_first(node); (node != NULL) && (k > ((size_t)0)); k--)
+      node = __aa_tree_next(node);
+    __aa_tree_report(found_key, found_value, position, node);
+    return;
+  }
+
+  while (node != NULL)
+  {
+    l = __size(node->left);
+    if (k == l)
+      break;
+    if (k < l)
+    {
+      node = node->left;
+    }
+    else
+    {
+      k -= l + ((size_t)1);
+      node = node->right;
+    }
+  }
+  __aa_tree_report(found_key, found_value, position, node);
+}
+
+/* Returns the number of keys strictly less than key (inclusive == 0)
+   resp. less than or equal to key (inclusive != 0).
+*/
+static size_t __aa_tree_rank_aux(tree_node_t node,
+                                 void *key,
+                                 int inclusive,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void *data)
+{
+  size_t rank = (size_t)0;
+  int cmp;
+
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if ((cmp > 0) || ((cmp == 0) && inclusive))
+    {
+      rank += __size(node->left) + ((size_t)1);
+      node = node->right;
+    }
+    else if (cmp < 0)
+    {
+      node = node->left;
+    }
+    else
+    {
+      rank += __size(node->left);
+      break;
+    }
+  }
+  return rank;
+}
+
+/* Counts the entries from node on in key order whose keys are less
+   than hi, or all of them if hi is NULL.
+*/
+static size_t __aa_tree_count_walk(tree_node_t node,
+                                   void *hi,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *data)
+{
+  size_t count = (size_t)0;
+
+  for (; node != NULL; node = __aa_tree_next(node))
+  {
+    if ((hi != NULL) && (compare_key(node->key, hi, data) >= 0))
+      break;
+    count++;
+  }
+  return count;
+}
+
+size_t aa_tree_rank(aa_tree_t tree,
+                    void *key,
+                    int (*compare_key)(void *, void *, void *),
+                    void *data)
+{
+  if (!tree->ranked)
+    return __aa_tree_count_walk(__aa_tree_first(tree->root), key, compare_key, data);
+  return __aa_tree_rank_aux(tree->root, key, 0, compare_key, data);
+}
+
+size_t aa_tree_count_in_range(aa_tree_t tree,
+                              void *lo,
+                              void *hi,
+                              int (*compare_key)(void *, void *, void *),
+                              void *data)
+{
+  tree_node_t node;
+  size_t below_lo, below_hi;
+
+  if (!tree->ranked)
+  {
+    if (lo == NULL)
+      node = __aa_tree_first(tree->root);
+    else
+      node = __aa_tree_first_after(tree->root, lo, 1, compare_key, data);
+    return __aa_tree_count_walk(node, hi, compare_key, data);
+  }
+
+  below_lo = (lo == NULL) ? ((size_t)0) : __aa_tree_rank_aux(tree->root, lo, 0, compare_key, data);
+  below_hi = (hi == NULL) ? tree->number_entries : __aa_tree_rank_aux(tree->root, hi, 0, compare_key, data);
+  if (below_hi < below_lo)
+    return (size_t)0;
+  return below_hi - below_lo;
+}
+
+size_t aa_tree_range_foreach(aa_tree_t tree,
+                             void *lo,
+                             void *hi,
+                             int (*compare_key)(void *, void *, void *),
+                             int (*visitor)(void *, void *, void *),
+                             void *data)
+{
+  tree_node_t node;
+  size_t count = (size_t)0;
+
+  // Counting alone does not need to look at the entries.
+  if (visitor == NULL)
+    return aa_tree_count_in_range(tree, lo, hi, compare_key, data);
+
+  if (lo == NULL)
+    node = __aa_tree_first(tree->root);
+  else
+    node = __aa_tree_first_after(tree->root, lo, 1, compare_key, data);
+
+  for (; node != NULL; node = __aa_tree_next(node))
+  {
+    if ((hi != NULL) && (compare_key(node->key, hi, data) >= 0))
+      break;
+    count++;
+    if (visitor(node->key, node->value, data))
+      break;
+  }
+  return count;
+}
+
+static tree_node_t __aa_tree_insert_aux(aa_tree_t tree,
+                                        void *key,
+                                        void *value,
+                                        void *(*copy_key)(void *, void *),
+                                        void *(*copy_value)(void *, void *),
+                                        void *data)
+{
+  tree_node_t new_node;
+  new_node = __aa_tree_node_alloc(tree);
+
+  __aa_tree_store_entry(tree, new_node, key, value, copy_key, copy_value, data);
+  new_node->level = (size_t)1;
+  new_node->parent = NULL;
+  new_node->left = NULL;
+  new_node->right = NULL;
+  if (tree->ranked)
+    *__size_slot(new_node) = (size_t)1;
+
+  return new_node;
+}
+
+static size_t __aa_tree_height_aux(tree_node_t node)
+{
+  size_t l, r, h;
+
+  if (node == NULL)
+    return ((size_t)0);
+
+  l = __aa_tree_height_aux(node->left);
+  r = __aa_tree_height_aux(node->right);
+
+  h = ((l > r) ? l : r) + ((size_t)1);
+
+  return h;
+}
+
+size_t aa_tree_height(aa_tree_t tree)
+{
+  return __aa_tree_height_aux(tree->root);
+}
+
+size_t aa_tree_level(aa_tree_t tree)
+{
+  if (tree->root == NULL)
+    return (size_t)0;
+  return tree->root->level;
+}
+
+static size_t __floor_log2(size_t n)
+{
+  size_t l;
+  for (l = (size_t)0; n > ((size_t)1); n >>= 1)
+    l++;
+  return l;
+}
+
+void aa_tree_height_bounds(size_t *min_height,
+                           size_t *max_height,
+                           aa_tree_t tree)
+{
+  size_t n, bh, lo, hi;
+
+  n = tree->number_entries;
+  if (n == ((size_t)0))
+  {
+    *min_height = (size_t)0;
+    *max_height = (size_t)0;
+    return;
+  }
+
+  // A binary tree with n nodes has height at least ceil(log2(n + 1)).
+  // An AA tree is a red-black tree whose red nodes are right children
+  // on the level of their parent, so its height is at most
+  // 2 * log2(n + 1) and lies between its root level and twice that.
+  bh = aa_tree_level(tree);
+  lo = __floor_log2(n) + ((size_t)1);
+  hi = ((size_t)2) * __floor_log2(n + ((size_t)1));
+  if (bh > lo)
+    lo = bh;
+  if (((size_t)2) * bh < hi)
+    hi = ((size_t)2) * bh;
+  *min_height = lo;
+  *max_height = hi;
+}
+
+static size_t __level(tree_node_t node)
+{
+  return (node == NULL) ? ((size_t)0) : node->level;
+}
+
+/* Removes a left link on the level of node by a right rotation.
+   Returns the node now at the top of the subtree.
+*/
+static tree_node_t __aa_tree_skew(aa_tree_t tree, tree_node_t node)
+{
+  if ((node == NULL) || (node->left == NULL) || (node->left->level != node->level))
+    return node;
+  node = node->left;
+  right_rotate(tree, node->parent);
+  return node;
+}
+
+/* Removes two consecutive right links on the level of node by a
+   left rotation, lifting the middle node one level up. Returns the
+   node now at the top of the subtree.
+*/
+static tree_node_t __aa_tree_split(aa_tree_t tree, tree_node_t node)
+{
+  if ((node == NULL) || (node->right == NULL) || (node->right->right == NULL) ||
+      (node->right->right->level != node->level))
+    return node;
+  node = node->right;
+  left_rotate(tree, node->parent);
+  node->level++;
+  return node;
+}
+
+static void __aa_tree_insert_fix(aa_tree_t tree, tree_node_t z)
+{
+  tree_node_t node, top;
+  size_t level;
+  int unchanged = 0;
+
+  // Skewing and splitting a node only looks at its children and at
+  // its right grandchild. Once two nodes in a row come out with the
+  // same top and level, nothing above them can change any more.
+  for (node = z->parent; node != NULL; node = top->parent)
+  {
+    level = node->level;
+    top = __aa_tree_skew(tree, node);
+    top = __aa_tree_split(tree, top);
+    if ((top == node) && (top->level == level))
+    {
+      if (unchanged)
+        break;
+      unchanged = 1;
+    }
+    else
+    {
+      unchanged = 0;
+    }
+  }
+}
+
+/* Descends once from node x looking for key. Returns the node
+   holding the key if there is one. Otherwise returns NULL and sets
+   *parent and *cmp to the node a new entry has to be attached to
+   and the side it goes on.
+*/
+static tree_node_t __aa_tree_locate_from(tree_node_t *parent,
+                                         int *cmp,
+                                         tree_node_t x,
+                                         void *key,
+                                         int (*compare_key)(void *, void *, void *),
+                                         void *data)
+{
+  tree_node_t y;
+  int c;
+
+  c = 0;
+  y = NULL;
+  while (x != NULL)
+  {
+    c = compare_key(key, x->key, data);
+    if (c == 0)
+      return x;
+    y = x;
+    x = (c < 0) ? x->left : x->right;
+  }
+  *parent = y;
+  *cmp = c;
+  return NULL;
+}
+
+static tree_node_t __aa_tree_locate(tree_node_t *parent,
+                                    int *cmp,
+                                    aa_tree_t tree,
+                                    void *key,
+                                    int (*compare_key)(void *, void *, void *),
+                                    void *data)
+{
+  return __aa_tree_locate_from(parent, cmp, tree->root, key, compare_key, data);
+}
+
+/* Links the fresh node z below y on the side given by cmp and
+   restores the AA properties.
+*/
+static void __aa_tree_attach(aa_tree_t tree,
+                             tree_node_t z,
+                             tree_node_t y,
+                             int cmp)
+{
+  tree_node_t w;
+
+  if (tree->ranked)
+  {
+    for (w = y; w != NULL; w = w->parent)
+      (*__size_slot(w))++;
+  }
+  z->parent = y;
+  if (y == NULL)
+  {
+    tree->root = z;
+  }
+  else if (cmp < 0)
+  {
+    y->left = z;
+  }
+  else
+  {
+    y->right = z;
+  }
+  tree->number_entries++;
+  __aa_tree_insert_fix(tree, z);
+}
+
+void aa_tree_insert(aa_tree_t tree,
+                    void *key,
+                    void *value,
+                    int (*compare_key)(void *, void *, void *),
+                    void *(*copy_key)(void *, void *),
+                    void *(*copy_value)(void *, void *),
+                    void *data)
+{
+  aa_tree_insert_or_get(NULL, tree, key, value,
+                        compare_key, copy_key, copy_value, data);
+}
+
+int aa_tree_insert_or_get(void **value_in_tree,
+                          aa_tree_t tree,
+                          void *key,
+                          void *value,
+                          int (*compare_key)(void *, void *, void *),
+                          void *(*copy_key)(void *, void *),
+                          void *(*copy_value)(void *, void *),
+                          void *data)
+{
+  tree_node_t y, z;
+  int cmp;
+
+  z = __aa_tree_locate(&y, &cmp, tree, key, compare_key, data);
+  if (z != NULL)
+  {
+    if (value_in_tree != NULL)
+      *value_in_tree = z->value;
+    return 0;
+  }
+
+  z = __aa_tree_insert_aux(tree, key, value, copy_key, copy_value, data);
+  __aa_tree_attach(tree, z, y, cmp);
+  if (value_in_tree != NULL)
+    *value_in_tree = z->value;
+  return 1;
+}
+
+int aa_tree_upsert(aa_tree_t tree,
+                   void *key,
+                   void *value,
+                   int (*compare_key)(void *, void *, void *),
+                   void *(*copy_key)(void *, void *),
+                   void *(*copy_value)(void *, void *),
+                   void (*delete_value)(void *, void *),
+                   void *data)
+{
+  tree_node_t y, z;
+  int cmp;
+
+  z = __aa_tree_locate(&y, &cmp, tree, key, compare_key, data);
+  if (z != NULL)
+  {
+    // Replace the value in place, the key and the node stay.
+    if (tree->inline_entries)
+    {
+      memcpy(z->value, value, tree->value_size);
+    }
+    else
+    {
+      if (delete_value != NULL)
+        delete_value(z->value, data);
+      z->value = copy_value(value, data);
+    }
+    return 1;
+  }
+
+  z = __aa_tree_insert_aux(tree, key, value, copy_key, copy_value, data);
+  __aa_tree_attach(tree, z, y, cmp);
+  return 0;
+}
+
+/* Sorts the permutation order[0..n-1] of the batch by key with a
+   stable bottom-up merge sort, so that the first of several equal
+   keys stays first, as with one-by-one insertion.
+*/
+static void __aa_tree_sort_batch(size_t *order,
+                                 size_t n,
+                                 void **keys,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void *data)
+{
+  size_t *src, *dst, *tmp, width, lo, mid, hi, i, j, k;
+
+  tmp = malloc(n * sizeof(*tmp));
+  if (tmp == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+
+  src = order;
+  dst = tmp;
+  for (width = (size_t)1; width < n; width *= (size_t)2)
+  {
+    for (lo = (size_t)0; lo < n; lo += ((size_t)2) * width)
+    {
+      mid = (lo + width < n) ? lo + width : n;
+      hi = (mid + width < n) ? mid + width : n;
+      i = lo;
+      j = mid;
+      for (k = lo; k < hi; k++)
+      {
+        if ((i < mid) && ((j >= hi) || (compare_key(keys[src[j]], keys[src[i]], data) >= 0)))
+          dst[k] = src[i++];
+        else
+          dst[k] = src[j++];
+      }
+    }
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != order)
+  {
+    for (k = (size_t)0; k < n; k++)
+      order[k] = src[k];
+    free(src);
+  }
+  else
+  {
+    free(dst);
+  }
+}
+
+/* Finds where key belongs starting from the node finger, whose key
+   is not greater than key. Climbs while key lies beyond the subtree
+   of the current node, which only takes a comparison where the
+   node is a left child, then descends from there.
+*/
+static tree_node_t __aa_tree_locate_finger(tree_node_t *parent,
+                                           int *cmp,
+                                           aa_tree_t tree,
+                                           tree_node_t finger,
+                                           void *key,
+                                           int (*compare_key)(void *, void *, void *),
+                                           void *data)
+{
+  tree_node_t x;
+  int c;
+
+  if (finger == NULL)
+    return __aa_tree_locate(parent, cmp, tree, key, compare_key, data);
+
+  for (x = finger; x->parent != NULL; x = x->parent)
+  {
+    if (x == x->parent->left)
+    {
+      c = compare_key(key, x->parent->key, data);
+      if (c == 0)
+        return x->parent;
+      if (c < 0)
+        break;
+    }
+  }
+  return __aa_tree_locate_from(parent, cmp, x, key, compare_key, data);
+}
+
+size_t aa_tree_insert_batch(aa_tree_t tree,
+                            void **keys,
+                            void **values,
+                            size_t n,
+                            int (*compare_key)(void *, void *, void *),
+                            void *(*copy_key)(void *, void *),
+                            void *(*copy_value)(void *, void *),
+                            void *data)
+{
+  tree_node_t finger, y, z;
+  size_t *order, i, j, inserted;
+  int cmp, sorted;
+
+  sorted = 1;
+  for (i = (size_t)1; sorted && (i < n); i++)
+  {
+    if (compare_key(keys[i - ((size_t)1)], keys[i], data) > 0)
+      sorted = 0;
+  }
+
+  order = NULL;
+  if (!sorted)
+  {
+    order = malloc(n * sizeof(*order));
+    if (order == NULL)
+    {
+      fprintf(stderr, "Error: no memory left.\n");
+      exit(1);
+    }
+    for (i = (size_t)0; i < n; i++)
+      order[i] = i;
+    __aa_tree_sort_batch(order, n, keys, compare_key, data);
+  }
+
+  inserted = (size_t)0;
+  finger = NULL;
+  for (i = (size_t)0; i < n; i++)
+  {
+    j = (order == NULL) ? i : order[i];
+    z = __aa_tree_locate_finger(&y, &cmp, tree, finger, keys[j], compare_key, data);
+    if (z == NULL)
+    {
+      z = __aa_tree_insert_aux(tree, keys[j], values[j], copy_key, copy_value, data);
+      __aa_tree_attach(tree, z, y, cmp);
+      inserted++;
+    }
+    // Rebalancing moves nodes around but keeps z in the tree, so it
+    // remains a valid starting point for the next, larger key.
+    finger = z;
+  }
+
+  free(order);
+  return inserted;
+}
+
+static void left_rotate(aa_tree_t tree, tree_node_t x)
+{
+  tree_node_t y = x->right;
+  x->right = y->left;
+  if (y->left != NULL)
+  {
+    y->left->parent = x;
+  }
+  y->parent = x->parent;
+  if (x->parent == NULL)
+  {
+    tree->root = y;
+  }
+  else if (x == x->parent->left)
+  {
+    x->parent->left = y;
+  }
+  else
+  {
+    x->parent->right = y;
+  }
+  y->left = x;
+  x->parent = y;
+  if (tree->ranked)
+  {
+    *__size_slot(y) = *__size_slot(x);
+    *__size_slot(x) = __size(x->left) + __size(x->right) + ((size_t)1);
+  }
+}
+
+static void right_rotate(aa_tree_t tree, tree_node_t y)
+{
+  tree_node_t x = y->left;
+  y->left = x->right;
+  if (x->right != NULL)
+  {
+    x->right->parent = y;
+  }
+  x->parent = y->parent;
+  if (y->parent == NULL)
+  {
+    tree->root = x;
+  }
+  else if (y == y->parent->right)
+  {
+    y->parent->right = x;
+  }
+  else
+  {
+    y->parent->left = x;
+  }
+  x->right = y;
+  y->parent = x;
+  if (tree->ranked)
+  {
+    *__size_slot(x) = *__size_slot(y);
+    *__size_slot(y) = __size(y->left) + __size(y->right) + ((size_t)1);
+  }
+}
+
+/* Accounts for a node leaving the subtrees rooted at node and
+   at all its ancestors, if the tree keeps subtree sizes.
+*/
+static void __aa_tree_shrink_path(aa_tree_t tree, tree_node_t node)
+{
+  if (!tree->ranked)
+    return;
+  for (; node != NULL; node = node->parent)
+    (*__size_slot(node))--;
+}
+
+static void __aa_tree_transplant(aa_tree_t tree, tree_node_t u, tree_node_t v)
+{
+  if (u->parent == NULL)
+  {
+    // If u is the root node, update the root of the tree.
+    tree->root = v;
+  }
+  else if (u == u->parent->left)
+  {
+    // If u is a left child, replace u with v as the left child of u's parent.
+    u->parent->left = v;
+  }
+  else
+  {
+    // If u is a right child, replace u with v as the right child of u's parent.
+    u->parent->right = v;
+  }
+
+  if (v != NULL)
+  {
+    // Update the parent of v if v is not NULL.
+    v->parent = u->parent;
+  }
+}
+
+/* Walks up from node towards the root, lowering levels that are
+   too high since a child was removed, then skewing and splitting
+   to restore the AA properties.
+*/
+static void __aa_tree_remove_fix(aa_tree_t tree, tree_node_t node)
+{
+  tree_node_t top, right, right_right;
+  size_t should_be;
+  int changed, unchanged = 0;
+
+  // As for inserts, once two nodes in a row need no change, the
+  // nodes above them cannot need any either.
+  for (; node != NULL; node = top->parent)
+  {
+    changed = 0;
+    should_be = __level(node->left);
+    if (__level(node->right) < should_be)
+      should_be = __level(node->right);
+    should_be++;
+    if (should_be < node->level)
+    {
+      node->level = should_be;
+      if (should_be < __level(node->right))
+        node->right->level = should_be;
+      changed = 1;
+    }
+
+    top = __aa_tree_skew(tree, node);
+    right = top->right;
+    right_right = (right == NULL) ? NULL : right->right;
+    __aa_tree_skew(tree, top->right);
+    if (top->right != NULL)
+      __aa_tree_skew(tree, top->right->right);
+    if ((top != node) || (top->right != right) ||
+        ((right != NULL) && (right->right != right_right)))
+      changed = 1;
+    right = top->right;
+    top = __aa_tree_split(tree, top);
+    __aa_tree_split(tree, top->right);
+    if ((top != node) || (top->right != right))
+      changed = 1;
+
+    if (changed)
+    {
+      unchanged = 0;
+    }
+    else
+    {
+      if (unchanged)
+        break;
+      unchanged = 1;
+    }
+  }
+}
+
+tree_node_t __aa_tree_minimum(tree_node_t node)
+{
+  if (node == NULL)
+    return NULL;
+
+  while (node->left != NULL)
+  {
+    node = node->left;
+  }
+
+  return node;
+}
+
+void aa_tree_remove(aa_tree_t tree,
+                    void *key,
+                    int (*compare_key)(void *, void *, void *),
+                    void (*delete_key)(void *, void *),
+                    void (*delete_value)(void *, void *),
+                    void *data)
+{
+  tree_node_t z = __aa_tree_search_aux(tree->root, key, compare_key, data);
+  if (z == NULL)
+    return;
+  tree->number_entries--;
+
+  tree_node_t y, start;
+
+  if (z->left == NULL)
+  {
+    // z is on level one; its right child, if any, is a leaf.
+    __aa_tree_shrink_path(tree, z->parent);
+    start = z->parent;
+    __aa_tree_transplant(tree, z, z->right);
+  }
+  else
+  {
+    // z has two children. Its successor y is on level one and has
+    // no left child, so it can be unhooked and put in z's place.
+    y = __aa_tree_minimum(z->right);
+    __aa_tree_shrink_path(tree, y->parent);
+    start = (y->parent == z) ? y : y->parent;
+    __aa_tree_transplant(tree, y, y->right);
+
+    __aa_tree_transplant(tree, z, y);
+    y->left = z->left;
+    y->right = z->right;
+    y->left->parent = y;
+    if (y->right != NULL)
+      y->right->parent = y;
+    y->level = z->level;
+    if (tree->ranked)
+      *__size_slot(y) = *__size_slot(z);
+  }
+
+  __aa_tree_remove_fix(tree, start);
+
+  __aa_tree_release_entry(tree, z, delete_key, delete_value, data);
+  __aa_tree_node_free(tree, z);
+}
+
+/* A frozen snapshot stores entry i of the implicit complete binary
+   tree at index i of its arrays, counting from one: the children of
+   i are 2i and 2i+1. Index 0 is unused and doubles as "no entry".
+*/
+struct __aa_tree_frozen_struct_t
+{
+  size_t number_entries;
+  void **keys;
+  void **values;
+  long long *integer_keys;
+  void *integer_keys_block;
+  long long (*integer_key)(void *, void *);
+  void *data;
+};
+
+#define AA_TREE_CACHE_LINE ((size_t)64)
+
+/* In-order neighbours of an index in a snapshot of n entries.
+   Climbing out of a left resp. right spine amounts to dropping the
+   trailing zeros resp. ones of the index and one more bit.
+*/
+static size_t __frozen_next(size_t k, size_t n)
+{
+  if (2 * k + 1 <= n)
+  {
+    for (k = 2 * k + 1; 2 * k <= n; k = 2 * k)
+      ;
+    return k;
+  }
+  while (k & ((size_t)1))
+    k >>= 1;
+  return k >> 1;
+}
+
+static size_t __frozen_prev(size_t k, size_t n)
+{
+  if (2 * k <= n)
+  {
+    for (k = 2 * k; 2 * k + 1 <= n; k = 2 * k + 1)
+      ;
+    return k;
+  }
+  while ((k != 0) && !(k & ((size_t)1)))
+    k >>= 1;
+  return k >> 1;
+}
+
+static size_t __frozen_first(size_t n)
+{
+  size_t k;
+  if (n == 0)
+    return 0;
+  for (k = 1; 2 * k <= n; k = 2 * k)
+    ;
+  return k;
+}
+
+static size_t __frozen_last(size_t n)
+{
+  size_t k;
+  if (n == 0)
+    return 0;
+  for (k = 1; 2 * k + 1 <= n; k = 2 * k + 1)
+    ;
+  return k;
+}
+
+aa_tree_frozen_t aa_tree_freeze(aa_tree_t tree,
+                                void *(*copy_key)(void *, void *),
+                                void *(*copy_value)(void *, void *),
+                                long long (*integer_key)(void *, void *),
+                                void *data)
+{
+  aa_tree_frozen_t frozen;
+  tree_node_t node;
+  size_t n, k;
+  uintptr_t aligned;
+
+  frozen = (aa_tree_frozen_t)calloc(1, sizeof(*frozen));
+  n = tree->number_entries;
+  if (frozen != NULL)
+  {
+    frozen->keys = (void **)calloc(n + 1, sizeof(void *));
+    frozen->values = (void **)calloc(n + 1, sizeof(void *));
+  }
+  if ((frozen == NULL) || (frozen->keys == NULL) || (frozen->values == NULL))
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  frozen->number_entries = n;
+  frozen->integer_key = integer_key;
+  frozen->data = data;
+
+  if (integer_key != NULL)
+  {
+    // Align the array so that the eight grandchildren of the
+    // grandchildren of index k, at 8k .. 8k+7, share a cache line.
+    frozen->integer_keys_block = malloc((n + 1) * sizeof(long long) + AA_TREE_CACHE_LINE);
+    if (frozen->integer_keys_block == NULL)
+    {
+      fprintf(stderr, "Error: no memory left.\n");
+      exit(1);
+    }
+    aligned = (uintptr_t)frozen->integer_keys_block;
+    aligned = (aligned + AA_TREE_CACHE_LINE - 1) & ~((uintptr_t)(AA_TREE_CACHE_LINE - 1));
+    frozen->integer_keys = (long long *)aligned;
+  }
+
+  // Walk the tree and the implicit tree in order side by side.
+  k = __frozen_first(n);
+  for (node = __aa_tree_first(tree->root); node != NULL; node = __aa_tree_next(node))
+  {
+    frozen->keys[k] = (copy_key == NULL) ? node->key : copy_key(node->key, data);
+    frozen->values[k] = (copy_value == NULL) ? node->value : copy_value(node->value, data);
+    if (integer_key != NULL)
+      frozen->integer_keys[k] = integer_key(node->key, data);
+    k = __frozen_next(k, n);
+  }
+  return frozen;
+}
+
+void aa_tree_frozen_delete(aa_tree_frozen_t frozen,
+                           void (*delete_key)(void *, void *),
+                           void (*delete_value)(void *, void *),
+                           void *data)
+{
+  size_t k;
+
+  for (k = 1; k <= frozen->number_entries; k++)
+  {
+    if (delete_key != NULL)
+      delete_key(frozen->keys[k], data);
+    if (delete_value != NULL)
+      delete_value(frozen->values[k], data);
+  }
+  free(frozen->keys);
+  free(frozen->values);
+  free(frozen->integer_keys_block);
+  free(frozen);
+}
+
+size_t aa_tree_frozen_number_entries(aa_tree_frozen_t frozen)
+{
+  return frozen->number_entries;
+}
+
+/* Returns the index of the first entry whose key is greater than or
+   equal to key (inclusive) resp. strictly greater (otherwise), or 0.
+
+   The descent always runs down to the bottom, turning the outcome of
+   each comparison into the next index instead of a branch. The last
+   turn to the left is then recovered from the index alone.
+*/
+static size_t __frozen_first_after(aa_tree_frozen_t frozen,
+                                   void *key,
+                                   int inclusive,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *data)
+{
+  size_t n = frozen->number_entries;
+  size_t k = 1;
+  long long x;
+  const long long *a;
+  int c;
+
+  if (frozen->integer_keys != NULL)
+  {
+    x = frozen->integer_key(key, frozen->data);
+    a = frozen->integer_keys;
+    if (inclusive)
+    {
+      while (k <= n)
+      {
+        __prefetch(a + 8 * k);
+        k = 2 * k + (size_t)(a[k] < x);
+      }
+    }
+    else
+    {
+      while (k <= n)
+      {
+        __prefetch(a + 8 * k);
+        k = 2 * k + (size_t)(a[k] <= x);
+      }
+    }
+  }
+  else
+  {
+    while (k <= n)
+    {
+      c = compare_key(frozen->keys[k], key, data);
+      k = 2 * k + (size_t)(inclusive ? (c < 0) : (c <= 0));
+    }
+  }
+
+  // Drop the trailing right turns and the last left turn.
+#if defined(__GNUC__)
+  return k >> (__builtin_ctzll(~((unsigned long long)k)) + 1);
+#else
+  while (k & ((size_t)1))
+    k >>= 1;
+  return k >> 1;
+#endif
+}
+
+/* Compares the key at index k of a snapshot to key. */
+static int __frozen_compare(aa_tree_frozen_t frozen,
+                            size_t k,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data)
+{
+  long long x;
+
+  if (frozen->integer_keys == NULL)
+    return compare_key(frozen->keys[k], key, data);
+  x = frozen->integer_key(key, frozen->data);
+  return (frozen->integer_keys[k] > x) - (frozen->integer_keys[k] < x);
+}
+
+/* Compares two keys the way a snapshot orders them. */
+static int __frozen_compare_keys(aa_tree_frozen_t frozen,
+                                 void *key1,
+                                 void *key2,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void *data)
+{
+  long long x1, x2;
+
+  if (frozen->integer_keys == NULL)
+    return compare_key(key1, key2, data);
+  x1 = frozen->integer_key(key1, frozen->data);
+  x2 = frozen->integer_key(key2, frozen->data);
+  return (x1 > x2) - (x1 < x2);
+}
+
+/* Returns the index of the entry with key key, or 0. */
+static size_t __frozen_find(aa_tree_frozen_t frozen,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data)
+{
+  size_t k;
+
+  k = __frozen_first_after(frozen, key, 1, compare_key, data);
+  if ((k == 0) || (__frozen_compare(frozen, k, key, compare_key, data) != 0))
+    return 0;
+  return k;
+}
+
+static void __frozen_report(void **found_key,
+                            void **found_value,
+                            aa_tree_frozen_t frozen,
+                            size_t k)
+{
+  // Index 0 holds NULL for both.
+  *found_key = frozen->keys[k];
+  *found_value = frozen->values[k];
+}
+
+void *aa_tree_frozen_search(aa_tree_frozen_t frozen,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data)
+{
+  return frozen->values[__frozen_find(frozen, key, compare_key, data)];
+}
+
+void aa_tree_frozen_minimum(void **min_key,
+                            void **min_value,
+                            aa_tree_frozen_t frozen)
+{
+  __frozen_report(min_key, min_value, frozen, __frozen_first(frozen->number_entries));
+}
+
+void aa_tree_frozen_maximum(void **max_key,
+                            void **max_value,
+                            aa_tree_frozen_t frozen)
+{
+  __frozen_report(max_key, max_value, frozen, __frozen_last(frozen->number_entries));
+}
+
+void aa_tree_frozen_lower_bound(void **found_key,
+                                void **found_value,
+                                aa_tree_frozen_t frozen,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data)
+{
+  __frozen_report(found_key, found_value, frozen,
+                  __frozen_first_after(frozen, key, 1, compare_key, data));
+}
+
+void aa_tree_frozen_predecessor(void **prec_key,
+                                void **prec_value,
+                                aa_tree_frozen_t frozen,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data)
+{
+  size_t k;
+
+  k = __frozen_find(frozen, key, compare_key, data);
+  if (k != 0)
+    k = __frozen_prev(k, frozen->number_entries);
+  __frozen_report(prec_key, prec_value, frozen, k);
+}
+
+void aa_tree_frozen_successor(void **succ_key,
+                              void **succ_value,
+                              aa_tree_frozen_t frozen,
+                              void *key,
+                              int (*compare_key)(void *, void *, void *),
+                              void *data)
+{
+  size_t k;
+
+  k = __frozen_find(frozen, key, compare_key, data);
+  if (k != 0)
+    k = __frozen_next(k, frozen->number_entries);
+  __frozen_report(succ_key, succ_value, frozen, k);
+}
+
+size_t aa_tree_frozen_range_foreach(aa_tree_frozen_t frozen,
+                                    void *lo,
+                                    void *hi,
+                                    int (*compare_key)(void *, void *, void *),
+                                    int (*visitor)(void *, void *, void *),
+                                    void *data)
+{
+  size_t n = frozen->number_entries;
+  size_t k, end, count = (size_t)0;
+
+  if ((lo != NULL) && (hi != NULL) && (__frozen_compare_keys(frozen, lo, hi, compare_key, data) >= 0))
+    return count;
+
+  if (lo == NULL)
+    k = __frozen_first(n);
+  else
+    k = __frozen_first_after(frozen, lo, 1, compare_key, data);
+
+  // Locate the end of the range up front rather than comparing
+  // every entry visited against hi.
+  end = (hi == NULL) ? ((size_t)0) : __frozen_first_after(frozen, hi, 1, compare_key, data);
+
+  for (; k != end; k = __frozen_next(k, n))
+  {
+    count++;
+    if ((visitor != NULL) && visitor(frozen->keys[k], frozen->values[k], data))
+      break;
+  }
+  return count;
+}
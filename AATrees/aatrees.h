@@ -0,0 +1,677 @@
+#ifndef AA_TREES_H
+#define AA_TREES_H
+
+#include <stdlib.h>
+
+typedef struct __aa_tree_struct_t *aa_tree_t;
+
+/* Handle on an entry of an AA tree. A position stays valid
+   until its entry is removed from the tree.
+*/
+typedef struct __aa_tree_position_struct_t *aa_tree_position_t;
+
+/* In-order cursor over an AA tree, meant to live on the stack.
+
+   Besides the entries, a cursor can sit on the end position, which
+   lies one past the last entry and one before the first entry.
+   Stepping a cursor costs amortized O(1). Removing the entry a
+   cursor sits on invalidates the cursor; any other change to the
+   tree leaves it usable.
+*/
+typedef struct
+{
+  aa_tree_t tree;
+  aa_tree_position_t position;
+} aa_tree_cursor_t;
+
+/* Allocator statistics of an AA tree, see
+   aa_tree_allocator_stats.
+*/
+typedef struct
+{
+  size_t number_slabs;
+  size_t nodes_per_slab;
+  size_t node_size;
+  size_t nodes_reserved;
+  size_t nodes_in_use;
+  size_t nodes_free;
+  size_t bytes_reserved;
+} aa_tree_allocator_stats_t;
+
+/* Immutable, read-optimized snapshot of an AA tree, see
+   aa_tree_freeze.
+*/
+typedef struct __aa_tree_frozen_struct_t *aa_tree_frozen_t;
+
+/* Creates an empty AA tree */
+aa_tree_t aa_tree_create();
+
+/* Creates an empty AA tree whose nodes are taken from a
+   per-tree slab arena holding nodes_per_slab nodes per slab.
+
+   Removed nodes are kept on a free list and reused by later
+   inserts. All slabs are released at once when the tree is
+   deleted.
+
+   A default slab size is used if nodes_per_slab is zero.
+
+*/
+aa_tree_t aa_tree_create_with_allocator(size_t nodes_per_slab);
+
+/* Creates an empty AA tree that stores keys of key_size
+   bytes and values of value_size bytes directly inside its nodes,
+   which are taken from a slab arena as with
+   aa_tree_create_with_allocator.
+
+   Inserting copies the bytes pointed to by the key and value into
+   the node; keys and values handed out by the tree point into the
+   node. The copy_key, copy_value, delete_key and delete_value
+   arguments of all other functions are ignored for such a tree and
+   may be NULL, so an insert costs no allocation besides the node
+   and a removal or deletion none at all.
+
+*/
+aa_tree_t aa_tree_create_inline(size_t key_size,
+                                size_t value_size,
+                                size_t nodes_per_slab);
+
+/* Builds an AA tree from n entries whose keys are already
+   sorted in strictly ascending order, copying the keys and values
+   with copy_key resp. copy_value.
+
+   Runs in O(n) without calling any comparison function. The result
+   is perfectly balanced and its nodes are carved from a single
+   allocation of n nodes in the tree's slab arena, as for trees made
+   by aa_tree_create_with_allocator.
+
+*/
+aa_tree_t aa_tree_build_sorted(void **keys,
+                               void **values,
+                               size_t n,
+                               void *(*copy_key)(void *, void *),
+                               void *(*copy_value)(void *, void *),
+                               void *data);
+
+/* Turns the subtree sizes of an AA tree on (ranked != 0) or off.
+   Trees start without them, with nodes of 48 bytes on 64-bit
+   targets, plus the inline entry if any.
+
+   With subtree sizes, every node counts the entries below it in one
+   more size_t, and aa_tree_select, aa_tree_rank and
+   aa_tree_count_in_range run in O(log n) instead of walking the
+   entries they count. In exchange, every insert and remove walks
+   the whole path from the changed node up to the root to update the
+   counts, O(log n) more work per update even where skewing and
+   splitting stop early.
+
+   Changing the setting moves every node to a new node of the other
+   layout in O(n), computing the sizes if they are turned on; positions
+   and cursors are invalidated. It is cheapest right after the tree is
+   created.
+
+*/
+void aa_tree_set_ranked(aa_tree_t tree, int ranked);
+
+/* Fills in the allocator statistics of an AA tree.
+
+   All counters are zero for a tree that was not created
+   with aa_tree_create_with_allocator.
+
+*/
+void aa_tree_allocator_stats(aa_tree_allocator_stats_t *stats,
+                             aa_tree_t tree);
+
+/* Deletes an AA tree, calling delete_key and delete_value
+   on each key resp. value, passing in the data pointer.
+
+   Runs in O(n) with constant extra memory. Either function may be
+   NULL if the keys resp. values need no cleanup; if both are NULL
+   and the tree uses a slab arena, the nodes are not visited at all.
+*/
+void aa_tree_delete(aa_tree_t tree,
+                    void (*delete_key)(void *, void *),
+                    void (*delete_value)(void *, void *),
+                    void *data);
+
+/* Removes all entries from an AA tree like
+   aa_tree_delete, but keeps the tree itself for reuse.
+
+   A tree using a slab arena keeps its largest slab.
+*/
+void aa_tree_clear(aa_tree_t tree,
+                   void (*delete_key)(void *, void *),
+                   void (*delete_value)(void *, void *),
+                   void *data);
+
+/* Returns the number of entries in an AA tree
+
+   Returns zero for an empty tree. Runs in constant time.
+
+*/
+size_t aa_tree_number_entries(aa_tree_t tree);
+
+/* Returns the height of an AA tree
+
+   Returns zero for an empty tree.
+
+*/
+size_t aa_tree_height(aa_tree_t tree);
+
+/* Returns the level of the root of an AA tree, which is the
+   black height of the equivalent red-black tree.
+
+   Runs in constant time. Returns zero for an empty tree.
+
+*/
+size_t aa_tree_level(aa_tree_t tree);
+
+/* Returns a lower and an upper bound on the height of an
+   AA tree without walking the whole tree.
+
+   The bounds follow from the number of entries and the level
+   of the root and are computed in O(log n). Both are zero for an
+   empty tree.
+
+*/
+void aa_tree_height_bounds(size_t *min_height,
+                           size_t *max_height,
+                           aa_tree_t tree);
+
+/* Searches an AA tree for a key, comparing keys with
+   compare_key, returning the associated value.
+
+   Returns NULL if the sought for key cannot be found.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void *aa_tree_search(aa_tree_t tree,
+                     void *key,
+                     int (*compare_key)(void *, void *, void *),
+                     void *data);
+
+/* Searches an AA tree for n keys at once, comparing keys with
+   compare_key, and stores the value associated with keys[i] in
+   values[i], or NULL if keys[i] cannot be found.
+
+   Gives the same results as n calls to aa_tree_search, but
+   advances several lookups side by side and prefetches the nodes
+   they visit, so that on trees exceeding the cache the memory
+   latency of one lookup overlaps with the others.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void aa_tree_search_batch(void **values,
+                          aa_tree_t tree,
+                          void **keys,
+                          size_t n,
+                          int (*compare_key)(void *, void *, void *),
+                          void *data);
+
+/* Returns the minimum key and associated value, comparing
+   the keys with compare_key.
+
+   Returns NULL for both the key and the value if the
+   tree is empty.
+
+*/
+void aa_tree_minimum(void **min_key,
+                     void **min_value,
+                     aa_tree_t tree);
+
+/* Returns the maximum key and associated value, comparing
+   the keys with compare_key.
+
+   Returns NULL for both the key and the value if the
+   tree is empty.
+
+*/
+void aa_tree_maximum(void **max_key,
+                     void **max_value,
+                     aa_tree_t tree);
+
+/* Returns the entry with the smallest key greater than or equal
+   to key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void aa_tree_lower_bound(void **found_key,
+                         void **found_value,
+                         aa_tree_position_t *position,
+                         aa_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data);
+
+/* Returns the entry with the smallest key strictly greater than
+   key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+*/
+void aa_tree_upper_bound(void **found_key,
+                         void **found_value,
+                         aa_tree_position_t *position,
+                         aa_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data);
+
+/* Returns the entry with the largest key less than or equal to
+   key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+*/
+void aa_tree_floor(void **found_key,
+                   void **found_value,
+                   aa_tree_position_t *position,
+                   aa_tree_t tree,
+                   void *key,
+                   int (*compare_key)(void *, void *, void *),
+                   void *data);
+
+/* Returns the entry with the smallest key greater than or equal
+   to key, together with its position. Same as
+   aa_tree_lower_bound.
+
+*/
+void aa_tree_ceiling(void **found_key,
+                     void **found_value,
+                     aa_tree_position_t *position,
+                     aa_tree_t tree,
+                     void *key,
+                     int (*compare_key)(void *, void *, void *),
+                     void *data);
+
+/* Returns the key resp. value of the entry at a position. */
+void *aa_tree_position_key(aa_tree_position_t position);
+void *aa_tree_position_value(aa_tree_position_t position);
+
+/* Returns the predecessor of a key and value associated with that
+   key, comparing the keys with compare_key.
+
+   Returns NULL for both the key and the value if the
+   key passed in argument cannot be found or if that
+   key has no predecessor.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void aa_tree_predecessor(void **prec_key,
+                         void **prec_value,
+                         aa_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data);
+
+/* Returns the successor of a key and value associated with that
+   key, comparing the keys with compare_key.
+
+   Returns NULL for both the key and the value if the
+   key passed in argument cannot be found or if that
+   key has no successor.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void aa_tree_successor(void **succ_key,
+                       void **succ_value,
+                       aa_tree_t tree,
+                       void *key,
+                       int (*compare_key)(void *, void *, void *),
+                       void *data);
+
+/* Positions a cursor on the first entry of a tree resp. on the end
+   position.
+
+   aa_tree_cursor_begin returns 1 if the cursor sits on an
+   entry and 0 if the tree is empty. aa_tree_cursor_end
+   always returns 0.
+
+   Forward traversal:  for (ok = aa_tree_cursor_begin(&c, t);
+                            ok; ok = aa_tree_cursor_next(&c))
+   Reverse traversal:  aa_tree_cursor_end(&c, t);
+                       while (aa_tree_cursor_prev(&c))
+
+*/
+int aa_tree_cursor_begin(aa_tree_cursor_t *cursor,
+                         aa_tree_t tree);
+int aa_tree_cursor_end(aa_tree_cursor_t *cursor,
+                       aa_tree_t tree);
+
+/* Positions a cursor on the entry with the smallest key greater
+   than or equal to key, or on the end position if there is none.
+
+   Returns 1 if the cursor sits on an entry, 0 otherwise.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int aa_tree_cursor_seek(aa_tree_cursor_t *cursor,
+                        aa_tree_t tree,
+                        void *key,
+                        int (*compare_key)(void *, void *, void *),
+                        void *data);
+
+/* Positions a cursor on the entry at position, or on the end
+   position if position is NULL.
+
+   Returns 1 if the cursor sits on an entry, 0 otherwise.
+
+*/
+int aa_tree_cursor_at(aa_tree_cursor_t *cursor,
+                      aa_tree_t tree,
+                      aa_tree_position_t position);
+
+/* Moves a cursor to the next resp. previous entry in key order.
+   Moving from the end position goes to the first resp. last entry.
+
+   Returns 1 if the cursor sits on an entry afterwards, 0 if it
+   reached the end position.
+
+*/
+int aa_tree_cursor_next(aa_tree_cursor_t *cursor);
+int aa_tree_cursor_prev(aa_tree_cursor_t *cursor);
+
+/* Returns 1 if a cursor sits on an entry, 0 if it sits on the
+   end position.
+*/
+int aa_tree_cursor_valid(aa_tree_cursor_t *cursor);
+
+/* Returns the key resp. value of the entry a cursor sits on.
+   The cursor must not sit on the end position.
+*/
+void *aa_tree_cursor_key(aa_tree_cursor_t *cursor);
+void *aa_tree_cursor_value(aa_tree_cursor_t *cursor);
+
+/* Returns the entry with the k-th smallest key, counting from zero,
+   together with its position, in O(log n) if the tree keeps subtree
+   sizes, see aa_tree_set_ranked, and in O(log n + k) by stepping
+   through the entries otherwise.
+
+   Returns NULL for the key, the value and the position if the tree
+   has k entries or less. position may be NULL if it is not needed.
+
+*/
+void aa_tree_select(void **found_key,
+                    void **found_value,
+                    aa_tree_position_t *position,
+                    aa_tree_t tree,
+                    size_t k);
+
+/* Returns the rank of a key, i.e. the number of keys in the tree
+   strictly less than key, in O(log n) with subtree sizes and in
+   O(log n + rank) otherwise. The key does not need to be present
+   in the tree.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t aa_tree_rank(aa_tree_t tree,
+                    void *key,
+                    int (*compare_key)(void *, void *, void *),
+                    void *data);
+
+/* Returns the number of entries with lo <= key < hi in O(log n)
+   with subtree sizes and in O(log n + k) for k such entries
+   otherwise. A NULL lo resp. hi leaves the range unbounded on that
+   side.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t aa_tree_count_in_range(aa_tree_t tree,
+                              void *lo,
+                              void *hi,
+                              int (*compare_key)(void *, void *, void *),
+                              void *data);
+
+/* Visits the entries with lo <= key < hi in key order, calling
+   visitor on each key and value with the data pointer, in
+   O(log n + k) for k visited entries.
+
+   A NULL lo resp. hi leaves the range unbounded on that side.
+   The scan stops early as soon as visitor returns a non-zero
+   value. If visitor is NULL, the entries are only counted, at the
+   cost of aa_tree_count_in_range.
+
+   Returns the number of entries visited, including the one on
+   which the scan was stopped.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t aa_tree_range_foreach(aa_tree_t tree,
+                             void *lo,
+                             void *hi,
+                             int (*compare_key)(void *, void *, void *),
+                             int (*visitor)(void *, void *, void *),
+                             void *data);
+
+/* Inserts a key and an associated value into a tree, comparing the
+   keys with compare_key and copying the key and value with the
+   copy_key resp. copy_value functions.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void aa_tree_insert(aa_tree_t tree,
+                    void *key,
+                    void *value,
+                    int (*compare_key)(void *, void *, void *),
+                    void *(*copy_key)(void *, void *),
+                    void *(*copy_value)(void *, void *),
+                    void *data);
+
+/* Inserts a key and an associated value into a tree unless the key
+   is already present, descending the tree only once.
+
+   Returns 1 if a new entry was inserted, copying the key and value
+   with copy_key resp. copy_value. Returns 0 if the key was already
+   present, in which case the tree is left unchanged.
+
+   In both cases, if value_in_tree is not NULL, it is set to the
+   value now associated with the key in the tree.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int aa_tree_insert_or_get(void **value_in_tree,
+                          aa_tree_t tree,
+                          void *key,
+                          void *value,
+                          int (*compare_key)(void *, void *, void *),
+                          void *(*copy_key)(void *, void *),
+                          void *(*copy_value)(void *, void *),
+                          void *data);
+
+/* Inserts a key and an associated value into a tree, or replaces
+   the value if the key is already present, descending the tree
+   only once.
+
+   A replaced value is deleted with delete_value and the new one
+   copied with copy_value in place; the stored key is kept. A new
+   entry copies both the key and the value. delete_value may be
+   NULL if the values need no cleanup.
+
+   Returns 1 if the key was already present, 0 otherwise.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int aa_tree_upsert(aa_tree_t tree,
+                   void *key,
+                   void *value,
+                   int (*compare_key)(void *, void *, void *),
+                   void *(*copy_key)(void *, void *),
+                   void *(*copy_value)(void *, void *),
+                   void (*delete_value)(void *, void *),
+                   void *data);
+
+/* Inserts n keys and their associated values into a tree, copying
+   them with copy_key resp. copy_value. Keys already present in the
+   tree, and repeated keys within the batch after their first
+   occurrence, are skipped as with aa_tree_insert.
+
+   The batch is sorted first unless its keys already come in
+   ascending order. Each key is then located by climbing from the
+   previous insertion point instead of descending from the root,
+   which saves comparisons and cache misses for clustered keys.
+
+   Returns the number of entries actually inserted.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t aa_tree_insert_batch(aa_tree_t tree,
+                            void **keys,
+                            void **values,
+                            size_t n,
+                            int (*compare_key)(void *, void *, void *),
+                            void *(*copy_key)(void *, void *),
+                            void *(*copy_value)(void *, void *),
+                            void *data);
+
+/* Removes a key and the associated value in a tree, comparing the
+   keys with compare_key and deleting the key and value with the
+   delete_key resp. delete_value function.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void aa_tree_remove(aa_tree_t tree,
+                    void *key,
+                    int (*compare_key)(void *, void *, void *),
+                    void (*delete_key)(void *, void *),
+                    void (*delete_value)(void *, void *),
+                    void *data);
+
+/* Takes an immutable snapshot of an AA tree for lookup-heavy
+   phases, copying the keys and values with copy_key resp. copy_value.
+   Either function may be NULL, in which case the snapshot shares the
+   keys resp. values with the tree, which then must not remove them
+   while the snapshot is in use.
+
+   The snapshot keeps its entries in arrays laid out in Eytzinger
+   (breadth-first) order, so a descent reads one contiguous array
+   instead of chasing node pointers, and the top levels shared by all
+   lookups stay in cache. The tree itself is not changed and may go
+   on being modified or be deleted afterwards.
+
+   If integer_key is not NULL, it maps a key and the data pointer to
+   a long long, and must preserve the order of the keys. The
+   snapshot then also stores the mapped keys and searches them with a
+   branchless, prefetching descent that never calls a compare_key
+   function; the compare_key arguments of the functions below are
+   ignored and may be NULL.
+
+   Runs in O(n).
+
+*/
+aa_tree_frozen_t aa_tree_freeze(aa_tree_t tree,
+                                void *(*copy_key)(void *, void *),
+                                void *(*copy_value)(void *, void *),
+                                long long (*integer_key)(void *, void *),
+                                void *data);
+
+/* Deletes a snapshot, calling delete_key and delete_value on each
+   key resp. value, passing in the data pointer. Either function may
+   be NULL, e.g. if the snapshot shares its keys resp. values with
+   the tree.
+*/
+void aa_tree_frozen_delete(aa_tree_frozen_t frozen,
+                           void (*delete_key)(void *, void *),
+                           void (*delete_value)(void *, void *),
+                           void *data);
+
+/* Returns the number of entries in a snapshot. */
+size_t aa_tree_frozen_number_entries(aa_tree_frozen_t frozen);
+
+/* Same as aa_tree_search, aa_tree_minimum,
+   aa_tree_maximum, aa_tree_lower_bound,
+   aa_tree_predecessor and aa_tree_successor,
+   on a snapshot.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void *aa_tree_frozen_search(aa_tree_frozen_t frozen,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data);
+void aa_tree_frozen_minimum(void **min_key,
+                            void **min_value,
+                            aa_tree_frozen_t frozen);
+void aa_tree_frozen_maximum(void **max_key,
+                            void **max_value,
+                            aa_tree_frozen_t frozen);
+void aa_tree_frozen_lower_bound(void **found_key,
+                                void **found_value,
+                                aa_tree_frozen_t frozen,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data);
+void aa_tree_frozen_predecessor(void **prec_key,
+                                void **prec_value,
+                                aa_tree_frozen_t frozen,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data);
+void aa_tree_frozen_successor(void **succ_key,
+                              void **succ_value,
+                              aa_tree_frozen_t frozen,
+                              void *key,
+                              int (*compare_key)(void *, void *, void *),
+                              void *data);
+
+/* Same as aa_tree_range_foreach on a snapshot. Runs in
+   O(log n + k) for k entries in the range, also when only
+   counting.
+
+*/
+size_t aa_tree_frozen_range_foreach(aa_tree_frozen_t frozen,
+                                    void *lo,
+                                    void *hi,
+                                    int (*compare_key)(void *, void *, void *),
+                                    int (*visitor)(void *, void *, void *),
+                                    void *data);
+
+#endif
@@ -0,0 +1,798 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* A node holds count keys. A leaf holds count entries, an inner
+   node count + 1 children, keys[i] being the smallest key in the
+   subtree children[i + 1]. The arrays have room for one key and
+   one child more than a node may keep, so that a node can overflow
+   by one before it is split.
+
+   In a tree with integer keys, integer_keys is used instead of keys.
+*/
+typedef struct __b_plus_node_struct_t *b_plus_node_t;
+struct __b_plus_node_struct_t
+{
+  int leaf;
+  size_t count;
+  b_plus_node_t prev;
+  b_plus_node_t next;
+  void **keys;
+  long long *integer_keys;
+  void **values;
+  b_plus_node_t *children;
+};
+
+struct __b_plus_tree_struct_t
+{
+  b_plus_node_t root;
+  size_t number_entries;
+  size_t height;
+  size_t fanout;
+  int integer_keys;
+};
+
+#include "bplustrees.h"
+
+#define B_PLUS_TREE_DEFAULT_FANOUT ((size_t)64)
+#define B_PLUS_TREE_MIN_FANOUT ((size_t)4)
+
+/* Every inner node has at least two children, so no tree that fits
+   in memory is higher than this.
+*/
+#define B_PLUS_TREE_MAX_HEIGHT 64
+
+static b_plus_tree_t __b_plus_tree_create(size_t fanout, int integer_keys)
+{
+  b_plus_tree_t tree;
+
+  tree = (b_plus_tree_t)calloc(1, sizeof(*tree));
+  if (tree == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  if (fanout == ((size_t)0))
+    fanout = B_PLUS_TREE_DEFAULT_FANOUT;
+  if (fanout < B_PLUS_TREE_MIN_FANOUT)
+    fanout = B_PLUS_TREE_MIN_FANOUT;
+  tree->root = NULL;
+  tree->number_entries = (size_t)0;
+  tree->height = (size_t)0;
+  tree->fanout = fanout;
+  tree->integer_keys = integer_keys;
+  return tree;
+}
+
+b_plus_tree_t b_plus_tree_create()
+{
+  return __b_plus_tree_create(B_PLUS_TREE_DEFAULT_FANOUT, 0);
+}
+
+b_plus_tree_t b_plus_tree_create_with_fanout(size_t fanout)
+{
+  return __b_plus_tree_create(fanout, 0);
+}
+
+b_plus_tree_t b_plus_tree_create_integer(size_t fanout)
+{
+  return __b_plus_tree_create(fanout, 1);
+}
+
+/* Allocates a node and its arrays in one block. */
+static b_plus_node_t __b_plus_tree_node_alloc(b_plus_tree_t tree, int leaf)
+{
+  b_plus_node_t node;
+  size_t key_bytes, link_bytes;
+  char *arrays;
+
+  key_bytes = tree->fanout * (tree->integer_keys ? sizeof(long long) : sizeof(void *));
+  link_bytes = (tree->fanout + ((size_t)1)) * sizeof(void *);
+  node = (b_plus_node_t)calloc(1, sizeof(*node) + key_bytes + link_bytes);
+  if (node == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+
+  arrays = (char *)(node + 1);
+  if (tree->integer_keys)
+    node->integer_keys = (long long *)arrays;
+  else
+    node->keys = (void **)arrays;
+  if (leaf)
+    node->values = (void **)(arrays + key_bytes);
+  else
+    node->children = (b_plus_node_t *)(arrays + key_bytes);
+  node->leaf = leaf;
+  node->count = (size_t)0;
+  node->prev = NULL;
+  node->next = NULL;
+  return node;
+}
+
+/* Releases the subtree below node. Its height is logarithmic, so
+   the recursion stays shallow.
+*/
+static void __b_plus_tree_delete_aux(b_plus_tree_t tree,
+                                     b_plus_node_t node,
+                                     void (*delete_key)(void *, void *),
+                                     void (*delete_value)(void *, void *),
+                                     void *data)
+{
+  size_t i;
+
+  if (node == NULL)
+    return;
+
+  if (node->leaf)
+  {
+    for (i = 0; i < node->count; i++)
+    {
+      if ((delete_key != NULL) && !tree->integer_keys)
+        delete_key(node->keys[i], data);
+      if (delete_value != NULL)
+        delete_value(node->values[i], data);
+    }
+  }
+  else
+  {
+    for (i = 0; i <= node->count; i++)
+      __b_plus_tree_delete_aux(tree, node->children[i], delete_key, delete_value, data);
+  }
+  free(node);
+}
+
+void b_plus_tree_delete(b_plus_tree_t tree,
+                        void (*delete_key)(void *, void *),
+                        void (*delete_value)(void *, void *),
+                        void *data)
+{
+  __b_plus_tree_delete_aux(tree, tree->root, delete_key, delete_value, data);
+  free(tree);
+}
+
+size_t b_plus_tree_number_entries(b_plus_tree_t tree)
+{
+  return tree->number_entries;
+}
+
+size_t b_plus_tree_height(b_plus_tree_t tree)
+{
+  return tree->height;
+}
+
+/* Returns the number of the n sorted keys that are less than x.
+
+   With AVX2, four keys are compared at once and the lanes holding a
+   smaller key are counted from the compare mask. As the keys are
+   sorted, the first group that is not entirely smaller ends the
+   count.
+*/
+static size_t __b_plus_tree_count_below(const long long *keys, size_t n, long long x)
+{
+  size_t i = 0, count = 0;
+
+#if defined(__AVX2__)
+  __m256i pivot, group;
+  int mask;
+
+  pivot = _mm256_set1_epi64x(x);
+  for (; i + ((size_t)4) <= n; i += (size_t)4)
+  {
+    group = _mm256_loadu_si256((const __m256i *)(keys + i));
+    mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(pivot, group)));
+    count += (size_t)__builtin_popcount((unsigned int)mask);
+    if (mask != 0xf)
+      return count;
+  }
+#endif
+
+  for (; i < n; i++)
+    count += (size_t)(keys[i] < x);
+  return count;
+}
+
+/* Returns the number of keys of node less than key, or less than
+   or equal to key if or_equal is set.
+*/
+static size_t __b_plus_tree_rank_in_node(b_plus_tree_t tree,
+                                         b_plus_node_t node,
+                                         void *key,
+                                         int or_equal,
+                                         int (*compare_key)(void *, void *, void *),
+                                         void *data)
+{
+  size_t lo, hi, mid;
+  long long x;
+  int c;
+
+  if (tree->integer_keys)
+  {
+    x = *((long long *)key);
+    if (or_equal)
+    {
+      if (x == LLONG_MAX)
+        return node->count;
+      x++;
+    }
+    return __b_plus_tree_count_below(node->integer_keys, node->count, x);
+  }
+
+  lo = (size_t)0;
+  hi = node->count;
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / ((size_t)2);
+    c = compare_key(node->keys[mid], key, data);
+    if ((c < 0) || (or_equal && (c == 0)))
+      lo = mid + ((size_t)1);
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* Returns 1 if the key at index i of node equals key. */
+static int __b_plus_tree_key_equals(b_plus_tree_t tree,
+                                    b_plus_node_t node,
+                                    size_t i,
+                                    void *key,
+                                    int (*compare_key)(void *, void *, void *),
+                                    void *data)
+{
+  if (i >= node->count)
+    return 0;
+  if (tree->integer_keys)
+    return node->integer_keys[i] == *((long long *)key);
+  return compare_key(node->keys[i], key, data) == 0;
+}
+
+/* Returns the key at index i of node as handed out to the user. */
+static void *__b_plus_tree_key(b_plus_tree_t tree, b_plus_node_t node, size_t i)
+{
+  if (tree->integer_keys)
+    return (void *)&node->integer_keys[i];
+  return node->keys[i];
+}
+
+/* Moves n keys from index si of node src to index di of node dst.
+   The ranges may overlap.
+*/
+static void __b_plus_tree_move_keys(b_plus_tree_t tree,
+                                    b_plus_node_t dst,
+                                    size_t di,
+                                    b_plus_node_t src,
+                                    size_t si,
+                                    size_t n)
+{
+  if (tree->integer_keys)
+    memmove(dst->integer_keys + di, src->integer_keys + si, n * sizeof(long long));
+  else
+    memmove(dst->keys + di, src->keys + si, n * sizeof(void *));
+}
+
+/* Moves n entries resp. children along with the keys. */
+static void __b_plus_tree_move_values(b_plus_node_t dst,
+                                      size_t di,
+                                      b_plus_node_t src,
+                                      size_t si,
+                                      size_t n)
+{
+  memmove(dst->values + di, src->values + si, n * sizeof(void *));
+}
+
+static void __b_plus_tree_move_children(b_plus_node_t dst,
+                                        size_t di,
+                                        b_plus_node_t src,
+                                        size_t si,
+                                        size_t n)
+{
+  memmove(dst->children + di, src->children + si, n * sizeof(b_plus_node_t));
+}
+
+/* Descends to the leaf that holds or would hold key. If path and
+   index are not NULL, the inner nodes passed and the child taken
+   in each are recorded there and their number is returned in
+   *depth.
+*/
+static b_plus_node_t __b_plus_tree_find_leaf(b_plus_node_t *path,
+                                             size_t *index,
+                                             size_t *depth,
+                                             b_plus_tree_t tree,
+                                             void *key,
+                                             int (*compare_key)(void *, void *, void *),
+                                             void *data)
+{
+  b_plus_node_t node;
+  size_t i, d = 0;
+
+  node = tree->root;
+  while ((node != NULL) && !node->leaf)
+  {
+    i = __b_plus_tree_rank_in_node(tree, node, key, 1, compare_key, data);
+    if (path != NULL)
+    {
+      path[d] = node;
+      index[d] = i;
+    }
+    d++;
+    node = node->children[i];
+  }
+  if (depth != NULL)
+    *depth = d;
+  return node;
+}
+
+void *b_plus_tree_search(b_plus_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data)
+{
+  b_plus_node_t leaf;
+  size_t i;
+
+  leaf = __b_plus_tree_find_leaf(NULL, NULL, NULL, tree, key, compare_key, data);
+  if (leaf == NULL)
+    return NULL;
+  i = __b_plus_tree_rank_in_node(tree, leaf, key, 0, compare_key, data);
+  if (!__b_plus_tree_key_equals(tree, leaf, i, key, compare_key, data))
+    return NULL;
+  return leaf->values[i];
+}
+
+static void __b_plus_tree_report(void **found_key,
+                                 void **found_value,
+                                 b_plus_tree_t tree,
+                                 b_plus_node_t leaf,
+                                 size_t i)
+{
+  if (leaf == NULL)
+  {
+    *found_key = NULL;
+    *found_value = NULL;
+    return;
+  }
+  *found_key = __b_plus_tree_key(tree, leaf, i);
+  *found_value = leaf->values[i];
+}
+
+void b_plus_tree_minimum(void **min_key,
+                         void **min_value,
+                         b_plus_tree_t tree)
+{
+  b_plus_node_t node;
+
+  for (node = tree->root; (node != NULL) && !node->leaf; node = node->children[0])
+    ;
+  __b_plus_tree_report(min_key, min_value, tree, node, (size_t)0);
+}
+
+void b_plus_tree_maximum(void **max_key,
+                         void **max_value,
+                         b_plus_tree_t tree)
+{
+  b_plus_node_t node;
+
+  for (node = tree->root; (node != NULL) && !node->leaf; node = node->children[node->count])
+    ;
+  __b_plus_tree_report(max_key, max_value, tree, node,
+                       (node == NULL) ? ((size_t)0) : node->count - ((size_t)1));
+}
+
+void b_plus_tree_predecessor(void **prec_key,
+                             void **prec_value,
+                             b_plus_tree_t tree,
+                             void *key,
+                             int (*compare_key)(void *, void *, void *),
+                             void *data)
+{
+  b_plus_node_t leaf;
+  size_t i = 0;
+
+  leaf = __b_plus_tree_find_leaf(NULL, NULL, NULL, tree, key, compare_key, data);
+  if (leaf != NULL)
+  {
+    i = __b_plus_tree_rank_in_node(tree, leaf, key, 0, compare_key, data);
+    if (!__b_plus_tree_key_equals(tree, leaf, i, key, compare_key, data))
+    {
+      leaf = NULL;
+    }
+    else if (i > 0)
+    {
+      i--;
+    }
+    else
+    {
+      leaf = leaf->prev;
+      if (leaf != NULL)
+        i = leaf->count - ((size_t)1);
+    }
+  }
+  __b_plus_tree_report(prec_key, prec_value, tree, leaf, i);
+}
+
+void b_plus_tree_successor(void **succ_key,
+                           void **succ_value,
+                           b_plus_tree_t tree,
+                           void *key,
+                           int (*compare_key)(void *, void *, void *),
+                           void *data)
+{
+  b_plus_node_t leaf;
+  size_t i = 0;
+
+  leaf = __b_plus_tree_find_leaf(NULL, NULL, NULL, tree, key, compare_key, data);
+  if (leaf != NULL)
+  {
+    i = __b_plus_tree_rank_in_node(tree, leaf, key, 0, compare_key, data);
+    if (!__b_plus_tree_key_equals(tree, leaf, i, key, compare_key, data))
+    {
+      leaf = NULL;
+    }
+    else if (i + ((size_t)1) < leaf->count)
+    {
+      i++;
+    }
+    else
+    {
+      leaf = leaf->next;
+      i = (size_t)0;
+    }
+  }
+  __b_plus_tree_report(succ_key, succ_value, tree, leaf, i);
+}
+
+size_t b_plus_tree_range_foreach(b_plus_tree_t tree,
+                                 void *lo,
+                                 void *hi,
+                                 int (*compare_key)(void *, void *, void *),
+                                 int (*visitor)(void *, void *, void *),
+                                 void *data)
+{
+  b_plus_node_t leaf;
+  size_t i, end, count = (size_t)0;
+
+  if (lo == NULL)
+  {
+    for (leaf = tree->root; (leaf != NULL) && !leaf->leaf; leaf = leaf->children[0])
+      ;
+    i = (size_t)0;
+  }
+  else
+  {
+    leaf = __b_plus_tree_find_leaf(NULL, NULL, NULL, tree, lo, compare_key, data);
+    i = (leaf == NULL) ? ((size_t)0) : __b_plus_tree_rank_in_node(tree, leaf, lo, 0, compare_key, data);
+  }
+
+  for (; leaf != NULL; leaf = leaf->next, i = (size_t)0)
+  {
+    // Find where the range ends within this leaf with one search
+    // instead of comparing every entry against hi.
+    end = (hi == NULL) ? leaf->count : __b_plus_tree_rank_in_node(tree, leaf, hi, 0, compare_key, data);
+    for (; i < end; i++)
+    {
+      count++;
+      if ((visitor != NULL) &&
+          visitor(__b_plus_tree_key(tree, leaf, i), leaf->values[i], data))
+        return count;
+    }
+    if (end < leaf->count)
+      break;
+  }
+  return count;
+}
+
+/* Splits the overflowing node, the child at index i of parent or
+   the root if parent is NULL, moving its upper half to a new right
+   sibling and the key separating them up to the parent.
+*/
+static void __b_plus_tree_split(b_plus_tree_t tree,
+                                b_plus_node_t parent,
+                                size_t i,
+                                b_plus_node_t node)
+{
+  b_plus_node_t right;
+  size_t half, separator;
+
+  right = __b_plus_tree_node_alloc(tree, node->leaf);
+  half = node->count / ((size_t)2);
+  if (node->leaf)
+  {
+    // The right leaf keeps its smallest key, a copy of which goes up.
+    right->count = node->count - half;
+    __b_plus_tree_move_keys(tree, right, 0, node, half, right->count);
+    __b_plus_tree_move_values(right, 0, node, half, right->count);
+    node->count = half;
+    right->prev = node;
+    right->next = node->next;
+    if (node->next != NULL)
+      node->next->prev = right;
+    node->next = right;
+    separator = (size_t)0;
+  }
+  else
+  {
+    // The middle key moves up and is dropped from both halves.
+    right->count = node->count - half - ((size_t)1);
+    __b_plus_tree_move_keys(tree, right, 0, node, half + ((size_t)1), right->count);
+    __b_plus_tree_move_children(right, 0, node, half + ((size_t)1), right->count + ((size_t)1));
+    node->count = half;
+    separator = half;
+  }
+
+  if (parent == NULL)
+  {
+    parent = __b_plus_tree_node_alloc(tree, 0);
+    parent->children[0] = node;
+    tree->root = parent;
+    tree->height++;
+    i = (size_t)0;
+  }
+  __b_plus_tree_move_keys(tree, parent, i + ((size_t)1), parent, i, parent->count - i);
+  __b_plus_tree_move_children(parent, i + ((size_t)2), parent, i + ((size_t)1), parent->count - i);
+  __b_plus_tree_move_keys(tree, parent, i, node->leaf ? right : node, separator, (size_t)1);
+  parent->children[i + ((size_t)1)] = right;
+  parent->count++;
+}
+
+void b_plus_tree_insert(b_plus_tree_t tree,
+                        void *key,
+                        void *value,
+                        int (*compare_key)(void *, void *, void *),
+                        void *(*copy_key)(void *, void *),
+                        void *(*copy_value)(void *, void *),
+                        void *data)
+{
+  b_plus_node_t path[B_PLUS_TREE_MAX_HEIGHT];
+  size_t index[B_PLUS_TREE_MAX_HEIGHT];
+  b_plus_node_t node;
+  size_t depth, i;
+
+  if (tree->root == NULL)
+  {
+    tree->root = __b_plus_tree_node_alloc(tree, 1);
+    tree->height = (size_t)1;
+  }
+
+  node = __b_plus_tree_find_leaf(path, index, &depth, tree, key, compare_key, data);
+  i = __b_plus_tree_rank_in_node(tree, node, key, 0, compare_key, data);
+  if (__b_plus_tree_key_equals(tree, node, i, key, compare_key, data))
+    return;
+
+  __b_plus_tree_move_keys(tree, node, i + ((size_t)1), node, i, node->count - i);
+  __b_plus_tree_move_values(node, i + ((size_t)1), node, i, node->count - i);
+  if (tree->integer_keys)
+    node->integer_keys[i] = *((long long *)key);
+  else
+    node->keys[i] = copy_key(key, data);
+  node->values[i] = copy_value(value, data);
+  node->count++;
+  tree->number_entries++;
+
+  // A node may keep fanout - 1 keys; split on the way up as long
+  // as nodes overflow.
+  while (node->count >= tree->fanout)
+  {
+    if (depth == ((size_t)0))
+    {
+      __b_plus_tree_split(tree, NULL, 0, node);
+      break;
+    }
+    depth--;
+    __b_plus_tree_split(tree, path[depth], index[depth], node);
+    node = path[depth];
+  }
+}
+
+/* Moves the last entry resp. child of left, the sibling before
+   node, over to node, rotating the separator at index i of parent.
+*/
+static void __b_plus_tree_borrow_left(b_plus_tree_t tree,
+                                      b_plus_node_t parent,
+                                      size_t i,
+                                      b_plus_node_t left,
+                                      b_plus_node_t node)
+{
+  __b_plus_tree_move_keys(tree, node, 1, node, 0, node->count);
+  if (node->leaf)
+  {
+    __b_plus_tree_move_values(node, 1, node, 0, node->count);
+    __b_plus_tree_move_keys(tree, node, 0, left, left->count - ((size_t)1), 1);
+    node->values[0] = left->values[left->count - ((size_t)1)];
+    __b_plus_tree_move_keys(tree, parent, i, node, 0, 1);
+  }
+  else
+  {
+    __b_plus_tree_move_children(node, 1, node, 0, node->count + ((size_t)1));
+    __b_plus_tree_move_keys(tree, node, 0, parent, i, 1);
+    node->children[0] = left->children[left->count];
+    __b_plus_tree_move_keys(tree, parent, i, left, left->count - ((size_t)1), 1);
+  }
+  left->count--;
+  node->count++;
+}
+
+/* Moves the first entry resp. child of right, the sibling after
+   node, over to node, rotating the separator at index i of parent.
+*/
+static void __b_plus_tree_borrow_right(b_plus_tree_t tree,
+                                       b_plus_node_t parent,
+                                       size_t i,
+                                       b_plus_node_t node,
+                                       b_plus_node_t right)
+{
+  if (node->leaf)
+  {
+    __b_plus_tree_move_keys(tree, node, node->count, right, 0, 1);
+    node->values[node->count] = right->values[0];
+    __b_plus_tree_move_keys(tree, right, 0, right, 1, right->count - ((size_t)1));
+    __b_plus_tree_move_values(right, 0, right, 1, right->count - ((size_t)1));
+    __b_plus_tree_move_keys(tree, parent, i, right, 0, 1);
+  }
+  else
+  {
+    __b_plus_tree_move_keys(tree, node, node->count, parent, i, 1);
+    node->children[node->count + ((size_t)1)] = right->children[0];
+    __b_plus_tree_move_keys(tree, parent, i, right, 0, 1);
+    __b_plus_tree_move_keys(tree, right, 0, right, 1, right->count - ((size_t)1));
+    __b_plus_tree_move_children(right, 0, right, 1, right->count);
+  }
+  right->count--;
+  node->count++;
+}
+
+/* Merges right, the child at index i + 1 of parent, into left, the
+   child at index i, dropping the separator between them.
+*/
+static void __b_plus_tree_merge(b_plus_tree_t tree,
+                                b_plus_node_t parent,
+                                size_t i,
+                                b_plus_node_t left,
+                                b_plus_node_t right)
+{
+  if (left->leaf)
+  {
+    __b_plus_tree_move_keys(tree, left, left->count, right, 0, right->count);
+    __b_plus_tree_move_values(left, left->count, right, 0, right->count);
+    left->count += right->count;
+    left->next = right->next;
+    if (right->next != NULL)
+      right->next->prev = left;
+  }
+  else
+  {
+    __b_plus_tree_move_keys(tree, left, left->count, parent, i, 1);
+    __b_plus_tree_move_keys(tree, left, left->count + ((size_t)1), right, 0, right->count);
+    __b_plus_tree_move_children(left, left->count + ((size_t)1), right, 0, right->count + ((size_t)1));
+    left->count += right->count + ((size_t)1);
+  }
+  free(right);
+
+  __b_plus_tree_move_keys(tree, parent, i, parent, i + ((size_t)1), parent->count - i - ((size_t)1));
+  __b_plus_tree_move_children(parent, i + ((size_t)1), parent, i + ((size_t)2), parent->count - i - ((size_t)1));
+  parent->count--;
+}
+
+/* Refills nodes on the path that have fallen below half full by
+   borrowing from or merging with a sibling, then shrinks the root
+   if it was left with a single child or no entry.
+*/
+static void __b_plus_tree_rebalance(b_plus_tree_t tree,
+                                    b_plus_node_t node,
+                                    b_plus_node_t *path,
+                                    size_t *index,
+                                    size_t depth)
+{
+  b_plus_node_t parent, left, right, root;
+  size_t min_count, i;
+
+  min_count = (tree->fanout - ((size_t)1)) / ((size_t)2);
+  while ((depth > ((size_t)0)) && (node->count < min_count))
+  {
+    depth--;
+    parent = path[depth];
+    i = index[depth];
+    left = (i > ((size_t)0)) ? parent->children[i - ((size_t)1)] : NULL;
+    right = (i < parent->count) ? parent->children[i + ((size_t)1)] : NULL;
+
+    if ((left != NULL) && (left->count > min_count))
+    {
+      __b_plus_tree_borrow_left(tree, parent, i - ((size_t)1), left, node);
+      return;
+    }
+    if ((right != NULL) && (right->count > min_count))
+    {
+      __b_plus_tree_borrow_right(tree, parent, i, node, right);
+      return;
+    }
+    if (left != NULL)
+      __b_plus_tree_merge(tree, parent, i - ((size_t)1), left, node);
+    else
+      __b_plus_tree_merge(tree, parent, i, node, right);
+    node = parent;
+  }
+
+  root = tree->root;
+  if (!root->leaf && (root->count == ((size_t)0)))
+  {
+    tree->root = root->children[0];
+    tree->height--;
+    free(root);
+  }
+  else if (root->leaf && (root->count == ((size_t)0)))
+  {
+    tree->root = NULL;
+    tree->height = (size_t)0;
+    free(root);
+  }
+}
+
+/* After removing the smallest key of a leaf, an inner node on the
+   way down to it may still point to that key as a separator. Points
+   it to the new smallest key of the subtree instead.
+*/
+static void __b_plus_tree_replace_separator(b_plus_tree_t tree,
+                                            void *old_key,
+                                            int (*compare_key)(void *, void *, void *),
+                                            void *data)
+{
+  b_plus_node_t node, child;
+  size_t i;
+
+  for (node = tree->root; (node != NULL) && !node->leaf; node = node->children[i])
+  {
+    i = __b_plus_tree_rank_in_node(tree, node, old_key, 1, compare_key, data);
+    if ((i > ((size_t)0)) && (node->keys[i - ((size_t)1)] == old_key))
+    {
+      for (child = node->children[i]; !child->leaf; child = child->children[0])
+        ;
+      node->keys[i - ((size_t)1)] = child->keys[0];
+      return;
+    }
+  }
+}
+
+void b_plus_tree_remove(b_plus_tree_t tree,
+                        void *key,
+                        int (*compare_key)(void *, void *, void *),
+                        void (*delete_key)(void *, void *),
+                        void (*delete_value)(void *, void *),
+                        void *data)
+{
+  b_plus_node_t path[B_PLUS_TREE_MAX_HEIGHT];
+  size_t index[B_PLUS_TREE_MAX_HEIGHT];
+  b_plus_node_t node;
+  size_t depth, i;
+  void *old_key, *old_value;
+
+  node = __b_plus_tree_find_leaf(path, index, &depth, tree, key, compare_key, data);
+  if (node == NULL)
+    return;
+  i = __b_plus_tree_rank_in_node(tree, node, key, 0, compare_key, data);
+  if (!__b_plus_tree_key_equals(tree, node, i, key, compare_key, data))
+    return;
+
+  old_key = tree->integer_keys ? NULL : node->keys[i];
+  old_value = node->values[i];
+  __b_plus_tree_move_keys(tree, node, i, node, i + ((size_t)1), node->count - i - ((size_t)1));
+  __b_plus_tree_move_values(node, i, node, i + ((size_t)1), node->count - i - ((size_t)1));
+  node->count--;
+  tree->number_entries--;
+
+  __b_plus_tree_rebalance(tree, node, path, index, depth);
+
+  // Integer separators are plain copies, but a separator of any
+  // other tree points to a key in a leaf and must not outlive it.
+  if ((old_key != NULL) && (i == ((size_t)0)))
+    __b_plus_tree_replace_separator(tree, old_key, compare_key, data);
+
+  if ((delete_key != NULL) && (old_key != NULL))
+    delete_key(old_key, data);
+  if (delete_value != NULL)
+    delete_value(old_value, data);
+}
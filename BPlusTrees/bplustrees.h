@@ -0,0 +1,202 @@
+#ifndef B_PLUS_TREES_H
+#define B_PLUS_TREES_H
+
+#include <stdlib.h>
+
+typedef struct __b_plus_tree_struct_t *b_plus_tree_t;
+
+/* Creates an empty B+ tree with the default fan-out */
+b_plus_tree_t b_plus_tree_create();
+
+/* Creates an empty B+ tree whose nodes have up to fanout children
+   resp. fanout - 1 entries.
+
+   All entries are kept in the leaves, which are linked in key
+   order; inner nodes only hold copies of the smallest key of each
+   of their subtrees but the first. A larger fan-out makes the tree
+   flatter and packs more keys per cache line at the price of longer
+   moves inside a node on insertion and removal.
+
+   The default fan-out is used if fanout is zero; fan-outs below
+   four are raised to four.
+
+*/
+b_plus_tree_t b_plus_tree_create_with_fanout(size_t fanout);
+
+/* Creates an empty B+ tree whose keys are long long integers, with
+   up to fanout children per node as for
+   b_plus_tree_create_with_fanout.
+
+   Keys are passed in and handed out as pointers to long long and
+   are stored by value in the nodes, so each node keeps its keys in
+   one contiguous array. Lookups count the keys below the sought for
+   one with vector compares where the target supports AVX2 (compile
+   with -mavx2), without calling any comparison function.
+
+   The compare_key, copy_key and delete_key arguments of all other
+   functions are ignored for such a tree and may be NULL. Keys
+   handed out point into a leaf and stay valid only until the tree
+   is next modified.
+
+*/
+b_plus_tree_t b_plus_tree_create_integer(size_t fanout);
+
+/* Deletes a B+ tree, calling delete_key and delete_value
+   on each key resp. value, passing in the data pointer.
+
+   Either function may be NULL if the keys resp. values need no
+   cleanup.
+*/
+void b_plus_tree_delete(b_plus_tree_t tree,
+                        void (*delete_key)(void *, void *),
+                        void (*delete_value)(void *, void *),
+                        void *data);
+
+/* Returns the number of entries in a B+ tree
+
+   Returns zero for an empty tree. Runs in constant time.
+
+*/
+size_t b_plus_tree_number_entries(b_plus_tree_t tree);
+
+/* Returns the height of a B+ tree, i.e. the number of nodes on
+   the path from the root down to any leaf, all leaves being on
+   the same level.
+
+   Returns zero for an empty tree. Runs in constant time.
+
+*/
+size_t b_plus_tree_height(b_plus_tree_t tree);
+
+/* Searches a B+ tree for a key, comparing keys with
+   compare_key, returning the associated value.
+
+   Returns NULL if the sought for key cannot be found.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void *b_plus_tree_search(b_plus_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data);
+
+/* Returns the minimum key and associated value.
+
+   Returns NULL for both the key and the value if the
+   tree is empty.
+
+*/
+void b_plus_tree_minimum(void **min_key,
+                         void **min_value,
+                         b_plus_tree_t tree);
+
+/* Returns the maximum key and associated value.
+
+   Returns NULL for both the key and the value if the
+   tree is empty.
+
+*/
+void b_plus_tree_maximum(void **max_key,
+                         void **max_value,
+                         b_plus_tree_t tree);
+
+/* Returns the predecessor of a key and value associated with that
+   key, comparing the keys with compare_key.
+
+   Returns NULL for both the key and the value if the
+   key passed in argument cannot be found or if that
+   key has no predecessor.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void b_plus_tree_predecessor(void **prec_key,
+                             void **prec_value,
+                             b_plus_tree_t tree,
+                             void *key,
+                             int (*compare_key)(void *, void *, void *),
+                             void *data);
+
+/* Returns the successor of a key and value associated with that
+   key, comparing the keys with compare_key.
+
+   Returns NULL for both the key and the value if the
+   key passed in argument cannot be found or if that
+   key has no successor.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void b_plus_tree_successor(void **succ_key,
+                           void **succ_value,
+                           b_plus_tree_t tree,
+                           void *key,
+                           int (*compare_key)(void *, void *, void *),
+                           void *data);
+
+/* Visits the entries with lo <= key < hi in key order, calling
+   visitor on each key and value with the data pointer. After one
+   descent to the first entry, the scan follows the leaf links.
+
+   A NULL lo resp. hi leaves the range unbounded on that side.
+   The scan stops early as soon as visitor returns a non-zero
+   value. If visitor is NULL, the entries are only counted.
+
+   Returns the number of entries visited, including the one on
+   which the scan was stopped.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t b_plus_tree_range_foreach(b_plus_tree_t tree,
+                                 void *lo,
+                                 void *hi,
+                                 int (*compare_key)(void *, void *, void *),
+                                 int (*visitor)(void *, void *, void *),
+                                 void *data);
+
+/* Inserts a key and an associated value into a tree, comparing the
+   keys with compare_key and copying the key and value with the
+   copy_key resp. copy_value functions.
+
+   The tree is left unchanged if the key is already present.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void b_plus_tree_insert(b_plus_tree_t tree,
+                        void *key,
+                        void *value,
+                        int (*compare_key)(void *, void *, void *),
+                        void *(*copy_key)(void *, void *),
+                        void *(*copy_value)(void *, void *),
+                        void *data);
+
+/* Removes a key and the associated value in a tree, comparing the
+   keys with compare_key and deleting the key and value with the
+   delete_key resp. delete_value function.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void b_plus_tree_remove(b_plus_tree_t tree,
+                        void *key,
+                        int (*compare_key)(void *, void *, void *),
+                        void (*delete_key)(void *, void *),
+                        void (*delete_value)(void *, void *),
+                        void *data);
+
+#endif
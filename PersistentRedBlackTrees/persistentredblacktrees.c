@@ -0,0 +1,589 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+typedef enum
+{
+  PERSISTENT_RED_BLACK_TREE_COLOR_RED = 0,
+  PERSISTENT_RED_BLACK_TREE_COLOR_BLACK = 1
+} color_t;
+
+/* A key and value shared by all copies of the node holding them.
+   references counts these nodes.
+*/
+typedef struct __tree_entry_struct_t *tree_entry_t;
+struct __tree_entry_struct_t
+{
+  void *key;
+  void *value;
+  _Atomic size_t references;
+};
+
+/* Nodes have no parent pointer, since a node may have one parent
+   in each version sharing it. references counts the links to the
+   node, from parent nodes and from version handles.
+
+   stamp is the number of the write that created the node. Until
+   the write returns its version, it may modify the nodes carrying
+   its stamp in place; no other node is ever modified.
+*/
+typedef struct __tree_node_struct_t *tree_node_t;
+struct __tree_node_struct_t
+{
+  tree_entry_t entry;
+  tree_node_t left;
+  tree_node_t right;
+  color_t color;
+  uint64_t stamp;
+  _Atomic size_t references;
+};
+
+/* A red-black tree holding n entries is at most 2 log2(n + 1) high. */
+#define PERSISTENT_RED_BLACK_TREE_MAX_HEIGHT ((size_t)128)
+
+struct __persistent_red_black_tree_struct_t
+{
+  tree_node_t root;
+  size_t number_entries;
+  void (*delete_key)(void *, void *);
+  void (*delete_value)(void *, void *);
+  void *data;
+};
+
+#include "persistentredblacktrees.h"
+
+/* Source of write stamps, shared by all trees since writes on
+   different versions may run concurrently. Stamp 0 is never used.
+*/
+static _Atomic uint64_t __persistent_red_black_tree_stamps;
+
+static void *__persistent_red_black_tree_malloc(size_t size)
+{
+  void *ptr;
+
+  ptr = malloc(size);
+  if (ptr == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  return ptr;
+}
+
+static void __persistent_red_black_tree_retain(tree_node_t node)
+{
+  if (node != NULL)
+    atomic_fetch_add_explicit(&node->references, (size_t)1, memory_order_relaxed);
+}
+
+static void __persistent_red_black_tree_release_entry(persistent_red_black_tree_t tree,
+                                                      tree_entry_t entry)
+{
+  if (atomic_fetch_sub_explicit(&entry->references, (size_t)1, memory_order_acq_rel) != ((size_t)1))
+    return;
+  if (tree->delete_key != NULL)
+    tree->delete_key(entry->key, tree->data);
+  if (tree->delete_value != NULL)
+    tree->delete_value(entry->value, tree->data);
+  free(entry);
+}
+
+/* Drops one link to a node, freeing the node and releasing its
+   children once the last link is gone.
+*/
+static void __persistent_red_black_tree_release(persistent_red_black_tree_t tree,
+                                                tree_node_t node)
+{
+  if (node == NULL)
+    return;
+  if (atomic_fetch_sub_explicit(&node->references, (size_t)1, memory_order_acq_rel) != ((size_t)1))
+    return;
+  __persistent_red_black_tree_release_entry(tree, node->entry);
+  __persistent_red_black_tree_release(tree, node->left);
+  __persistent_red_black_tree_release(tree, node->right);
+  free(node);
+}
+
+static persistent_red_black_tree_t __persistent_red_black_tree_version(persistent_red_black_tree_t tree,
+                                                                       tree_node_t root,
+                                                                       size_t number_entries)
+{
+  persistent_red_black_tree_t version;
+
+  version = __persistent_red_black_tree_malloc(sizeof(*version));
+  version->root = root;
+  version->number_entries = number_entries;
+  version->delete_key = tree->delete_key;
+  version->delete_value = tree->delete_value;
+  version->data = tree->data;
+  return version;
+}
+
+persistent_red_black_tree_t persistent_red_black_tree_create(void (*delete_key)(void *, void *),
+                                                             void (*delete_value)(void *, void *),
+                                                             void *data)
+{
+  persistent_red_black_tree_t tree;
+
+  tree = __persistent_red_black_tree_malloc(sizeof(*tree));
+  tree->root = NULL;
+  tree->number_entries = (size_t)0;
+  tree->delete_key = delete_key;
+  tree->delete_value = delete_value;
+  tree->data = data;
+  return tree;
+}
+
+persistent_red_black_tree_t persistent_red_black_tree_snapshot(persistent_red_black_tree_t tree)
+{
+  __persistent_red_black_tree_retain(tree->root);
+  return __persistent_red_black_tree_version(tree, tree->root, tree->number_entries);
+}
+
+void persistent_red_black_tree_delete(persistent_red_black_tree_t tree)
+{
+  __persistent_red_black_tree_release(tree, tree->root);
+  free(tree);
+}
+
+size_t persistent_red_black_tree_number_entries(persistent_red_black_tree_t tree)
+{
+  return tree->number_entries;
+}
+
+static size_t __persistent_red_black_tree_height_aux(tree_node_t node)
+{
+  size_t l, r;
+
+  if (node == NULL)
+    return ((size_t)0);
+  l = __persistent_red_black_tree_height_aux(node->left);
+  r = __persistent_red_black_tree_height_aux(node->right);
+  return ((l > r) ? l : r) + ((size_t)1);
+}
+
+size_t persistent_red_black_tree_height(persistent_red_black_tree_t tree)
+{
+  return __persistent_red_black_tree_height_aux(tree->root);
+}
+
+void *persistent_red_black_tree_search(persistent_red_black_tree_t tree,
+                                       void *key,
+                                       int (*compare_key)(void *, void *, void *),
+                                       void *data)
+{
+  tree_node_t node;
+  int cmp;
+
+  node = tree->root;
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->entry->key, data);
+    if (cmp == 0)
+      return node->entry->value;
+    if (cmp < 0)
+    {
+      node = node->left;
+    }
+    else
+    {
+      node = node->right;
+    }
+  }
+  return NULL;
+}
+
+void persistent_red_black_tree_minimum(void **min_key,
+                                       void **min_value,
+                                       persistent_red_black_tree_t tree)
+{
+  tree_node_t node;
+
+  node = tree->root;
+  if (node == NULL)
+  {
+    *min_key = NULL;
+    *min_value = NULL;
+    return;
+  }
+  while (node->left != NULL)
+    node = node->left;
+  *min_key = node->entry->key;
+  *min_value = node->entry->value;
+}
+
+void persistent_red_black_tree_maximum(void **max_key,
+                                       void **max_value,
+                                       persistent_red_black_tree_t tree)
+{
+  tree_node_t node;
+
+  node = tree->root;
+  if (node == NULL)
+  {
+    *max_key = NULL;
+    *max_value = NULL;
+    return;
+  }
+  while (node->right != NULL)
+    node = node->right;
+  *max_key = node->entry->key;
+  *max_value = node->entry->value;
+}
+
+size_t persistent_red_black_tree_range_foreach(persistent_red_black_tree_t tree,
+                                               void *lo,
+                                               void *hi,
+                                               int (*compare_key)(void *, void *, void *),
+                                               int (*visitor)(void *, void *, void *),
+                                               void *data)
+{
+  tree_node_t stack[PERSISTENT_RED_BLACK_TREE_MAX_HEIGHT];
+  tree_node_t node;
+  size_t depth, count;
+
+  /* Without parent pointers, the in-order walk keeps the nodes
+     whose left subtree is being visited on a stack, which the
+     height bound keeps small.
+  */
+  depth = (size_t)0;
+  node = tree->root;
+  while (node != NULL)
+  {
+    if ((lo == NULL) || (compare_key(node->entry->key, lo, data) >= 0))
+    {
+      stack[depth++] = node;
+      node = node->left;
+    }
+    else
+    {
+      node = node->right;
+    }
+  }
+
+  count = (size_t)0;
+  while (depth > ((size_t)0))
+  {
+    node = stack[--depth];
+    if ((hi != NULL) && (compare_key(node->entry->key, hi, data) >= 0))
+      break;
+    count++;
+    if ((visitor != NULL) && visitor(node->entry->key, node->entry->value, data))
+      break;
+    for (node = node->right; node != NULL; node = node->left)
+      stack[depth++] = node;
+  }
+  return count;
+}
+
+/* Returns the node at *link after making sure the current write may
+   modify it in place. A node of an earlier write is replaced at
+   *link by a copy, which links to the same children and entry; the
+   link to the original is dropped.
+*/
+static tree_node_t __persistent_red_black_tree_own(persistent_red_black_tree_t tree,
+                                                   uint64_t stamp,
+                                                   tree_node_t *link)
+{
+  tree_node_t node, copy;
+
+  node = *link;
+  if ((node == NULL) || (node->stamp == stamp))
+    return node;
+
+  copy = __persistent_red_black_tree_malloc(sizeof(*copy));
+  copy->entry = node->entry;
+  copy->left = node->left;
+  copy->right = node->right;
+  copy->color = node->color;
+  copy->stamp = stamp;
+  atomic_init(&copy->references, (size_t)1);
+  atomic_fetch_add_explicit(&copy->entry->references, (size_t)1, memory_order_relaxed);
+  __persistent_red_black_tree_retain(copy->left);
+  __persistent_red_black_tree_retain(copy->right);
+
+  *link = copy;
+  __persistent_red_black_tree_release(tree, node);
+  return copy;
+}
+
+static tree_node_t __persistent_red_black_tree_own_child(persistent_red_black_tree_t tree,
+                                                         uint64_t stamp,
+                                                         tree_node_t node,
+                                                         int dir)
+{
+  return __persistent_red_black_tree_own(tree, stamp, dir ? &node->right : &node->left);
+}
+
+static int __persistent_red_black_tree_is_black(tree_node_t node)
+{
+  return (node == NULL) || (node->color == PERSISTENT_RED_BLACK_TREE_COLOR_BLACK);
+}
+
+/* Returns the link pointing to path[k], which is the root for k = 0
+   and a child pointer of path[k - 1] otherwise.
+*/
+static tree_node_t *__persistent_red_black_tree_link(tree_node_t *root,
+                                                     tree_node_t *path,
+                                                     int *dirs,
+                                                     size_t k)
+{
+  if (k == ((size_t)0))
+    return root;
+  return dirs[k - ((size_t)1)] ? &path[k - ((size_t)1)]->right : &path[k - ((size_t)1)]->left;
+}
+
+/* Rotates left (dir = 0) or right (dir = 1) at x, whose link is
+   stored in *link. Both x and the child moving up must be owned by
+   the current write. Every subtree keeps exactly one link, so no
+   reference count changes.
+*/
+static tree_node_t __persistent_red_black_tree_rotate(tree_node_t *link,
+                                                      tree_node_t x,
+                                                      int dir)
+{
+  tree_node_t y;
+
+  if (dir == 0)
+  {
+    y = x->right;
+    x->right = y->left;
+    y->left = x;
+  }
+  else
+  {
+    y = x->left;
+    x->left = y->right;
+    y->right = x;
+  }
+  *link = y;
+  return y;
+}
+
+/* Starts a write: the new version links to the root of tree, and
+   the write gets a stamp of its own.
+*/
+static uint64_t __persistent_red_black_tree_begin(tree_node_t *root,
+                                                  persistent_red_black_tree_t tree)
+{
+  *root = tree->root;
+  __persistent_red_black_tree_retain(*root);
+  return atomic_fetch_add_explicit(&__persistent_red_black_tree_stamps, (uint64_t)1,
+                                   memory_order_relaxed) + ((uint64_t)1);
+}
+
+persistent_red_black_tree_t persistent_red_black_tree_insert(persistent_red_black_tree_t tree,
+                                                             void *key,
+                                                             void *value,
+                                                             int (*compare_key)(void *, void *, void *),
+                                                             void *(*copy_key)(void *, void *),
+                                                             void *(*copy_value)(void *, void *),
+                                                             void *data)
+{
+  tree_node_t path[PERSISTENT_RED_BLACK_TREE_MAX_HEIGHT + ((size_t)1)];
+  int dirs[PERSISTENT_RED_BLACK_TREE_MAX_HEIGHT + ((size_t)1)];
+  tree_node_t root, x, z, parent, grand, uncle;
+  uint64_t stamp;
+  size_t d, k;
+  int cmp, side;
+
+  d = (size_t)0;
+  for (x = tree->root; x != NULL; x = (cmp < 0) ? x->left : x->right)
+  {
+    cmp = compare_key(key, x->entry->key, data);
+    if (cmp == 0)
+      return persistent_red_black_tree_snapshot(tree);
+    dirs[d] = (cmp > 0);
+    d++;
+  }
+
+  // Copy the whole path, the new node changes its last link.
+  stamp = __persistent_red_black_tree_begin(&root, tree);
+  for (k = (size_t)0; k < d; k++)
+    path[k] = __persistent_red_black_tree_own(tree, stamp, __persistent_red_black_tree_link(&root, path, dirs, k));
+
+  z = __persistent_red_black_tree_malloc(sizeof(*z));
+  z->entry = __persistent_red_black_tree_malloc(sizeof(*z->entry));
+  z->entry->key = copy_key(key, data);
+  z->entry->value = copy_value(value, data);
+  atomic_init(&z->entry->references, (size_t)1);
+  z->left = NULL;
+  z->right = NULL;
+  z->color = PERSISTENT_RED_BLACK_TREE_COLOR_RED;
+  z->stamp = stamp;
+  atomic_init(&z->references, (size_t)1);
+  path[d] = z;
+  *__persistent_red_black_tree_link(&root, path, dirs, d) = z;
+
+  /* The usual fixup, going up the path instead of parent pointers.
+     Parent and grandparent are on the copied path; only an uncle
+     that gets recolored needs copying.
+  */
+  k = d;
+  while ((k >= ((size_t)2)) && (path[k - ((size_t)1)]->color == PERSISTENT_RED_BLACK_TREE_COLOR_RED))
+  {
+    parent = path[k - ((size_t)1)];
+    grand = path[k - ((size_t)2)];
+    side = dirs[k - ((size_t)2)];
+    uncle = side ? grand->left : grand->right;
+    if (!__persistent_red_black_tree_is_black(uncle))
+    {
+      // red uncle
+      uncle = __persistent_red_black_tree_own_child(tree, stamp, grand, !side);
+      parent->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+      uncle->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+      grand->color = PERSISTENT_RED_BLACK_TREE_COLOR_RED;
+      k -= (size_t)2;
+      continue;
+    }
+    if (dirs[k - ((size_t)1)] != side)
+    {
+      // black uncle, z is the inner grandchild
+      __persistent_red_black_tree_rotate(side ? &grand->right : &grand->left, parent, side);
+      path[k - ((size_t)1)] = path[k];
+    }
+    // black uncle, z is the outer grandchild
+    path[k - ((size_t)1)]->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+    grand->color = PERSISTENT_RED_BLACK_TREE_COLOR_RED;
+    __persistent_red_black_tree_rotate(__persistent_red_black_tree_link(&root, path, dirs, k - ((size_t)2)), grand, !side);
+    break;
+  }
+  root->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+
+  return __persistent_red_black_tree_version(tree, root, tree->number_entries + ((size_t)1));
+}
+
+/* Restores the red-black properties after a black node was unlinked
+   and x, the root of the subtree that took its place, was linked at
+   path[k]. Every node above x on the path is owned by the write;
+   siblings and their children are copied before being changed.
+*/
+static tree_node_t __persistent_red_black_tree_remove_fix(persistent_red_black_tree_t tree,
+                                                          uint64_t stamp,
+                                                          tree_node_t root,
+                                                          tree_node_t *path,
+                                                          int *dirs,
+                                                          size_t k,
+                                                          tree_node_t x)
+{
+  tree_node_t parent, w, near, far;
+  int side;
+
+  while ((k > ((size_t)0)) && __persistent_red_black_tree_is_black(x))
+  {
+    parent = path[k - ((size_t)1)];
+    side = dirs[k - ((size_t)1)];
+    w = __persistent_red_black_tree_own_child(tree, stamp, parent, !side);
+    if (w->color == PERSISTENT_RED_BLACK_TREE_COLOR_RED)
+    {
+      // red sibling, turn it into a black one
+      w->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+      parent->color = PERSISTENT_RED_BLACK_TREE_COLOR_RED;
+      __persistent_red_black_tree_rotate(__persistent_red_black_tree_link(&root, path, dirs, k - ((size_t)1)), parent, side);
+      path[k - ((size_t)1)] = w;
+      dirs[k - ((size_t)1)] = side;
+      path[k] = parent;
+      dirs[k] = side;
+      k++;
+      w = __persistent_red_black_tree_own_child(tree, stamp, parent, !side);
+    }
+    near = side ? w->right : w->left;
+    far = side ? w->left : w->right;
+    if (__persistent_red_black_tree_is_black(near) && __persistent_red_black_tree_is_black(far))
+    {
+      // black sibling with black children
+      w->color = PERSISTENT_RED_BLACK_TREE_COLOR_RED;
+      x = parent;
+      k--;
+      continue;
+    }
+    if (__persistent_red_black_tree_is_black(far))
+    {
+      // black sibling, red inner child
+      near = __persistent_red_black_tree_own_child(tree, stamp, w, side);
+      near->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+      w->color = PERSISTENT_RED_BLACK_TREE_COLOR_RED;
+      w = __persistent_red_black_tree_rotate(side ? &parent->left : &parent->right, w, !side);
+    }
+    // black sibling, red outer child
+    far = __persistent_red_black_tree_own_child(tree, stamp, w, !side);
+    w->color = parent->color;
+    parent->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+    far->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+    __persistent_red_black_tree_rotate(__persistent_red_black_tree_link(&root, path, dirs, k - ((size_t)1)), parent, side);
+    return root;
+  }
+
+  if (!__persistent_red_black_tree_is_black(x))
+  {
+    x = __persistent_red_black_tree_own(tree, stamp, __persistent_red_black_tree_link(&root, path, dirs, k));
+    x->color = PERSISTENT_RED_BLACK_TREE_COLOR_BLACK;
+  }
+  return root;
+}
+
+persistent_red_black_tree_t persistent_red_black_tree_remove(persistent_red_black_tree_t tree,
+                                                             void *key,
+                                                             int (*compare_key)(void *, void *, void *),
+                                                             void *data)
+{
+  tree_node_t path[PERSISTENT_RED_BLACK_TREE_MAX_HEIGHT + ((size_t)1)];
+  int dirs[PERSISTENT_RED_BLACK_TREE_MAX_HEIGHT + ((size_t)1)];
+  tree_node_t root, x, z, child;
+  tree_entry_t entry;
+  uint64_t stamp;
+  size_t d, k, z_depth;
+  int cmp;
+
+  d = (size_t)0;
+  for (z = tree->root; z != NULL; z = (cmp < 0) ? z->left : z->right)
+  {
+    cmp = compare_key(key, z->entry->key, data);
+    if (cmp == 0)
+      break;
+    dirs[d] = (cmp > 0);
+    d++;
+  }
+  if (z == NULL)
+    return persistent_red_black_tree_snapshot(tree);
+
+  /* A node with two children keeps its place and takes over the
+     entry of its successor, whose node gets unlinked instead.
+  */
+  z_depth = d;
+  x = z;
+  if ((z->left != NULL) && (z->right != NULL))
+  {
+    dirs[d] = 1;
+    d++;
+    for (x = z->right; x->left != NULL; x = x->left)
+    {
+      dirs[d] = 0;
+      d++;
+    }
+  }
+
+  stamp = __persistent_red_black_tree_begin(&root, tree);
+  for (k = (size_t)0; k < d; k++)
+    path[k] = __persistent_red_black_tree_own(tree, stamp, __persistent_red_black_tree_link(&root, path, dirs, k));
+
+  if (x != z)
+  {
+    entry = path[z_depth]->entry;
+    path[z_depth]->entry = x->entry;
+    atomic_fetch_add_explicit(&x->entry->references, (size_t)1, memory_order_relaxed);
+    __persistent_red_black_tree_release_entry(tree, entry);
+  }
+
+  // Unlink x, its only child, if any, takes its place.
+  child = (x->left != NULL) ? x->left : x->right;
+  __persistent_red_black_tree_retain(child);
+  *__persistent_red_black_tree_link(&root, path, dirs, d) = child;
+  path[d] = child;
+  if (x->color == PERSISTENT_RED_BLACK_TREE_COLOR_BLACK)
+    root = __persistent_red_black_tree_remove_fix(tree, stamp, root, path, dirs, d, child);
+  __persistent_red_black_tree_release(tree, x);
+
+  return __persistent_red_black_tree_version(tree, root, tree->number_entries - ((size_t)1));
+}
@@ -0,0 +1,160 @@
+#ifndef PERSISTENT_RED_BLACK_TREES_H
+#define PERSISTENT_RED_BLACK_TREES_H
+
+#include <stdlib.h>
+
+/* A persistent red-black tree: inserts and removals leave the
+   version they start from unchanged and return a new version.
+
+   The new version copies the nodes it would modify, i.e. the path
+   from the root down to the change plus the few nodes rebalancing
+   recolors or rotates, and shares all other nodes with the version
+   it was made from. Nodes and entries are reference counted and
+   freed with the last version using them.
+
+   No version is ever modified, so any number of threads may read,
+   and derive new versions from, the same versions without locking.
+   Only deleting a version requires that no other thread still uses
+   that very handle.
+
+*/
+typedef struct __persistent_red_black_tree_struct_t *persistent_red_black_tree_t;
+
+/* Creates an empty tree.
+
+   delete_key and delete_value are called on each key resp. value,
+   passing in the data pointer, once no version holds the entry
+   anymore. They are inherited by every version derived from the
+   tree and may be called by any thread releasing a version. Either
+   function may be NULL if the keys resp. values need no cleanup.
+
+*/
+persistent_red_black_tree_t persistent_red_black_tree_create(void (*delete_key)(void *, void *),
+                                                             void (*delete_value)(void *, void *),
+                                                             void *data);
+
+/* Returns a new handle on the same version of a tree in O(1), to be
+   deleted independently of tree.
+
+*/
+persistent_red_black_tree_t persistent_red_black_tree_snapshot(persistent_red_black_tree_t tree);
+
+/* Deletes a version of a tree, releasing the nodes and entries no
+   other version shares. Runs in time proportional to the number of
+   nodes released.
+
+*/
+void persistent_red_black_tree_delete(persistent_red_black_tree_t tree);
+
+/* Returns the number of entries in a version of a tree
+
+   Returns zero for an empty tree. Runs in constant time.
+
+*/
+size_t persistent_red_black_tree_number_entries(persistent_red_black_tree_t tree);
+
+/* Returns the height of a version of a tree
+
+   Returns zero for an empty tree.
+
+*/
+size_t persistent_red_black_tree_height(persistent_red_black_tree_t tree);
+
+/* Searches a version of a tree for a key, comparing keys with
+   compare_key, returning the associated value.
+
+   Returns NULL if the sought for key cannot be found. The value
+   stays valid as long as the version does.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void *persistent_red_black_tree_search(persistent_red_black_tree_t tree,
+                                       void *key,
+                                       int (*compare_key)(void *, void *, void *),
+                                       void *data);
+
+/* Returns the minimum key and associated value of a version.
+
+   Returns NULL for both the key and the value if the
+   tree is empty.
+
+*/
+void persistent_red_black_tree_minimum(void **min_key,
+                                       void **min_value,
+                                       persistent_red_black_tree_t tree);
+
+/* Returns the maximum key and associated value of a version.
+
+   Returns NULL for both the key and the value if the
+   tree is empty.
+
+*/
+void persistent_red_black_tree_maximum(void **max_key,
+                                       void **max_value,
+                                       persistent_red_black_tree_t tree);
+
+/* Visits the entries of a version with lo <= key < hi in key order,
+   calling visitor on each key and value with the data pointer.
+
+   A NULL lo resp. hi leaves the range unbounded on that side.
+   The scan stops early as soon as visitor returns a non-zero
+   value. If visitor is NULL, the entries are only counted.
+
+   Returns the number of entries visited, including the one on
+   which the scan was stopped.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t persistent_red_black_tree_range_foreach(persistent_red_black_tree_t tree,
+                                               void *lo,
+                                               void *hi,
+                                               int (*compare_key)(void *, void *, void *),
+                                               int (*visitor)(void *, void *, void *),
+                                               void *data);
+
+/* Returns a new version of a tree holding a key and an associated
+   value in addition to the entries of tree, comparing the keys with
+   compare_key and copying the key and value with the copy_key resp.
+   copy_value functions. tree itself is left unchanged.
+
+   If the key is already present, the new version equals tree, as
+   with persistent_red_black_tree_snapshot. Runs in O(log n) and
+   copies O(log n) nodes, but no other keys or values.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+persistent_red_black_tree_t persistent_red_black_tree_insert(persistent_red_black_tree_t tree,
+                                                             void *key,
+                                                             void *value,
+                                                             int (*compare_key)(void *, void *, void *),
+                                                             void *(*copy_key)(void *, void *),
+                                                             void *(*copy_value)(void *, void *),
+                                                             void *data);
+
+/* Returns a new version of a tree without a key, comparing the keys
+   with compare_key. tree itself is left unchanged, and the key and
+   value are deleted once no version holds them anymore.
+
+   If the key is absent, the new version equals tree, as with
+   persistent_red_black_tree_snapshot. Runs in O(log n).
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+persistent_red_black_tree_t persistent_red_black_tree_remove(persistent_red_black_tree_t tree,
+                                                             void *key,
+                                                             int (*compare_key)(void *, void *, void *),
+                                                             void *data);
+
+#endif
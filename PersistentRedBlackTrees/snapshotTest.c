@@ -0,0 +1,151 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "persistentredblacktrees.h"
+
+#define NUM_VALUES 200000
+#define NUM_WRITES 200000
+#define MAX_THREADS 8
+
+int compare_int(void *a, void *b, void *data)
+{
+    int *ia = (int *)a;
+    int *ib = (int *)b;
+    return (*ia > *ib) - (*ia < *ib);
+}
+
+static void *copy_int(void *ptr, void *data)
+{
+    int *new_int = (int *)malloc(sizeof(int));
+    if (new_int == NULL)
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+    *new_int = *(int *)ptr;
+    return new_int;
+}
+
+static void delete_int(void *ptr, void *data)
+{
+    free(ptr);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// The latest version; the lock only guards the pointer swap and the
+// O(1) snapshot, never a traversal.
+static persistent_red_black_tree_t latest;
+static pthread_mutex_t latest_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int writer_done;
+static atomic_long exports;
+static atomic_long inconsistent;
+
+static persistent_red_black_tree_t take_snapshot()
+{
+    pthread_mutex_lock(&latest_lock);
+    persistent_red_black_tree_t snapshot = persistent_red_black_tree_snapshot(latest);
+    pthread_mutex_unlock(&latest_lock);
+    return snapshot;
+}
+
+// An exporter scans whole snapshots while the writer goes on; each
+// scan must see exactly the entries of its version.
+static void *exporter(void *arg)
+{
+    while (!writer_done)
+    {
+        persistent_red_black_tree_t snapshot = take_snapshot();
+        size_t count = persistent_red_black_tree_range_foreach(snapshot, NULL, NULL, compare_int, NULL, NULL);
+        if (count != persistent_red_black_tree_number_entries(snapshot))
+            inconsistent++;
+        exports++;
+        persistent_red_black_tree_delete(snapshot);
+    }
+    return NULL;
+}
+
+// The writer inserts and removes odd keys, replacing the latest
+// version after each write.
+static void *writer(void *arg)
+{
+    unsigned int seed = 7;
+
+    for (int i = 0; i < NUM_WRITES; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 1) % NUM_VALUES) * 2 + 1;
+        persistent_red_black_tree_t current = take_snapshot();
+        persistent_red_black_tree_t next = (i & 1) ?
+            persistent_red_black_tree_remove(current, &key, compare_int, NULL) :
+            persistent_red_black_tree_insert(current, &key, &key, compare_int, copy_int, copy_int, NULL);
+        persistent_red_black_tree_delete(current);
+
+        pthread_mutex_lock(&latest_lock);
+        current = latest;
+        latest = next;
+        pthread_mutex_unlock(&latest_lock);
+        persistent_red_black_tree_delete(current);
+    }
+    writer_done = 1;
+    return NULL;
+}
+
+int main()
+{
+    latest = persistent_red_black_tree_create(delete_int, delete_int, NULL);
+
+    // Even keys only, the writer adds and removes odd ones.
+    for (int i = 0; i < NUM_VALUES; i++)
+    {
+        int key = 2 * i;
+        persistent_red_black_tree_t next = persistent_red_black_tree_insert(latest, &key, &key, compare_int,
+                                                                            copy_int, copy_int, NULL);
+        persistent_red_black_tree_delete(latest);
+        latest = next;
+    }
+
+    double start = now();
+    for (int i = 0; i < NUM_WRITES; i++)
+        persistent_red_black_tree_delete(take_snapshot());
+    printf("%d keys, snapshot %.1f ns.\n", NUM_VALUES, (now() - start) / NUM_WRITES * 1e9);
+
+    FILE *outputFile = fopen("Persistent_snapshot_data.csv", "w");
+
+    fprintf(outputFile, "Exporters,Writes per s,Exports,Inconsistent Exports\n");
+
+    for (int num_exporters = 0; num_exporters <= MAX_THREADS; num_exporters = num_exporters ? 2 * num_exporters : 1)
+    {
+        pthread_t exporters[MAX_THREADS];
+        pthread_t writer_thread;
+
+        writer_done = 0;
+        exports = 0;
+        inconsistent = 0;
+        start = now();
+        pthread_create(&writer_thread, NULL, writer, NULL);
+        for (int i = 0; i < num_exporters; i++)
+            pthread_create(&exporters[i], NULL, exporter, NULL);
+        pthread_join(writer_thread, NULL);
+        double elapsed = now() - start;
+        for (int i = 0; i < num_exporters; i++)
+            pthread_join(exporters[i], NULL);
+
+        printf("%d exporters: %.2f M writes/s, %ld exports, %ld inconsistent\n",
+               num_exporters, NUM_WRITES / elapsed / 1e6, (long)exports, (long)inconsistent);
+        fprintf(outputFile, "%d,%.0f,%ld,%ld\n", num_exporters, NUM_WRITES / elapsed, (long)exports, (long)inconsistent);
+    }
+
+    fclose(outputFile);
+    persistent_red_black_tree_delete(latest);
+
+    return 0;
+}
@@ -0,0 +1,790 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+typedef enum
+{
+  RCU_RED_BLACK_TREE_COLOR_RED = 0,
+  RCU_RED_BLACK_TREE_COLOR_BLACK = 1
+} color_t;
+
+/* Nodes have no parent pointer, since a copied node would have to
+   update the parent pointers of both its children. A node is never
+   modified once a version of the tree holding it got published.
+
+   stamp is the number of the write that created the node, which
+   tells the writer whether it may modify the node in place. Once
+   the node is retired, stamp holds the epoch it was retired in and
+   retired_next links it into the queue of nodes waiting for readers.
+*/
+typedef struct __tree_node_struct_t *tree_node_t;
+struct __tree_node_struct_t
+{
+  void *key;
+  void *value;
+  tree_node_t left;
+  tree_node_t right;
+  color_t color;
+  uint64_t stamp;
+  tree_node_t retired_next;
+};
+
+/* An entry removed from the tree, whose key and value are deleted
+   once no reader can have found it anymore.
+*/
+typedef struct __retired_entry_struct_t *retired_entry_t;
+struct __retired_entry_struct_t
+{
+  retired_entry_t next;
+  void *key;
+  void *value;
+  void (*delete_key)(void *, void *);
+  void (*delete_value)(void *, void *);
+  void *data;
+  uint64_t epoch;
+};
+
+/* A red-black tree holding n entries is at most 2 log2(n + 1) high. */
+#define RCU_RED_BLACK_TREE_MAX_HEIGHT ((size_t)128)
+
+#define RCU_RED_BLACK_TREE_CACHE_LINE ((size_t)64)
+
+/* The epoch of a reader is zero while it is outside of read-side
+   sections. The padding keeps the epochs of two readers apart by at
+   least one cache line, so that readers never write to a line
+   another reader uses.
+*/
+struct __rcu_red_black_tree_reader_struct_t
+{
+  _Atomic uint64_t epoch;
+  struct __rcu_red_black_tree_struct_t *tree;
+  struct __rcu_red_black_tree_reader_struct_t *next;
+  unsigned char padding[RCU_RED_BLACK_TREE_CACHE_LINE];
+};
+
+struct __rcu_red_black_tree_struct_t
+{
+  _Atomic(tree_node_t) root;
+  _Atomic size_t number_entries;
+  _Atomic uint64_t epoch;
+  uint64_t version;
+  pthread_mutex_t write_lock;
+  pthread_mutex_t readers_lock;
+  struct __rcu_red_black_tree_reader_struct_t *readers;
+  tree_node_t pending_nodes;
+  retired_entry_t pending_entries;
+  tree_node_t retired_nodes_head;
+  tree_node_t retired_nodes_tail;
+  retired_entry_t retired_entries_head;
+  retired_entry_t retired_entries_tail;
+};
+
+#include "rcuredblacktrees.h"
+
+static void *__rcu_red_black_tree_malloc(size_t size)
+{
+  void *ptr;
+
+  ptr = malloc(size);
+  if (ptr == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  return ptr;
+}
+
+rcu_red_black_tree_t rcu_red_black_tree_create()
+{
+  rcu_red_black_tree_t tree;
+
+  tree = __rcu_red_black_tree_malloc(sizeof(*tree));
+  atomic_init(&tree->root, NULL);
+  atomic_init(&tree->number_entries, (size_t)0);
+  atomic_init(&tree->epoch, (uint64_t)1);
+  tree->version = (uint64_t)0;
+  pthread_mutex_init(&tree->write_lock, NULL);
+  pthread_mutex_init(&tree->readers_lock, NULL);
+  tree->readers = NULL;
+  tree->pending_nodes = NULL;
+  tree->pending_entries = NULL;
+  tree->retired_nodes_head = NULL;
+  tree->retired_nodes_tail = NULL;
+  tree->retired_entries_head = NULL;
+  tree->retired_entries_tail = NULL;
+  return tree;
+}
+
+static void __rcu_red_black_tree_delete_aux(tree_node_t node,
+                                            void (*delete_key)(void *, void *),
+                                            void (*delete_value)(void *, void *),
+                                            void *data)
+{
+  if (node == NULL)
+    return;
+  __rcu_red_black_tree_delete_aux(node->left, delete_key, delete_value, data);
+  __rcu_red_black_tree_delete_aux(node->right, delete_key, delete_value, data);
+  if (delete_key != NULL)
+    delete_key(node->key, data);
+  if (delete_value != NULL)
+    delete_value(node->value, data);
+  free(node);
+}
+
+static void __rcu_red_black_tree_release_entry(retired_entry_t entry)
+{
+  if (entry->delete_key != NULL)
+    entry->delete_key(entry->key, entry->data);
+  if (entry->delete_value != NULL)
+    entry->delete_value(entry->value, entry->data);
+  free(entry);
+}
+
+void rcu_red_black_tree_delete(rcu_red_black_tree_t tree,
+                               void (*delete_key)(void *, void *),
+                               void (*delete_value)(void *, void *),
+                               void *data)
+{
+  struct __rcu_red_black_tree_reader_struct_t *reader, *next_reader;
+  tree_node_t node, next_node;
+  retired_entry_t entry, next_entry;
+
+  __rcu_red_black_tree_delete_aux(atomic_load(&tree->root), delete_key, delete_value, data);
+  for (node = tree->retired_nodes_head; node != NULL; node = next_node)
+  {
+    next_node = node->retired_next;
+    free(node);
+  }
+  for (entry = tree->retired_entries_head; entry != NULL; entry = next_entry)
+  {
+    next_entry = entry->next;
+    __rcu_red_black_tree_release_entry(entry);
+  }
+  for (reader = tree->readers; reader != NULL; reader = next_reader)
+  {
+    next_reader = reader->next;
+    free(reader);
+  }
+  pthread_mutex_destroy(&tree->write_lock);
+  pthread_mutex_destroy(&tree->readers_lock);
+  free(tree);
+}
+
+rcu_red_black_tree_reader_t rcu_red_black_tree_reader_register(rcu_red_black_tree_t tree)
+{
+  rcu_red_black_tree_reader_t reader;
+
+  reader = __rcu_red_black_tree_malloc(sizeof(*reader));
+  atomic_init(&reader->epoch, (uint64_t)0);
+  reader->tree = tree;
+  pthread_mutex_lock(&tree->readers_lock);
+  reader->next = tree->readers;
+  tree->readers = reader;
+  pthread_mutex_unlock(&tree->readers_lock);
+  return reader;
+}
+
+void rcu_red_black_tree_reader_unregister(rcu_red_black_tree_reader_t reader)
+{
+  rcu_red_black_tree_t tree;
+  rcu_red_black_tree_reader_t *link;
+
+  tree = reader->tree;
+  pthread_mutex_lock(&tree->readers_lock);
+  for (link = &tree->readers; *link != reader; link = &(*link)->next)
+    ;
+  *link = reader->next;
+  pthread_mutex_unlock(&tree->readers_lock);
+  free(reader);
+}
+
+/* The announcement has to be visible before the reader loads the
+   root, and the root has to be published before the writer reads
+   the epochs of the readers, hence sequentially consistent
+   accesses on both sides. A reader that announces an epoch after
+   the writer found it quiescent thus loads a root that no longer
+   leads to any of the nodes freed.
+*/
+void rcu_red_black_tree_read_lock(rcu_red_black_tree_reader_t reader)
+{
+  atomic_store(&reader->epoch, atomic_load(&reader->tree->epoch));
+}
+
+void rcu_red_black_tree_read_unlock(rcu_red_black_tree_reader_t reader)
+{
+  atomic_store_explicit(&reader->epoch, (uint64_t)0, memory_order_release);
+}
+
+size_t rcu_red_black_tree_number_entries(rcu_red_black_tree_t tree)
+{
+  return atomic_load_explicit(&tree->number_entries, memory_order_relaxed);
+}
+
+static tree_node_t __rcu_red_black_tree_root(rcu_red_black_tree_reader_t reader)
+{
+  return atomic_load(&reader->tree->root);
+}
+
+void *rcu_red_black_tree_search(rcu_red_black_tree_reader_t reader,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data)
+{
+  tree_node_t node;
+  int cmp;
+
+  node = __rcu_red_black_tree_root(reader);
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if (cmp == 0)
+      return node->value;
+    if (cmp < 0)
+    {
+      node = node->left;
+    }
+    else
+    {
+      node = node->right;
+    }
+  }
+  return NULL;
+}
+
+void rcu_red_black_tree_minimum(void **min_key,
+                                void **min_value,
+                                rcu_red_black_tree_reader_t reader)
+{
+  tree_node_t node;
+
+  node = __rcu_red_black_tree_root(reader);
+  if (node == NULL)
+  {
+    *min_key = NULL;
+    *min_value = NULL;
+    return;
+  }
+  while (node->left != NULL)
+    node = node->left;
+  *min_key = node->key;
+  *min_value = node->value;
+}
+
+void rcu_red_black_tree_maximum(void **max_key,
+                                void **max_value,
+                                rcu_red_black_tree_reader_t reader)
+{
+  tree_node_t node;
+
+  node = __rcu_red_black_tree_root(reader);
+  if (node == NULL)
+  {
+    *max_key = NULL;
+    *max_value = NULL;
+    return;
+  }
+  while (node->right != NULL)
+    node = node->right;
+  *max_key = node->key;
+  *max_value = node->value;
+}
+
+size_t rcu_red_black_tree_range_foreach(rcu_red_black_tree_reader_t reader,
+                                        void *lo,
+                                        void *hi,
+                                        int (*compare_key)(void *, void *, void *),
+                                        int (*visitor)(void *, void *, void *),
+                                        void *data)
+{
+  tree_node_t stack[RCU_RED_BLACK_TREE_MAX_HEIGHT];
+  tree_node_t node;
+  size_t depth, count;
+
+  /* Without parent pointers, the in-order walk keeps the nodes
+     whose left subtree is being visited on a stack, which the
+     height bound keeps small.
+  */
+  depth = (size_t)0;
+  node = __rcu_red_black_tree_root(reader);
+  while (node != NULL)
+  {
+    if ((lo == NULL) || (compare_key(node->key, lo, data) >= 0))
+    {
+      stack[depth++] = node;
+      node = node->left;
+    }
+    else
+    {
+      node = node->right;
+    }
+  }
+
+  count = (size_t)0;
+  while (depth > ((size_t)0))
+  {
+    node = stack[--depth];
+    if ((hi != NULL) && (compare_key(node->key, hi, data) >= 0))
+      break;
+    count++;
+    if ((visitor != NULL) && visitor(node->key, node->value, data))
+      break;
+    for (node = node->right; node != NULL; node = node->left)
+      stack[depth++] = node;
+  }
+  return count;
+}
+
+static size_t __rcu_red_black_tree_height_aux(tree_node_t node)
+{
+  size_t l, r;
+
+  if (node == NULL)
+    return ((size_t)0);
+  l = __rcu_red_black_tree_height_aux(node->left);
+  r = __rcu_red_black_tree_height_aux(node->right);
+  return ((l > r) ? l : r) + ((size_t)1);
+}
+
+size_t rcu_red_black_tree_height(rcu_red_black_tree_reader_t reader)
+{
+  return __rcu_red_black_tree_height_aux(__rcu_red_black_tree_root(reader));
+}
+
+/* Returns a node the current write may modify in place: node itself
+   if the write created it, a copy otherwise. The original is
+   retired, since the version being built no longer uses it.
+*/
+static tree_node_t __rcu_red_black_tree_own(rcu_red_black_tree_t tree,
+                                            tree_node_t node)
+{
+  tree_node_t copy;
+
+  if ((node == NULL) || (node->stamp == tree->version))
+    return node;
+
+  copy = __rcu_red_black_tree_malloc(sizeof(*copy));
+  copy->key = node->key;
+  copy->value = node->value;
+  copy->left = node->left;
+  copy->right = node->right;
+  copy->color = node->color;
+  copy->stamp = tree->version;
+  copy->retired_next = NULL;
+
+  node->retired_next = tree->pending_nodes;
+  tree->pending_nodes = node;
+  return copy;
+}
+
+static tree_node_t __rcu_red_black_tree_own_child(rcu_red_black_tree_t tree,
+                                                  tree_node_t node,
+                                                  int dir)
+{
+  if (dir)
+    return (node->right = __rcu_red_black_tree_own(tree, node->right));
+  return (node->left = __rcu_red_black_tree_own(tree, node->left));
+}
+
+static int __rcu_red_black_tree_is_black(tree_node_t node)
+{
+  return (node == NULL) || (node->color == RCU_RED_BLACK_TREE_COLOR_BLACK);
+}
+
+/* Returns the link pointing to path[k], which is the root for k = 0
+   and a child pointer of path[k - 1] otherwise.
+*/
+static tree_node_t *__rcu_red_black_tree_link(tree_node_t *root,
+                                              tree_node_t *path,
+                                              int *dirs,
+                                              size_t k)
+{
+  if (k == ((size_t)0))
+    return root;
+  return dirs[k - ((size_t)1)] ? &path[k - ((size_t)1)]->right : &path[k - ((size_t)1)]->left;
+}
+
+/* Rotates left (dir = 0) or right (dir = 1) at x, whose link is
+   stored in *link. Both x and the child moving up must be owned by
+   the current write.
+*/
+static tree_node_t __rcu_red_black_tree_rotate(tree_node_t *link,
+                                               tree_node_t x,
+                                               int dir)
+{
+  tree_node_t y;
+
+  if (dir == 0)
+  {
+    y = x->right;
+    x->right = y->left;
+    y->left = x;
+  }
+  else
+  {
+    y = x->left;
+    x->left = y->right;
+    y->right = x;
+  }
+  *link = y;
+  return y;
+}
+
+/* Frees the retired nodes and entries no reader can reach anymore,
+   i.e. those retired in an epoch before the oldest epoch announced
+   by a reader. The queues are ordered by epoch. The writer lock
+   must be held.
+*/
+static void __rcu_red_black_tree_reclaim(rcu_red_black_tree_t tree)
+{
+  rcu_red_black_tree_reader_t reader;
+  tree_node_t node;
+  retired_entry_t entry;
+  uint64_t oldest, epoch;
+
+  if ((tree->retired_nodes_head == NULL) && (tree->retired_entries_head == NULL))
+    return;
+
+  oldest = UINT64_MAX;
+  pthread_mutex_lock(&tree->readers_lock);
+  for (reader = tree->readers; reader != NULL; reader = reader->next)
+  {
+    epoch = atomic_load(&reader->epoch);
+    if ((epoch != ((uint64_t)0)) && (epoch < oldest))
+      oldest = epoch;
+  }
+  pthread_mutex_unlock(&tree->readers_lock);
+
+  while ((tree->retired_nodes_head != NULL) && (tree->retired_nodes_head->stamp < oldest))
+  {
+    node = tree->retired_nodes_head;
+    tree->retired_nodes_head = node->retired_next;
+    free(node);
+  }
+  if (tree->retired_nodes_head == NULL)
+    tree->retired_nodes_tail = NULL;
+
+  while ((tree->retired_entries_head != NULL) && (tree->retired_entries_head->epoch < oldest))
+  {
+    entry = tree->retired_entries_head;
+    tree->retired_entries_head = entry->next;
+    __rcu_red_black_tree_release_entry(entry);
+  }
+  if (tree->retired_entries_head == NULL)
+    tree->retired_entries_tail = NULL;
+}
+
+/* Publishes root as the new version of the tree and hands the nodes
+   and entries the write retired over to reclamation. The writer
+   lock must be held.
+*/
+static void __rcu_red_black_tree_publish(rcu_red_black_tree_t tree,
+                                         tree_node_t root)
+{
+  tree_node_t node, next_node;
+  retired_entry_t entry, next_entry;
+  uint64_t epoch;
+
+  atomic_store(&tree->root, root);
+
+  /* Readers that announce a later epoch see the new root. */
+  epoch = atomic_load(&tree->epoch);
+  for (node = tree->pending_nodes; node != NULL; node = next_node)
+  {
+    next_node = node->retired_next;
+    node->stamp = epoch;
+    node->retired_next = NULL;
+    if (tree->retired_nodes_tail == NULL)
+    {
+      tree->retired_nodes_head = node;
+    }
+    else
+    {
+      tree->retired_nodes_tail->retired_next = node;
+    }
+    tree->retired_nodes_tail = node;
+  }
+  tree->pending_nodes = NULL;
+  for (entry = tree->pending_entries; entry != NULL; entry = next_entry)
+  {
+    next_entry = entry->next;
+    entry->epoch = epoch;
+    entry->next = NULL;
+    if (tree->retired_entries_tail == NULL)
+    {
+      tree->retired_entries_head = entry;
+    }
+    else
+    {
+      tree->retired_entries_tail->next = entry;
+    }
+    tree->retired_entries_tail = entry;
+  }
+  tree->pending_entries = NULL;
+  atomic_fetch_add(&tree->epoch, (uint64_t)1);
+
+  __rcu_red_black_tree_reclaim(tree);
+}
+
+void rcu_red_black_tree_insert(rcu_red_black_tree_t tree,
+                               void *key,
+                               void *value,
+                               int (*compare_key)(void *, void *, void *),
+                               void *(*copy_key)(void *, void *),
+                               void *(*copy_value)(void *, void *),
+                               void *data)
+{
+  tree_node_t path[RCU_RED_BLACK_TREE_MAX_HEIGHT + ((size_t)1)];
+  int dirs[RCU_RED_BLACK_TREE_MAX_HEIGHT + ((size_t)1)];
+  tree_node_t root, x, z, parent, grand, uncle;
+  size_t d, k;
+  int cmp, side;
+
+  pthread_mutex_lock(&tree->write_lock);
+
+  root = atomic_load_explicit(&tree->root, memory_order_relaxed);
+  d = (size_t)0;
+  for (x = root; x != NULL; x = (cmp < 0) ? x->left : x->right)
+  {
+    cmp = compare_key(key, x->key, data);
+    if (cmp == 0)
+    {
+      pthread_mutex_unlock(&tree->write_lock);
+      return;
+    }
+    path[d] = x;
+    dirs[d] = (cmp > 0);
+    d++;
+  }
+
+  // Copy the whole path, the new node changes its last link.
+  tree->version++;
+  for (k = (size_t)0; k < d; k++)
+  {
+    path[k] = __rcu_red_black_tree_own(tree, path[k]);
+    *__rcu_red_black_tree_link(&root, path, dirs, k) = path[k];
+  }
+
+  z = __rcu_red_black_tree_malloc(sizeof(*z));
+  z->key = copy_key(key, data);
+  z->value = copy_value(value, data);
+  z->left = NULL;
+  z->right = NULL;
+  z->color = RCU_RED_BLACK_TREE_COLOR_RED;
+  z->stamp = tree->version;
+  z->retired_next = NULL;
+  path[d] = z;
+  *__rcu_red_black_tree_link(&root, path, dirs, d) = z;
+
+  /* The usual fixup, going up the path instead of parent pointers.
+     Parent and grandparent are on the copied path; only an uncle
+     that gets recolored needs copying.
+  */
+  k = d;
+  while ((k >= ((size_t)2)) && (path[k - ((size_t)1)]->color == RCU_RED_BLACK_TREE_COLOR_RED))
+  {
+    parent = path[k - ((size_t)1)];
+    grand = path[k - ((size_t)2)];
+    side = dirs[k - ((size_t)2)];
+    uncle = side ? grand->left : grand->right;
+    if (!__rcu_red_black_tree_is_black(uncle))
+    {
+      // red uncle
+      uncle = __rcu_red_black_tree_own_child(tree, grand, !side);
+      parent->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+      uncle->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+      grand->color = RCU_RED_BLACK_TREE_COLOR_RED;
+      k -= (size_t)2;
+      continue;
+    }
+    if (dirs[k - ((size_t)1)] != side)
+    {
+      // black uncle, z is the inner grandchild
+      __rcu_red_black_tree_rotate(side ? &grand->right : &grand->left, parent, side);
+      path[k - ((size_t)1)] = path[k];
+    }
+    // black uncle, z is the outer grandchild
+    path[k - ((size_t)1)]->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+    grand->color = RCU_RED_BLACK_TREE_COLOR_RED;
+    __rcu_red_black_tree_rotate(__rcu_red_black_tree_link(&root, path, dirs, k - ((size_t)2)), grand, !side);
+    break;
+  }
+  root->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+
+  __rcu_red_black_tree_publish(tree, root);
+  atomic_fetch_add_explicit(&tree->number_entries, (size_t)1, memory_order_relaxed);
+  pthread_mutex_unlock(&tree->write_lock);
+}
+
+/* Restores the red-black properties after a black node was unlinked
+   and x, the root of the subtree that took its place, was linked at
+   path[k]. Every node above x on the path is owned by the write;
+   siblings and their children are copied before being changed.
+*/
+static tree_node_t __rcu_red_black_tree_remove_fix(rcu_red_black_tree_t tree,
+                                                   tree_node_t root,
+                                                   tree_node_t *path,
+                                                   int *dirs,
+                                                   size_t k,
+                                                   tree_node_t x)
+{
+  tree_node_t parent, w, near, far;
+  int side;
+
+  while ((k > ((size_t)0)) && __rcu_red_black_tree_is_black(x))
+  {
+    parent = path[k - ((size_t)1)];
+    side = dirs[k - ((size_t)1)];
+    w = __rcu_red_black_tree_own_child(tree, parent, !side);
+    if (w->color == RCU_RED_BLACK_TREE_COLOR_RED)
+    {
+      // red sibling, turn it into a black one
+      w->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+      parent->color = RCU_RED_BLACK_TREE_COLOR_RED;
+      __rcu_red_black_tree_rotate(__rcu_red_black_tree_link(&root, path, dirs, k - ((size_t)1)), parent, side);
+      path[k - ((size_t)1)] = w;
+      dirs[k - ((size_t)1)] = side;
+      path[k] = parent;
+      dirs[k] = side;
+      k++;
+      w = __rcu_red_black_tree_own_child(tree, parent, !side);
+    }
+    near = side ? w->right : w->left;
+    far = side ? w->left : w->right;
+    if (__rcu_red_black_tree_is_black(near) && __rcu_red_black_tree_is_black(far))
+    {
+      // black sibling with black children
+      w->color = RCU_RED_BLACK_TREE_COLOR_RED;
+      x = parent;
+      k--;
+      continue;
+    }
+    if (__rcu_red_black_tree_is_black(far))
+    {
+      // black sibling, red inner child
+      near = __rcu_red_black_tree_own_child(tree, w, side);
+      near->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+      w->color = RCU_RED_BLACK_TREE_COLOR_RED;
+      w = __rcu_red_black_tree_rotate(side ? &parent->left : &parent->right, w, !side);
+    }
+    // black sibling, red outer child
+    far = __rcu_red_black_tree_own_child(tree, w, !side);
+    w->color = parent->color;
+    parent->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+    far->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+    __rcu_red_black_tree_rotate(__rcu_red_black_tree_link(&root, path, dirs, k - ((size_t)1)), parent, side);
+    return root;
+  }
+
+  if (!__rcu_red_black_tree_is_black(x))
+  {
+    x = __rcu_red_black_tree_own(tree, x);
+    *__rcu_red_black_tree_link(&root, path, dirs, k) = x;
+    x->color = RCU_RED_BLACK_TREE_COLOR_BLACK;
+  }
+  return root;
+}
+
+void rcu_red_black_tree_remove(rcu_red_black_tree_t tree,
+                               void *key,
+                               int (*compare_key)(void *, void *, void *),
+                               void (*delete_key)(void *, void *),
+                               void (*delete_value)(void *, void *),
+                               void *data)
+{
+  tree_node_t path[RCU_RED_BLACK_TREE_MAX_HEIGHT + ((size_t)1)];
+  int dirs[RCU_RED_BLACK_TREE_MAX_HEIGHT + ((size_t)1)];
+  tree_node_t root, x, z, child;
+  retired_entry_t entry;
+  size_t d, k, z_depth;
+  int cmp;
+
+  pthread_mutex_lock(&tree->write_lock);
+
+  root = atomic_load_explicit(&tree->root, memory_order_relaxed);
+  d = (size_t)0;
+  for (z = root; z != NULL; z = (cmp < 0) ? z->left : z->right)
+  {
+    cmp = compare_key(key, z->key, data);
+    if (cmp == 0)
+      break;
+    path[d] = z;
+    dirs[d] = (cmp > 0);
+    d++;
+  }
+  if (z == NULL)
+  {
+    pthread_mutex_unlock(&tree->write_lock);
+    return;
+  }
+
+  /* A node with two children keeps its place and takes over the
+     entry of its successor, whose node gets unlinked instead.
+  */
+  z_depth = d;
+  x = z;
+  if ((z->left != NULL) && (z->right != NULL))
+  {
+    path[d] = z;
+    dirs[d] = 1;
+    d++;
+    for (x = z->right; x->left != NULL; x = x->left)
+    {
+      path[d] = x;
+      dirs[d] = 0;
+      d++;
+    }
+  }
+
+  tree->version++;
+  for (k = (size_t)0; k < d; k++)
+  {
+    path[k] = __rcu_red_black_tree_own(tree, path[k]);
+    *__rcu_red_black_tree_link(&root, path, dirs, k) = path[k];
+  }
+
+  if ((delete_key != NULL) || (delete_value != NULL))
+  {
+    entry = __rcu_red_black_tree_malloc(sizeof(*entry));
+    entry->key = z->key;
+    entry->value = z->value;
+    entry->delete_key = delete_key;
+    entry->delete_value = delete_value;
+    entry->data = data;
+    entry->next = tree->pending_entries;
+    tree->pending_entries = entry;
+  }
+  if (x != z)
+  {
+    path[z_depth]->key = x->key;
+    path[z_depth]->value = x->value;
+  }
+
+  // Unlink x, its only child, if any, takes its place.
+  child = (x->left != NULL) ? x->left : x->right;
+  *__rcu_red_black_tree_link(&root, path, dirs, d) = child;
+  x->retired_next = tree->pending_nodes;
+  tree->pending_nodes = x;
+  path[d] = child;
+  if (x->color == RCU_RED_BLACK_TREE_COLOR_BLACK)
+    root = __rcu_red_black_tree_remove_fix(tree, root, path, dirs, d, child);
+
+  __rcu_red_black_tree_publish(tree, root);
+  atomic_fetch_sub_explicit(&tree->number_entries, (size_t)1, memory_order_relaxed);
+  pthread_mutex_unlock(&tree->write_lock);
+}
+
+void rcu_red_black_tree_synchronize(rcu_red_black_tree_t tree)
+{
+  pthread_mutex_lock(&tree->write_lock);
+  for (;;)
+  {
+    __rcu_red_black_tree_reclaim(tree);
+    if ((tree->retired_nodes_head == NULL) && (tree->retired_entries_head == NULL))
+      break;
+    sched_yield();
+  }
+  pthread_mutex_unlock(&tree->write_lock);
+}
@@ -0,0 +1,195 @@
+#ifndef RCU_RED_BLACK_TREES_H
+#define RCU_RED_BLACK_TREES_H
+
+#include <stdlib.h>
+
+/* A red-black tree that many threads can read while one thread at
+   a time writes to it.
+
+   Readers never take a lock and never write to shared memory other
+   than their own reader handle. Writers copy the nodes they would
+   modify, i.e. the path from the root down to the change plus the
+   few nodes rebalancing recolors or rotates, and publish the new
+   version by atomically replacing the root. Nodes that the new
+   version no longer uses are freed once no reader can still be
+   looking at them, which is tracked with epochs: a reader announces
+   the current epoch when it enters a read-side section, and each
+   write moves the epoch forward.
+
+   Writers are serialized by a mutex inside the tree.
+
+*/
+typedef struct __rcu_red_black_tree_struct_t *rcu_red_black_tree_t;
+
+/* Per-thread handle of a reader, see rcu_red_black_tree_reader_register. */
+typedef struct __rcu_red_black_tree_reader_struct_t *rcu_red_black_tree_reader_t;
+
+/* Creates an empty tree */
+rcu_red_black_tree_t rcu_red_black_tree_create();
+
+/* Deletes a tree, calling delete_key and delete_value on each key
+   resp. value, passing in the data pointer. Also releases every
+   node and entry still waiting for readers.
+
+   No thread may use the tree or any of its reader handles
+   concurrently or afterwards. Either function may be NULL if the
+   keys resp. values need no cleanup.
+*/
+void rcu_red_black_tree_delete(rcu_red_black_tree_t tree,
+                               void (*delete_key)(void *, void *),
+                               void (*delete_value)(void *, void *),
+                               void *data);
+
+/* Registers the calling thread as a reader of a tree and returns its
+   handle. Each reading thread needs a handle of its own; the handle
+   is used by one thread at a time only.
+
+*/
+rcu_red_black_tree_reader_t rcu_red_black_tree_reader_register(rcu_red_black_tree_t tree);
+
+/* Unregisters and frees a reader handle. The reader must not be
+   inside a read-side section.
+*/
+void rcu_red_black_tree_reader_unregister(rcu_red_black_tree_reader_t reader);
+
+/* Enters a read-side section. Until the matching
+   rcu_red_black_tree_read_unlock, the version of the tree seen by
+   the reader, and every key and value found in it, stays valid even
+   if writers remove the entries meanwhile.
+
+   Read-side sections do not nest. Keep them short: nodes and
+   entries replaced while a section is open are only freed after it
+   ends.
+
+*/
+void rcu_red_black_tree_read_lock(rcu_red_black_tree_reader_t reader);
+
+/* Leaves a read-side section */
+void rcu_red_black_tree_read_unlock(rcu_red_black_tree_reader_t reader);
+
+/* Returns the number of entries in a tree
+
+   Returns zero for an empty tree. Runs in constant time.
+
+*/
+size_t rcu_red_black_tree_number_entries(rcu_red_black_tree_t tree);
+
+/* Searches a tree for a key, comparing keys with compare_key,
+   returning the associated value.
+
+   Returns NULL if the sought for key cannot be found.
+
+   Must be called inside a read-side section of reader; the value
+   returned stays valid until that section ends.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void *rcu_red_black_tree_search(rcu_red_black_tree_reader_t reader,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data);
+
+/* Returns the minimum key and associated value.
+
+   Returns NULL for both the key and the value if the
+   tree is empty. Must be called inside a read-side section.
+
+*/
+void rcu_red_black_tree_minimum(void **min_key,
+                                void **min_value,
+                                rcu_red_black_tree_reader_t reader);
+
+/* Returns the maximum key and associated value.
+
+   Returns NULL for both the key and the value if the
+   tree is empty. Must be called inside a read-side section.
+
+*/
+void rcu_red_black_tree_maximum(void **max_key,
+                                void **max_value,
+                                rcu_red_black_tree_reader_t reader);
+
+/* Visits the entries with lo <= key < hi in key order, calling
+   visitor on each key and value with the data pointer. All entries
+   visited belong to the same version of the tree.
+
+   A NULL lo resp. hi leaves the range unbounded on that side.
+   The scan stops early as soon as visitor returns a non-zero
+   value. If visitor is NULL, the entries are only counted.
+
+   Returns the number of entries visited, including the one on
+   which the scan was stopped. Must be called inside a read-side
+   section.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t rcu_red_black_tree_range_foreach(rcu_red_black_tree_reader_t reader,
+                                        void *lo,
+                                        void *hi,
+                                        int (*compare_key)(void *, void *, void *),
+                                        int (*visitor)(void *, void *, void *),
+                                        void *data);
+
+/* Returns the height of a tree
+
+   Returns zero for an empty tree. Must be called inside a
+   read-side section.
+
+*/
+size_t rcu_red_black_tree_height(rcu_red_black_tree_reader_t reader);
+
+/* Inserts a key and an associated value into a tree, comparing the
+   keys with compare_key and copying the key and value with the
+   copy_key resp. copy_value functions.
+
+   The tree is left unchanged if the key is already present.
+   Otherwise the new version is visible to read-side sections
+   entered after the call returns.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void rcu_red_black_tree_insert(rcu_red_black_tree_t tree,
+                               void *key,
+                               void *value,
+                               int (*compare_key)(void *, void *, void *),
+                               void *(*copy_key)(void *, void *),
+                               void *(*copy_value)(void *, void *),
+                               void *data);
+
+/* Removes a key and the associated value in a tree, comparing the
+   keys with compare_key.
+
+   The key and value are deleted with the delete_key resp.
+   delete_value function once no read-side section that might have
+   found them is still open, which may be during a later call on the
+   tree. Either function may be NULL.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void rcu_red_black_tree_remove(rcu_red_black_tree_t tree,
+                               void *key,
+                               int (*compare_key)(void *, void *, void *),
+                               void (*delete_key)(void *, void *),
+                               void (*delete_value)(void *, void *),
+                               void *data);
+
+/* Waits until every read-side section open at the time of the call
+   has ended, then frees all nodes and entries replaced so far.
+
+   Must not be called from inside a read-side section.
+*/
+void rcu_red_black_tree_synchronize(rcu_red_black_tree_t tree);
+
+#endif
@@ -0,0 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "rcuredblacktrees.h"
+#include "../RedBlackTrees/redblacktrees.h"
+
+#define NUM_VALUES 1000000
+#define NUM_LOOKUPS 2000000
+#define MAX_THREADS 8
+
+int compare_int(void *a, void *b, void *data)
+{
+    int *ia = (int *)a;
+    int *ib = (int *)b;
+    return (*ia > *ib) - (*ia < *ib);
+}
+
+static void *copy_int(void *ptr, void *data)
+{
+    int *new_int = (int *)malloc(sizeof(int));
+    if (new_int == NULL)
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+    *new_int = *(int *)ptr;
+    return new_int;
+}
+
+static void delete_int(void *ptr, void *data)
+{
+    free(ptr);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static rcu_red_black_tree_t rcu_tree;
+static red_black_tree_t locked_tree;
+static pthread_mutex_t tree_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int writer_done;
+
+// Readers look up random keys, one read-side section resp. one lock
+// acquisition per lookup, as a server answering requests would.
+static void *rcu_reader(void *arg)
+{
+    unsigned int seed = (unsigned int)(size_t)arg;
+    rcu_red_black_tree_reader_t reader = rcu_red_black_tree_reader_register(rcu_tree);
+    size_t found = 0;
+
+    for (int i = 0; i < NUM_LOOKUPS; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 1) % (2 * NUM_VALUES));
+        rcu_red_black_tree_read_lock(reader);
+        if (rcu_red_black_tree_search(reader, &key, compare_int, NULL) != NULL)
+            found++;
+        rcu_red_black_tree_read_unlock(reader);
+    }
+
+    rcu_red_black_tree_reader_unregister(reader);
+    return (void *)found;
+}
+
+static void *locked_reader(void *arg)
+{
+    unsigned int seed = (unsigned int)(size_t)arg;
+    size_t found = 0;
+
+    for (int i = 0; i < NUM_LOOKUPS; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 1) % (2 * NUM_VALUES));
+        pthread_mutex_lock(&tree_lock);
+        if (red_black_tree_search(locked_tree, &key, compare_int, NULL) != NULL)
+            found++;
+        pthread_mutex_unlock(&tree_lock);
+    }
+
+    return (void *)found;
+}
+
+// A single writer keeps inserting and removing odd keys while the
+// readers run.
+static void *rcu_writer(void *arg)
+{
+    unsigned int seed = 7;
+
+    while (!writer_done)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 1) % NUM_VALUES) * 2 + 1;
+        rcu_red_black_tree_insert(rcu_tree, &key, &key, compare_int, copy_int, copy_int, NULL);
+        rcu_red_black_tree_remove(rcu_tree, &key, compare_int, delete_int, delete_int, NULL);
+    }
+    return NULL;
+}
+
+static void *locked_writer(void *arg)
+{
+    unsigned int seed = 7;
+
+    while (!writer_done)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 1) % NUM_VALUES) * 2 + 1;
+        pthread_mutex_lock(&tree_lock);
+        red_black_tree_insert(locked_tree, &key, &key, compare_int, copy_int, copy_int, NULL);
+        red_black_tree_remove(locked_tree, &key, compare_int, delete_int, delete_int, NULL);
+        pthread_mutex_unlock(&tree_lock);
+    }
+    return NULL;
+}
+
+static double run(int num_readers, void *(*reader)(void *), void *(*writer)(void *))
+{
+    pthread_t readers[MAX_THREADS];
+    pthread_t writer_thread;
+
+    writer_done = 0;
+    pthread_create(&writer_thread, NULL, writer, NULL);
+
+    double start = now();
+    for (int i = 0; i < num_readers; i++)
+        pthread_create(&readers[i], NULL, reader, (void *)(size_t)(i + 1));
+    for (int i = 0; i < num_readers; i++)
+        pthread_join(readers[i], NULL);
+    double elapsed = now() - start;
+
+    writer_done = 1;
+    pthread_join(writer_thread, NULL);
+
+    return (double)num_readers * NUM_LOOKUPS / elapsed;
+}
+
+int main()
+{
+    rcu_tree = rcu_red_black_tree_create();
+    locked_tree = red_black_tree_create();
+
+    // Even keys only, so that about half of the lookups hit.
+    for (int i = 0; i < NUM_VALUES; i++)
+    {
+        int key = 2 * i;
+        rcu_red_black_tree_insert(rcu_tree, &key, &key, compare_int, copy_int, copy_int, NULL);
+        red_black_tree_insert(locked_tree, &key, &key, compare_int, copy_int, copy_int, NULL);
+    }
+
+    printf("%d keys, %d lookups per reader, one concurrent writer.\n", NUM_VALUES, NUM_LOOKUPS);
+
+    FILE *outputFile = fopen("RCU_readers_data.csv", "w");
+
+    fprintf(outputFile, "Readers,RCU Lookups per s,Mutex Lookups per s\n");
+
+    for (int num_readers = 1; num_readers <= MAX_THREADS; num_readers *= 2)
+    {
+        double rcu = run(num_readers, rcu_reader, rcu_writer);
+        double locked = run(num_readers, locked_reader, locked_writer);
+
+        printf("%d readers: RCU %.2f M lookups/s, mutex %.2f M lookups/s\n",
+               num_readers, rcu / 1e6, locked / 1e6);
+        fprintf(outputFile, "%d,%.0f,%.0f\n", num_readers, rcu, locked);
+    }
+
+    fclose(outputFile);
+
+    rcu_red_black_tree_delete(rcu_tree, delete_int, delete_int, NULL);
+    red_black_tree_delete(locked_tree, delete_int, delete_int, NULL);
+
+    return 0;
+}
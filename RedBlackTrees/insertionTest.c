@@ -66,5 +66,17 @@ int main()
     printf("Finished inserting values.\n");
     red_black_tree_delete(tree, free, free, NULL);
 
+    // Time the inserts alone on a fresh tree, without the height
+    // computations of the loop above.
+    tree = red_black_tree_create();
+    clock_t start = clock();
+    for (int i = 0; i < NUM_VALUES; i++)
+    {
+        int value = rand() % NUM_VALUES;
+        red_black_tree_insert(tree, &value, &value, compare_int, copy_key, copy_value, NULL);
+    }
+    printf("Inserted %d values in %.3f s.\n", NUM_VALUES, (double)(clock() - start) / CLOCKS_PER_SEC);
+    red_black_tree_delete(tree, free, free, NULL);
+
     return 0;
 }
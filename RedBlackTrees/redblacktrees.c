@@ -1,612 +1,2668 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "redblacktrees_template.h"
 
 typedef enum
 {
-  RED_BLACK_TREE_COLOR_RED,
-  RED_BLACK_TREE_COLOR_BLACK
+  RED_BLACK_TREE_COLOR_RED = RB_TREE_RED,
+  RED_BLACK_TREE_COLOR_BLACK = RB_TREE_BLACK
 } color_t;
 
-typedef struct __tree_node_struct_t *tree_node_t;
-struct __tree_node_struct_t
+/* The nodes and the algorithms on them are those of the generator
+   in redblacktrees_template.h, instantiated with void * keys and
+   values. The color lives in the lowest bit of the parent pointer.
+   The subtree size is not part of the node either: trees that keep
+   sizes store it right behind the node, before its inline entry if
+   any, see __red_black_tree_size_slot. A node takes 40 bytes on
+   64-bit targets, 48 with a subtree size.
+*/
+RB_TREE_DEFINE_NODE(red_black_tree, void *, void *)
+
+typedef red_black_tree_node_t tree_node_t;
+
+#define RED_BLACK_TREE_DEFAULT_NODES_PER_SLAB ((size_t)1024)
+
+/* Number of lookups red_black_tree_search_batch advances in lockstep. */
+#define RED_BLACK_TREE_SEARCH_GROUP ((size_t)16)
+
+/* Smallest black height of either tree for which a set operation
+   hands half of its work to another thread. A tree of black height
+   h holds at least 2^h - 1 entries.
+*/
+#define RED_BLACK_TREE_SET_GRAIN_HEIGHT ((size_t)12)
+
+/* Entry count of a tree that a split or a set operation left
+   without subtree sizes to read it from.
+*/
+#define RED_BLACK_TREE_UNCOUNTED ((size_t)-1)
+
+#if defined(__GNUC__)
+#define __prefetch(address) __builtin_prefetch(address)
+#else
+#define __prefetch(address) ((void)(address))
+#endif
+
+typedef struct __node_slab_struct_t *node_slab_t;
+struct __node_slab_struct_t
+{
+  node_slab_t next;
+  size_t capacity;
+  size_t used;
+  struct red_black_tree_node_struct_t nodes[];
+};
+
+/* An arena merged into another one keeps no nodes and forwards to
+   it through merged_into until the last tree still pointing at it
+   moves on. references counts those trees and the arenas merged
+   into this one.
+*/
+typedef struct __node_arena_struct_t *node_arena_t;
+struct __node_arena_struct_t
 {
-  void *key;
-  void *value;
-  color_t color;
-  tree_node_t parent;
-  tree_node_t left;
-  tree_node_t right;
+  node_arena_t merged_into;
+  node_slab_t slabs;
+  node_slab_t last_slab;
+  tree_node_t free_list;
+  tree_node_t last_free;
+  size_t node_size;
+  size_t nodes_per_slab;
+  size_t number_slabs;
+  size_t nodes_reserved;
+  size_t nodes_in_use;
+  size_t references;
 };
 
 struct __red_black_tree_struct_t
 {
   tree_node_t root;
+  node_arena_t arena;
+  size_t number_entries;
+  int ranked;
+  int inline_entries;
+  size_t key_size;
+  size_t value_size;
 };
 
 #include "redblacktrees.h"
 
-red_black_tree_t red_black_tree_create()
+/* The order the generated descents compare keys in: the
+   comparison function and the data handed to the public call. It
+   is passed down by value rather than kept in the tree, so that
+   concurrent readers may use different ones.
+*/
+typedef struct
 {
-  red_black_tree_t tree;
-  tree = calloc(1, sizeof(*tree));
-  if (tree == NULL)
+  int (*compare_key)(void *, void *, void *);
+  void *data;
+} __red_black_tree_order_t;
+
+static inline __red_black_tree_order_t __order(int (*compare_key)(void *, void *, void *), void *data)
+{
+  __red_black_tree_order_t order;
+  order.compare_key = compare_key;
+  order.data = data;
+  return order;
+}
+
+static inline int __red_black_tree_compare(void *a, void *b, __red_black_tree_order_t order)
+{
+  return order.compare_key(a, b, order.data);
+}
+
+#define __red_black_tree_ranked(tree) ((tree)->ranked)
+
+RB_TREE_DEFINE_CORE(red_black_tree, red_black_tree_t, void *,
+                    __red_black_tree_compare, __red_black_tree_order_t, __red_black_tree_ranked)
+
+/* Rounds a byte count up so that whatever follows stays aligned
+   like a node.
+*/
+static size_t __align_up(size_t n)
+{
+  size_t a = sizeof(void *);
+  return ((n + a - ((size_t)1)) / a) * a;
+}
+
+
+static node_arena_t __node_arena_create(size_t nodes_per_slab, size_t node_size)
+{
+  node_arena_t arena;
+  arena = calloc(1, sizeof(*arena));
+  if (arena == NULL)
   {
     fprintf(stderr, "Error: no memory left.\n");
     exit(1);
   }
-  tree->root = NULL;
-  return tree;
+  if (nodes_per_slab == ((size_t)0))
+    nodes_per_slab = RED_BLACK_TREE_DEFAULT_NODES_PER_SLAB;
+  arena->merged_into = NULL;
+  arena->slabs = NULL;
+  arena->last_slab = NULL;
+  arena->free_list = NULL;
+  arena->last_free = NULL;
+  arena->node_size = node_size;
+  arena->nodes_per_slab = nodes_per_slab;
+  arena->references = (size_t)1;
+  return arena;
 }
 
-static void left_rotate(red_black_tree_t tree, tree_node_t x);
-static void right_rotate(red_black_tree_t tree, tree_node_t y);
-
-void red_black_tree_delete(red_black_tree_t tree,
-                           void (*delete_key)(void *, void *),
-                           void (*delete_value)(void *, void *),
-                           void *data)
+static void __node_arena_delete(node_arena_t arena)
 {
+  node_slab_t slab, next;
+  for (slab = arena->slabs; slab != NULL; slab = next)
+  {
+    next = slab->next;
+    free(slab);
+  }
+  free(arena);
 }
 
-static size_t __red_black_tree_number_entries_aux(tree_node_t node)
+/* Drops one reference to an arena, deleting the arena with the last
+   one. An arena merged into another one holds a reference to it.
+*/
+static void __node_arena_release(node_arena_t arena)
 {
-  size_t l, r, n;
-  if (node == NULL)
-    return ((size_t)0);
-  l = __red_black_tree_number_entries_aux(node->left);
-  r = __red_black_tree_number_entries_aux(node->right);
-  n = (l + r) + ((size_t)1);
-  return n;
+  node_arena_t next;
+
+  while (arena != NULL)
+  {
+    arena->references--;
+    if (arena->references > ((size_t)0))
+      return;
+    next = arena->merged_into;
+    __node_arena_delete(arena);
+    arena = next;
+  }
 }
 
-size_t red_black_tree_number_entries(red_black_tree_t tree)
+/* Merges other into arena in constant time: the slabs and free
+   nodes of other are appended to those of arena, which keeps carving
+   from its own current slab, and other forwards to arena from now on.
+   Both must hold nodes of the same size.
+*/
+static void __node_arena_merge(node_arena_t arena, node_arena_t other)
 {
-  return __red_black_tree_number_entries_aux(tree->root);
+  if (other->slabs != NULL)
+  {
+    if (arena->slabs == NULL)
+      arena->slabs = other->slabs;
+    else
+      arena->last_slab->next = other->slabs;
+    arena->last_slab = other->last_slab;
+  }
+  if (other->free_list != NULL)
+  {
+    if (arena->free_list == NULL)
+      arena->free_list = other->free_list;
+    else
+      arena->last_free->left = other->free_list;
+    arena->last_free = other->last_free;
+  }
+
+  arena->number_slabs += other->number_slabs;
+  arena->nodes_reserved += other->nodes_reserved;
+  arena->nodes_in_use += other->nodes_in_use;
+  other->slabs = NULL;
+  other->last_slab = NULL;
+  other->free_list = NULL;
+  other->last_free = NULL;
+  other->number_slabs = (size_t)0;
+  other->nodes_reserved = (size_t)0;
+  other->nodes_in_use = (size_t)0;
+  other->merged_into = arena;
+  arena->references++;
 }
 
-static tree_node_t __red_black_tree_search_aux(tree_node_t node,
-                                               void *key,
-                                               int (*compare_key)(void *, void *, void *),
-                                               void *data)
+/* Forgets every node of the arena. The largest slab is kept for
+   reuse, the others are released.
+*/
+static void __node_arena_reset(node_arena_t arena)
 {
-  int cmp;
-  if (node == NULL)
-    return NULL;
-  cmp = compare_key(key, node->key, data);
-  if (cmp == 0)
-    return node;
-  if (cmp < 0)
-    return __red_black_tree_search_aux(node->left, key, compare_key, data);
-  return __red_black_tree_search_aux(node->right, key, compare_key, data);
+  node_slab_t slab, next, keep;
+
+  keep = arena->slabs;
+  for (slab = arena->slabs; slab != NULL; slab = slab->next)
+  {
+    if (slab->capacity > keep->capacity)
+      keep = slab;
+  }
+  for (slab = arena->slabs; slab != NULL; slab = next)
+  {
+    next = slab->next;
+    if (slab != keep)
+      free(slab);
+  }
+
+  arena->slabs = keep;
+  arena->last_slab = keep;
+  arena->free_list = NULL;
+  arena->last_free = NULL;
+  arena->number_slabs = (size_t)0;
+  arena->nodes_reserved = (size_t)0;
+  arena->nodes_in_use = (size_t)0;
+  if (keep != NULL)
+  {
+    keep->next = NULL;
+    keep->used = (size_t)0;
+    arena->number_slabs = (size_t)1;
+    arena->nodes_reserved = keep->capacity;
+  }
 }
 
-void *red_black_tree_search(red_black_tree_t tree,
-                            void *key,
-                            int (*compare_key)(void *, void *, void *),
-                            void *data)
+/* Adds a slab of capacity nodes in front of the slab list, so that
+   the next allocations are carved from it.
+*/
+static node_slab_t __node_arena_grow(node_arena_t arena, size_t capacity)
 {
-  tree_node_t node;
-  node = __red_black_tree_search_aux(tree->root, key, compare_key, data);
-  if (node == NULL)
-    return NULL;
-  return node->value;
+  node_slab_t slab;
+  slab = malloc(sizeof(*slab) + capacity * arena->node_size);
+  if (slab == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  slab->next = arena->slabs;
+  slab->capacity = capacity;
+  slab->used = (size_t)0;
+  if (arena->slabs == NULL)
+    arena->last_slab = slab;
+  arena->slabs = slab;
+  arena->number_slabs++;
+  arena->nodes_reserved += capacity;
+  return slab;
 }
 
-void red_black_tree_minimum(void **min_key,
-                            void **min_value,
-                            red_black_tree_t tree)
+static tree_node_t __node_arena_alloc(node_arena_t arena)
 {
+  node_slab_t slab;
   tree_node_t node;
 
-  if (tree->root == NULL)
+  if (arena->free_list != NULL)
   {
-    *min_key = NULL;
-    *min_value = NULL;
-    return;
+    // Reuse a node released by a previous remove.
+    node = arena->free_list;
+    arena->free_list = node->left;
+    if (arena->free_list == NULL)
+      arena->last_free = NULL;
+    arena->nodes_in_use++;
+    return node;
   }
 
-  for (node = tree->root; node->left != NULL; node = node->left)
-    ;
+  slab = arena->slabs;
+  if ((slab == NULL) || (slab->used >= slab->capacity))
+    slab = __node_arena_grow(arena, arena->nodes_per_slab);
 
-  *min_key = node->key;
-  *min_value = node->value;
+  node = (tree_node_t)(((unsigned char *)slab->nodes) + slab->used * arena->node_size);
+  slab->used++;
+  arena->nodes_in_use++;
+  return node;
 }
 
-void red_black_tree_maximum(void **max_key,
-                            void **max_value,
-                            red_black_tree_t tree)
+static void __node_arena_free(node_arena_t arena, tree_node_t node)
 {
-  tree_node_t node;
+  if (arena->free_list == NULL)
+    arena->last_free = node;
+  node->left = arena->free_list;
+  arena->free_list = node;
+  arena->nodes_in_use--;
+}
 
-  if (tree->root == NULL)
-  {
-    *max_key = NULL;
-    *max_value = NULL;
-    return;
-  }
+/* Returns the arena the nodes of a tree come from, or NULL. If the
+   arena of the tree was merged into another one since, the tree
+   moves its reference over to the arena at the end of the chain.
+*/
+static node_arena_t __red_black_tree_arena(red_black_tree_t tree)
+{
+  node_arena_t arena, target;
 
-  for (node = tree->root; node->right != NULL; node = node->right)
+  arena = tree->arena;
+  if ((arena == NULL) || (arena->merged_into == NULL))
+    return arena;
+  for (target = arena->merged_into; target->merged_into != NULL; target = target->merged_into)
     ;
+  target->references++;
+  __node_arena_release(arena);
+  tree->arena = target;
+  return target;
+}
 
-  *max_key = node->key;
-  *max_value = node->value;
+/* Bytes a node of the tree takes: the node, then its subtree size if
+   the tree is ranked, then its inline key and value if any.
+*/
+static size_t __red_black_tree_node_size(red_black_tree_t tree)
+{
+  size_t node_size;
+
+  node_size = sizeof(struct red_black_tree_node_struct_t);
+  if (tree->ranked)
+    node_size += sizeof(size_t);
+  if (tree->inline_entries)
+    node_size += __align_up(tree->key_size) + __align_up(tree->value_size);
+  return node_size;
 }
 
-void red_black_tree_predecessor(void **prec_key,
-                                void **prec_value,
-                                red_black_tree_t tree,
-                                void *key,
-                                int (*compare_key)(void *, void *, void *),
-                                void *data)
+static tree_node_t __red_black_tree_node_alloc(red_black_tree_t tree)
 {
-  tree_node_t x, y;
+  tree_node_t node;
 
-  x = __red_black_tree_search_aux(tree->root, key, compare_key, data);
+  if (tree->arena != NULL)
+    return __node_arena_alloc(__red_black_tree_arena(tree));
 
-  if (x == NULL)
+  node = calloc(1, __red_black_tree_node_size(tree));
+  if (node == NULL)
   {
-    *prec_key = NULL;
-    *prec_value = NULL;
-    return;
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
   }
+  return node;
+}
 
-  if (x->left != NULL)
+static void __red_black_tree_node_free(red_black_tree_t tree, tree_node_t node)
+{
+  if (tree->arena != NULL)
   {
-    for (y = x->left; y->right != NULL; y = y->right)
-      ;
-    *prec_key = y->key;
-    *prec_value = y->value;
+    __node_arena_free(__red_black_tree_arena(tree), node);
     return;
   }
+  free(node);
+}
 
-  for (y = x->parent; ((y != NULL) && (x == y->left));)
+red_black_tree_t red_black_tree_create()
+{
+  red_black_tree_t tree;
+  tree = calloc(1, sizeof(*tree));
+  if (tree == NULL)
   {
-    x = y;
-    y = y->parent;
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
   }
+  tree->root = NULL;
+  tree->arena = NULL;
+  tree->number_entries = (size_t)0;
+  tree->ranked = 0;
+  tree->inline_entries = 0;
+  tree->key_size = (size_t)0;
+  tree->value_size = (size_t)0;
+  return tree;
+}
 
-  if (y == NULL)
-  {
-    *prec_key = NULL;
-    *prec_value = NULL;
-    return;
-  }
-  *prec_key = y->key;
-  *prec_value = y->value;
+red_black_tree_t red_black_tree_create_with_allocator(size_t nodes_per_slab)
+{
+  red_black_tree_t tree;
+  tree = red_black_tree_create();
+  tree->arena = __node_arena_create(nodes_per_slab, __red_black_tree_node_size(tree));
+  return tree;
 }
 
-void red_black_tree_successor(void **succ_key,
-                              void **succ_value,
-                              red_black_tree_t tree,
-                              void *key,
-                              int (*compare_key)(void *, void *, void *),
-                              void *data)
+red_black_tree_t red_black_tree_create_inline(size_t key_size,
+                                              size_t value_size,
+                                              size_t nodes_per_slab)
 {
-  tree_node_t x, y;
+  red_black_tree_t tree;
+
+  tree = red_black_tree_create();
+  tree->inline_entries = 1;
+  tree->key_size = key_size;
+  tree->value_size = value_size;
+  tree->arena = __node_arena_create(nodes_per_slab, __red_black_tree_node_size(tree));
+  return tree;
+}
 
-  x = __red_black_tree_search_aux(tree->root, key, compare_key, data);
+/* Points the key and value of a node of an inline tree at the
+   storage behind the node and its subtree size.
+*/
+static void __red_black_tree_inline_entry(red_black_tree_t tree, tree_node_t node)
+{
+  node->key = (void *)(node + 1);
+  if (tree->ranked)
+    node->key = (void *)(((unsigned char *)node->key) + sizeof(size_t));
+  node->value = (void *)(((unsigned char *)node->key) + __align_up(tree->key_size));
+}
 
-  if (x == NULL)
+/* Stores a key and a value in a fresh node, either by copying them
+   into the node's inline storage or through the copy functions.
+*/
+static void __red_black_tree_store_entry(red_black_tree_t tree,
+                                         tree_node_t node,
+                                         void *key,
+                                         void *value,
+                                         void *(*copy_key)(void *, void *),
+                                         void *(*copy_value)(void *, void *),
+                                         void *data)
+{
+  if (tree->inline_entries)
   {
-    *succ_key = NULL;
-    *succ_value = NULL;
+    __red_black_tree_inline_entry(tree, node);
+    memcpy(node->key, key, tree->key_size);
+    memcpy(node->value, value, tree->value_size);
     return;
   }
+  node->key = copy_key(key, data);
+  node->value = copy_value(value, data);
+}
 
-  if (x->right != NULL)
-  {
-    for (y = x->right; y->left != NULL; y = y->left)
-      ;
-    *succ_key = y->key;
-    *succ_value = y->value;
+static void __red_black_tree_release_entry(red_black_tree_t tree,
+                                           tree_node_t node,
+                                           void (*delete_key)(void *, void *),
+                                           void (*delete_value)(void *, void *),
+                                           void *data)
+{
+  if (tree->inline_entries)
     return;
-  }
+  if (delete_key != NULL)
+    delete_key(node->key, data);
+  if (delete_value != NULL)
+    delete_value(node->value, data);
+}
 
-  for (y = x->parent; ((y != NULL) && (x == y->right));)
-  {
-    x = y;
-    y = y->parent;
-  }
+void red_black_tree_allocator_stats(red_black_tree_allocator_stats_t *stats,
+                                    red_black_tree_t tree)
+{
+  node_arena_t arena = __red_black_tree_arena(tree);
 
-  if (y == NULL)
+  stats->node_size = __red_black_tree_node_size(tree);
+  if (arena == NULL)
   {
-    *succ_key = NULL;
-    *succ_value = NULL;
+    stats->number_slabs = (size_t)0;
+    stats->nodes_per_slab = (size_t)0;
+    stats->nodes_reserved = (size_t)0;
+    stats->nodes_in_use = (size_t)0;
+    stats->nodes_free = (size_t)0;
+    stats->bytes_reserved = (size_t)0;
     return;
   }
-  *succ_key = y->key;
-  *succ_value = y->value;
+  stats->number_slabs = arena->number_slabs;
+  stats->nodes_per_slab = arena->nodes_per_slab;
+  stats->nodes_reserved = arena->nodes_reserved;
+  stats->nodes_in_use = arena->nodes_in_use;
+  stats->nodes_free = arena->nodes_reserved - arena->nodes_in_use;
+  stats->bytes_reserved = arena->number_slabs * sizeof(struct __node_slab_struct_t) +
+                          arena->nodes_reserved * arena->node_size;
 }
-static tree_node_t __red_black_tree_insert_aux(void *key,
-                                               void *value,
-                                               void *(*copy_key)(void *, void *),
-                                               void *(*copy_value)(void *, void *),
-                                               void *data)
+
+static tree_node_t __red_black_tree_build_aux(red_black_tree_t tree,
+                                              void **keys,
+                                              void **values,
+                                              size_t lo,
+                                              size_t hi,
+                                              size_t depth,
+                                              size_t red_depth,
+                                              tree_node_t parent,
+                                              void *(*copy_key)(void *, void *),
+                                              void *(*copy_value)(void *, void *),
+                                              void *data)
 {
-  tree_node_t new_node;
-  new_node = calloc(1, sizeof(*new_node));
-  if (new_node == NULL)
-  {
-    fprintf(stderr, "Error: no memory left.\n");
-    exit(1);
-  }
+  tree_node_t node;
+  size_t mid;
 
-  new_node->key = copy_key(key, data);
-  new_node->value = copy_value(value, data);
-  new_node->color = RED_BLACK_TREE_COLOR_RED;
-  new_node->parent = NULL;
-  new_node->left = NULL;
-  new_node->right = NULL;
+  if (lo >= hi)
+    return NULL;
 
-  return new_node;
+  mid = lo + (hi - lo) / ((size_t)2);
+  node = __node_arena_alloc(tree->arena);
+  __red_black_tree_store_entry(tree, node, keys[mid], values[mid], copy_key, copy_value, data);
+  __red_black_tree_set_color(node, (depth == red_depth) ? RED_BLACK_TREE_COLOR_RED
+                                                        : RED_BLACK_TREE_COLOR_BLACK);
+  __red_black_tree_set_parent(node, parent);
+  node->left = __red_black_tree_build_aux(tree, keys, values, lo, mid, depth + ((size_t)1), red_depth,
+                                          node, copy_key, copy_value, data);
+  node->right = __red_black_tree_build_aux(tree, keys, values, mid + ((size_t)1), hi, depth + ((size_t)1),
+                                           red_depth, node, copy_key, copy_value, data);
+  return node;
 }
 
-static size_t __red_black_tree_height_aux(tree_node_t node)
+red_black_tree_t red_black_tree_build_sorted(void **keys,
+                                             void **values,
+                                             size_t n,
+                                             void *(*copy_key)(void *, void *),
+                                             void *(*copy_value)(void *, void *),
+                                             void *data)
 {
-  size_t l, r, h;
+  red_black_tree_t tree;
+  size_t bottom, red_depth;
+
+  tree = red_black_tree_create_with_allocator((size_t)0);
+  if (n == ((size_t)0))
+    return tree;
+  __node_arena_grow(tree->arena, n);
+
+  /* Splitting every range at its middle puts all leaves on the
+     last two levels. If the last level is not full, coloring it
+     red gives every path the same number of black nodes; red
+     nodes there have no children, so no red node gets a red child.
+  */
+  for (bottom = (size_t)0; (n >> bottom) > ((size_t)1); bottom++)
+    ;
+  red_depth = (((n + ((size_t)1)) & n) == ((size_t)0)) ? ((size_t)-1) : bottom;
 
-  if (node == NULL)
-    return ((size_t)0);
+  tree->root = __red_black_tree_build_aux(tree, keys, values, (size_t)0, n, (size_t)0, red_depth,
+                                          NULL, copy_key, copy_value, data);
+  tree->number_entries = n;
+  return tree;
+}
 
-  l = __red_black_tree_height_aux(node->left);
-  r = __red_black_tree_height_aux(node->right);
+/* Returns the number of entries of a tree. After a split or a set
+   operation on a tree without subtree sizes, the entries are counted
+   once in O(n).
+*/
+static size_t __red_black_tree_count(red_black_tree_t tree)
+{
+  tree_node_t node;
+  size_t n;
 
-  h = ((l > r) ? l : r) + ((size_t)1);
+  if (tree->number_entries != RED_BLACK_TREE_UNCOUNTED)
+    return tree->number_entries;
 
-  return h;
+  n = (size_t)0;
+  for (node = __red_black_tree_first(tree->root); node != NULL; node = __red_black_tree_next(node))
+    n++;
+  tree->number_entries = n;
+  return n;
 }
 
-size_t red_black_tree_height(red_black_tree_t tree)
+/* Performs count left rotations down the right spine starting at
+   the root, every other node of the spine becoming the left child
+   of the next one. Nodes rotated down get color.
+*/
+static void __red_black_tree_compress(red_black_tree_t tree, size_t count, color_t color)
 {
-  return __red_black_tree_height_aux(tree->root);
-}
+  tree_node_t x;
+  size_t i;
 
-static void __red_black_tree_insert_fix(red_black_tree_t tree, tree_node_t z)
-{
-  while (z != tree->root && z->parent->color == RED_BLACK_TREE_COLOR_RED)
+  x = tree->root;
+  for (i = (size_t)0; i < count; i++)
   {
-    if (z->parent == z->parent->parent->left)
-    {
-      tree_node_t y = z->parent->parent->right;
-      if (y != NULL && y->color == RED_BLACK_TREE_COLOR_RED)
-      {
-        // red uncle
-        z->parent->color = RED_BLACK_TREE_COLOR_BLACK;
-        y->color = RED_BLACK_TREE_COLOR_BLACK;
-        z->parent->parent->color = RED_BLACK_TREE_COLOR_RED;
-        z = z->parent->parent;
-      }
-      else
-      {
-        if (z == z->parent->right)
-        {
-          // black uncle, z is on right side
-          z = z->parent;
-          left_rotate(tree, z);
-        }
-        // black uncle, z is on left side
-        z->parent->color = RED_BLACK_TREE_COLOR_BLACK;
-        z->parent->parent->color = RED_BLACK_TREE_COLOR_RED;
-        right_rotate(tree, z->parent->parent);
-      }
-    }
-    else
-    {
-      // same for right side
-      tree_node_t y = z->parent->parent->left;
-      if (y != NULL && y->color == RED_BLACK_TREE_COLOR_RED)
-      {
-        // red uncle
-        z->parent->color = RED_BLACK_TREE_COLOR_BLACK;
-        y->color = RED_BLACK_TREE_COLOR_BLACK;
-        z->parent->parent->color = RED_BLACK_TREE_COLOR_RED;
-        z = z->parent->parent;
-      }
-      else
-      {
-        if (z == z->parent->left)
-        {
-          // black uncle, z is on left
-          z = z->parent;
-          right_rotate(tree, z);
-        }
-        // black uncle, z is on right
-        z->parent->color = RED_BLACK_TREE_COLOR_BLACK;
-        z->parent->parent->color = RED_BLACK_TREE_COLOR_RED;
-        left_rotate(tree, z->parent->parent);
-      }
-    }
+    __red_black_tree_left_rotate(tree, x);
+    __red_black_tree_set_color(x, color);
+    x = __red_black_tree_parent(x)->right;
   }
-  tree->root->color = RED_BLACK_TREE_COLOR_BLACK;
 }
 
-void red_black_tree_insert(red_black_tree_t tree,
-                           void *key,
-                           void *value,
-                           int (*compare_key)(void *, void *, void *),
-                           void *(*copy_key)(void *, void *),
-                           void *(*copy_value)(void *, void *),
-                           void *data)
+void red_black_tree_rebuild(red_black_tree_t tree)
 {
-  tree_node_t x, y, z;
-
-  if (__red_black_tree_search_aux(tree->root, key, compare_key, data) != NULL)
-    return;
-
-  z = __red_black_tree_insert_aux(key, value, copy_key, copy_value, data);
+  tree_node_t x;
+  size_t n, full;
 
-  if (tree->root == NULL)
-  {
-    z->color = RED_BLACK_TREE_COLOR_BLACK;
-    tree->root = z;
+  n = __red_black_tree_count(tree);
+  if (n == ((size_t)0))
     return;
-  }
 
+  // Turn the tree into a right spine, sorted from the root down.
   x = tree->root;
-  y = NULL;
   while (x != NULL)
   {
-    y = x;
-    if (compare_key(z->key, x->key, data) < 0)
+    if (x->left != NULL)
     {
-      x = x->left;
+      __red_black_tree_right_rotate(tree, x);
+      x = __red_black_tree_parent(x);
     }
     else
     {
+      __red_black_tree_set_color(x, RED_BLACK_TREE_COLOR_BLACK);
       x = x->right;
     }
   }
-  z->parent = y;
-  if (y == NULL)
+
+  /* The first pass moves the nodes beyond the largest perfect tree
+     down to the last level, as red leaves below black nodes; the
+     following passes halve the spine and only move black nodes, so
+     every path keeps the same number of black nodes.
+  */
+  for (full = (size_t)1; ((full << 1) + ((size_t)1)) <= n; full = (full << 1) + ((size_t)1))
+    ;
+  __red_black_tree_compress(tree, n - full, RED_BLACK_TREE_COLOR_RED);
+  while (full > ((size_t)1))
   {
-    tree->root = z;
+    full >>= 1;
+    __red_black_tree_compress(tree, full, RED_BLACK_TREE_COLOR_BLACK);
   }
-  else
+  __red_black_tree_set_color(tree->root, RED_BLACK_TREE_COLOR_BLACK);
+}
+
+/* Releases all entries of a tree, leaving it empty. Runs in O(n)
+   with constant extra memory: the walk goes down to a leaf, unhooks
+   it from its parent and climbs back through the parent pointer.
+*/
+static void __red_black_tree_clear_aux(red_black_tree_t tree,
+                                       void (*delete_key)(void *, void *),
+                                       void (*delete_value)(void *, void *),
+                                       void *data)
+{
+  tree_node_t node, parent;
+  int shared;
+
+  // Nothing to do per node if the arena takes the nodes back at once.
+  // An arena shared with trees split off this one holds their nodes
+  // too, so those go back one by one.
+  // An arena that others were merged into holds their nodes as well.
+  shared = (__red_black_tree_arena(tree) != NULL) && (tree->arena->references > ((size_t)1));
+  if ((tree->arena != NULL) && !shared &&
+      (tree->inline_entries || ((delete_key == NULL) && (delete_value == NULL))))
+  {
+    __node_arena_reset(tree->arena);
+    tree->root = NULL;
+    tree->number_entries = (size_t)0;
+    return;
+  }
+
+  node = tree->root;
+  while (node != NULL)
   {
-    if (compare_key(z->key, y->key, data) < 0)
+    if (node->left != NULL)
+    {
+      node = node->left;
+    }
+    else if (node->right != NULL)
     {
-      y->left = z;
+      node = node->right;
     }
     else
     {
-      y->right = z;
+      parent = __red_black_tree_parent(node);
+      if (parent != NULL)
+      {
+        if (parent->left == node)
+          parent->left = NULL;
+        else
+          parent->right = NULL;
+      }
+      __red_black_tree_release_entry(tree, node, delete_key, delete_value, data);
+      if ((tree->arena == NULL) || shared)
+        __red_black_tree_node_free(tree, node);
+      node = parent;
     }
   }
-  __red_black_tree_insert_fix(tree, z);
+
+  if ((tree->arena != NULL) && !shared)
+    __node_arena_reset(tree->arena);
+  tree->root = NULL;
+  tree->number_entries = (size_t)0;
 }
 
-static void left_rotate(red_black_tree_t tree, tree_node_t x)
+void red_black_tree_delete(red_black_tree_t tree,
+                           void (*delete_key)(void *, void *),
+                           void (*delete_value)(void *, void *),
+                           void *data)
 {
-  tree_node_t y = x->right;
-  x->right = y->left;
-  if (y->left != NULL)
-  {
-    y->left->parent = x;
+  __red_black_tree_clear_aux(tree, delete_key, delete_value, data);
+  if (tree->arena != NULL)
+    __node_arena_release(tree->arena);
+  free(tree);
+}
+
+void red_black_tree_clear(red_black_tree_t tree,
+                          void (*delete_key)(void *, void *),
+                          void (*delete_value)(void *, void *),
+                          void *data)
+{
+  __red_black_tree_clear_aux(tree, delete_key, delete_value, data);
+}
+
+size_t red_black_tree_number_entries(red_black_tree_t tree)
+{
+  return __red_black_tree_count(tree);
+}
+
+static tree_node_t __red_black_tree_relocate(red_black_tree_t tree,
+                                             red_black_tree_t other,
+                                             tree_node_t node,
+                                             tree_node_t parent);
+
+void red_black_tree_set_ranked(red_black_tree_t tree, int ranked)
+{
+  struct __red_black_tree_struct_t old;
+
+  ranked = (ranked != 0);
+  if (tree->ranked == ranked)
+    return;
+
+  // The nodes change size, so they all move to a new allocator.
+  __red_black_tree_arena(tree);
+  old = *tree;
+  tree->ranked = ranked;
+  if (old.arena != NULL)
+    tree->arena = __node_arena_create(old.arena->nodes_per_slab, __red_black_tree_node_size(tree));
+  tree->root = __red_black_tree_relocate(tree, &old, old.root, NULL);
+  if (old.arena != NULL)
+    __node_arena_release(old.arena);
+  if (ranked)
+    tree->number_entries = __red_black_tree_size(tree->root);
+}
+
+static void __red_black_tree_report(void **found_key,
+                                    void **found_value,
+                                    red_black_tree_position_t *position,
+                                    tree_node_t node)
+{
+  if (position != NULL)
+    *position = (red_black_tree_position_t)node;
+  if (node == NULL)
+  {
+    *found_key = NULL;
+    *found_value = NULL;
+    return;
+  }
+  *found_key = node->key;
+  *found_value = node->value;
+}
+
+void red_black_tree_lower_bound(void **found_key,
+                                void **found_value,
+                                red_black_tree_position_t *position,
+                                red_black_tree_t tree,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data)
+{
+  __red_black_tree_report(found_key, found_value, position,
+                          __red_black_tree_first_after(tree->root, key, 1, __order(compare_key, data)));
+}
+
+void red_black_tree_upper_bound(void **found_key,
+                                void **found_value,
+                                red_black_tree_position_t *position,
+                                red_black_tree_t tree,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data)
+{
+  __red_black_tree_report(found_key, found_value, position,
+                          __red_black_tree_first_after(tree->root, key, 0, __order(compare_key, data)));
+}
+
+void red_black_tree_floor(void **found_key,
+                          void **found_value,
+                          red_black_tree_position_t *position,
+                          red_black_tree_t tree,
+                          void *key,
+                          int (*compare_key)(void *, void *, void *),
+                          void *data)
+{
+  __red_black_tree_report(found_key, found_value, position,
+                          __red_black_tree_last_before(tree->root, key, 1, __order(compare_key, data)));
+}
+
+void red_black_tree_ceiling(void **found_key,
+                            void **found_value,
+                            red_black_tree_position_t *position,
+                            red_black_tree_t tree,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data)
+{
+  red_black_tree_lower_bound(found_key, found_value, position,
+                             tree, key, compare_key, data);
+}
+
+void *red_black_tree_position_key(red_black_tree_position_t position)
+{
+  return ((tree_node_t)position)->key;
+}
+
+void *red_black_tree_position_value(red_black_tree_position_t position)
+{
+  return ((tree_node_t)position)->value;
+}
+
+void *red_black_tree_search(red_black_tree_t tree,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data)
+{
+  tree_node_t node;
+  node = __red_black_tree_search_aux(tree->root, key, __order(compare_key, data));
+  if (node == NULL)
+    return NULL;
+  return node->value;
+}
+
+/* Runs the lookups of a batch in groups. Within a group, every
+   lookup takes one step per round: first the keys of the current
+   nodes of all lookups are prefetched, then each lookup compares
+   against its node and prefetches the child it moves to. The cache
+   misses of one lookup are thus overlapped with the work on the
+   other lookups of the group instead of stalling each lookup in
+   turn.
+*/
+void red_black_tree_search_batch(void **values,
+                                 red_black_tree_t tree,
+                                 void **keys,
+                                 size_t n,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void *data)
+{
+  tree_node_t nodes[RED_BLACK_TREE_SEARCH_GROUP];
+  size_t start, group, i, active;
+  int cmp;
+
+  for (start = 0; start < n; start += group)
+  {
+    group = n - start;
+    if (group > RED_BLACK_TREE_SEARCH_GROUP)
+      group = RED_BLACK_TREE_SEARCH_GROUP;
+
+    for (i = 0; i < group; i++)
+    {
+      nodes[i] = tree->root;
+      values[start + i] = NULL;
+    }
+
+    for (active = (tree->root == NULL) ? 0 : group; active > 0;)
+    {
+      for (i = 0; i < group; i++)
+      {
+        if (nodes[i] != NULL)
+          __prefetch(nodes[i]->key);
+      }
+
+      active = 0;
+      for (i = 0; i < group; i++)
+      {
+        if (nodes[i] == NULL)
+          continue;
+        cmp = compare_key(keys[start + i], nodes[i]->key, data);
+        if (cmp == 0)
+        {
+          values[start + i] = nodes[i]->value;
+          nodes[i] = NULL;
+          continue;
+        }
+        nodes[i] = (cmp < 0) ? nodes[i]->left : nodes[i]->right;
+        if (nodes[i] != NULL)
+        {
+          __prefetch(nodes[i]);
+          active++;
+        }
+      }
+    }
+  }
+}
+
+void red_black_tree_minimum(void **min_key,
+                            void **min_value,
+                            red_black_tree_t tree)
+{
+  tree_node_t node;
+
+  if (tree->root == NULL)
+  {
+    *min_key = NULL;
+    *min_value = NULL;
+    return;
+  }
+
+  for (node = tree->root; node->left != NULL; node = node->left)
+    ;
+
+  *min_key = node->key;
+  *min_value = node->value;
+}
+
+void red_black_tree_maximum(void **max_key,
+                            void **max_value,
+                            red_black_tree_t tree)
+{
+  tree_node_t node;
+
+  if (tree->root == NULL)
+  {
+    *max_key = NULL;
+    *max_value = NULL;
+    return;
+  }
+
+  for (node = tree->root; node->right != NULL; node = node->right)
+    ;
+
+  *max_key = node->key;
+  *max_value = node->value;
+}
+
+void red_black_tree_predecessor(void **prec_key,
+                                void **prec_value,
+                                red_black_tree_t tree,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data)
+{
+  tree_node_t x, y;
+
+  x = __red_black_tree_search_aux(tree->root, key, __order(compare_key, data));
+
+  if (x == NULL)
+  {
+    *prec_key = NULL;
+    *prec_value = NULL;
+    return;
+  }
+
+  y = __red_black_tree_prev(x);
+  if (y == NULL)
+  {
+    *prec_key = NULL;
+    *prec_value = NULL;
+    return;
+  }
+  *prec_key = y->key;
+  *prec_value = y->value;
+}
+
+void red_black_tree_successor(void **succ_key,
+                              void **succ_value,
+                              red_black_tree_t tree,
+                              void *key,
+                              int (*compare_key)(void *, void *, void *),
+                              void *data)
+{
+  tree_node_t x, y;
+
+  x = __red_black_tree_search_aux(tree->root, key, __order(compare_key, data));
+
+  if (x == NULL)
+  {
+    *succ_key = NULL;
+    *succ_value = NULL;
+    return;
+  }
+
+  y = __red_black_tree_next(x);
+  if (y == NULL)
+  {
+    *succ_key = NULL;
+    *succ_value = NULL;
+    return;
+  }
+  *succ_key = y->key;
+  *succ_value = y->value;
+}
+
+int red_black_tree_cursor_begin(red_black_tree_cursor_t *cursor,
+                                red_black_tree_t tree)
+{
+  cursor->tree = tree;
+  cursor->position = (red_black_tree_position_t)__red_black_tree_first(tree->root);
+  return cursor->position != NULL;
+}
+
+int red_black_tree_cursor_end(red_black_tree_cursor_t *cursor,
+                              red_black_tree_t tree)
+{
+  cursor->tree = tree;
+  cursor->position = NULL;
+  return 0;
+}
+
+int red_black_tree_cursor_seek(red_black_tree_cursor_t *cursor,
+                               red_black_tree_t tree,
+                               void *key,
+                               int (*compare_key)(void *, void *, void *),
+                               void *data)
+{
+  cursor->tree = tree;
+  cursor->position = (red_black_tree_position_t)__red_black_tree_first_after(tree->root, key, 1,
+                                                                             __order(compare_key, data));
+  return cursor->position != NULL;
+}
+
+int red_black_tree_cursor_at(red_black_tree_cursor_t *cursor,
+                             red_black_tree_t tree,
+                             red_black_tree_position_t position)
+{
+  cursor->tree = tree;
+  cursor->position = position;
+  return cursor->position != NULL;
+}
+
+int red_black_tree_cursor_next(red_black_tree_cursor_t *cursor)
+{
+  tree_node_t node = (tree_node_t)cursor->position;
+
+  if (node == NULL)
+    node = __red_black_tree_first(cursor->tree->root);
+  else
+    node = __red_black_tree_next(node);
+  cursor->position = (red_black_tree_position_t)node;
+  return node != NULL;
+}
+
+int red_black_tree_cursor_prev(red_black_tree_cursor_t *cursor)
+{
+  tree_node_t node = (tree_node_t)cursor->position;
+
+  if (node == NULL)
+    node = __red_black_tree_last(cursor->tree->root);
+  else
+    node = __red_black_tree_prev(node);
+  cursor->position = (red_black_tree_position_t)node;
+  return node != NULL;
+}
+
+int red_black_tree_cursor_valid(red_black_tree_cursor_t *cursor)
+{
+  return cursor->position != NULL;
+}
+
+void *red_black_tree_cursor_key(red_black_tree_cursor_t *cursor)
+{
+  return ((tree_node_t)cursor->position)->key;
+}
+
+void *red_black_tree_cursor_value(red_black_tree_cursor_t *cursor)
+{
+  return ((tree_node_t)cursor->position)->value;
+}
+
+void red_black_tree_select(void **found_key,
+                           void **found_value,
+                           red_black_tree_position_t *position,
+                           red_black_tree_t tree,
+                           size_t k)
+{
+  tree_node_t node = tree->root;
+  size_t l;
+
+  // Without subtree sizes, step through the first k entries.
+  if (!tree->ranked)
+  {
+    for (node = __red_black_tree_first(node); (node != NULL) && (k > ((size_t)0)); k--)
+      node = __red_black_tree_next(node);
+    __red_black_tree_report(found_key, found_value, position, node);
+    return;
+  }
+
+  while (node != NULL)
+  {
+    l = __red_black_tree_size(node->left);
+    if (k == l)
+      break;
+    if (k < l)
+    {
+      node = node->left;
+    }
+    else
+    {
+      k -= l + ((size_t)1);
+      node = node->right;
+    }
+  }
+  __red_black_tree_report(found_key, found_value, position, node);
+}
+
+/* Returns the number of keys strictly less than key (inclusive == 0)
+   resp. less than or equal to key (inclusive != 0).
+*/
+static size_t __red_black_tree_rank_aux(tree_node_t node,
+                                        void *key,
+                                        int inclusive,
+                                        int (*compare_key)(void *, void *, void *),
+                                        void *data)
+{
+  size_t rank = (size_t)0;
+  int cmp;
+
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if ((cmp > 0) || ((cmp == 0) && inclusive))
+    {
+      rank += __red_black_tree_size(node->left) + ((size_t)1);
+      node = node->right;
+    }
+    else if (cmp < 0)
+    {
+      node = node->left;
+    }
+    else
+    {
+      rank += __red_black_tree_size(node->left);
+      break;
+    }
+  }
+  return rank;
+}
+
+/* Counts the entries from node on in key order whose keys are less
+   than hi, or all of them if hi is NULL.
+*/
+static size_t __red_black_tree_count_walk(tree_node_t node,
+                                          void *hi,
+                                          int (*compare_key)(void *, void *, void *),
+                                          void *data)
+{
+  size_t count = (size_t)0;
+
+  for (; node != NULL; node = __red_black_tree_next(node))
+  {
+    if ((hi != NULL) && (compare_key(node->key, hi, data) >= 0))
+      break;
+    count++;
+  }
+  return count;
+}
+
+size_t red_black_tree_rank(red_black_tree_t tree,
+                           void *key,
+                           int (*compare_key)(void *, void *, void *),
+                           void *data)
+{
+  if (!tree->ranked)
+    return __red_black_tree_count_walk(__red_black_tree_first(tree->root), key, compare_key, data);
+  return __red_black_tree_rank_aux(tree->root, key, 0, compare_key, data);
+}
+
+size_t red_black_tree_count_in_range(red_black_tree_t tree,
+                                     void *lo,
+                                     void *hi,
+                                     int (*compare_key)(void *, void *, void *),
+                                     void *data)
+{
+  tree_node_t node;
+  size_t below_lo, below_hi;
+
+  if (!tree->ranked)
+  {
+    if (lo == NULL)
+      node = __red_black_tree_first(tree->root);
+    else
+      node = __red_black_tree_first_after(tree->root, lo, 1, __order(compare_key, data));
+    return __red_black_tree_count_walk(node, hi, compare_key, data);
+  }
+
+  below_lo = (lo == NULL) ? ((size_t)0) : __red_black_tree_rank_aux(tree->root, lo, 0, compare_key, data);
+  below_hi = (hi == NULL) ? tree->number_entries : __red_black_tree_rank_aux(tree->root, hi, 0, compare_key, data);
+  if (below_hi < below_lo)
+    return (size_t)0;
+  return below_hi - below_lo;
+}
+
+size_t red_black_tree_range_foreach(red_black_tree_t tree,
+                                   void *lo,
+                                   void *hi,
+                                   int (*compare_key)(void *, void *, void *),
+                                   int (*visitor)(void *, void *, void *),
+                                   void *data)
+{
+  tree_node_t node;
+  size_t count = (size_t)0;
+
+  // Counting alone does not need to look at the entries.
+  if (visitor == NULL)
+    return red_black_tree_count_in_range(tree, lo, hi, compare_key, data);
+
+  if (lo == NULL)
+    node = __red_black_tree_first(tree->root);
+  else
+    node = __red_black_tree_first_after(tree->root, lo, 1, __order(compare_key, data));
+
+  for (; node != NULL; node = __red_black_tree_next(node))
+  {
+    if ((hi != NULL) && (compare_key(node->key, hi, data) >= 0))
+      break;
+    count++;
+    if (visitor(node->key, node->value, data))
+      break;
+  }
+  return count;
+}
+
+static tree_node_t __red_black_tree_insert_aux(red_black_tree_t tree,
+                                               void *key,
+                                               void *value,
+                                               void *(*copy_key)(void *, void *),
+                                               void *(*copy_value)(void *, void *),
+                                               void *data)
+{
+  tree_node_t new_node;
+  new_node = __red_black_tree_node_alloc(tree);
+
+  __red_black_tree_store_entry(tree, new_node, key, value, copy_key, copy_value, data);
+  __red_black_tree_set_color(new_node, RED_BLACK_TREE_COLOR_RED);
+  __red_black_tree_set_parent(new_node, NULL);
+  new_node->left = NULL;
+  new_node->right = NULL;
+  if (tree->ranked)
+    *__red_black_tree_size_slot(new_node) = (size_t)1;
+
+  return new_node;
+}
+
+size_t red_black_tree_height(red_black_tree_t tree)
+{
+  return __red_black_tree_height_aux(tree->root);
+}
+
+size_t red_black_tree_black_height(red_black_tree_t tree)
+{
+  return __red_black_tree_black_height_aux(tree->root);
+}
+
+static size_t __floor_log2(size_t n)
+{
+  size_t l;
+  for (l = (size_t)0; n > ((size_t)1); n >>= 1)
+    l++;
+  return l;
+}
+
+void red_black_tree_height_bounds(size_t *min_height,
+                                  size_t *max_height,
+                                  red_black_tree_t tree)
+{
+  size_t n, bh, lo, hi;
+
+  n = __red_black_tree_count(tree);
+  if (n == ((size_t)0))
+  {
+    *min_height = (size_t)0;
+    *max_height = (size_t)0;
+    return;
+  }
+
+  // A binary tree with n nodes has height at least ceil(log2(n + 1)),
+  // a red-black tree has height at most 2 * log2(n + 1) and lies
+  // between its black height and twice its black height.
+  bh = red_black_tree_black_height(tree);
+  lo = __floor_log2(n) + ((size_t)1);
+  hi = ((size_t)2) * __floor_log2(n + ((size_t)1));
+  if (bh > lo)
+    lo = bh;
+  if (((size_t)2) * bh < hi)
+    hi = ((size_t)2) * bh;
+  *min_height = lo;
+  *max_height = hi;
+}
+
+static tree_node_t __red_black_tree_locate(tree_node_t *parent,
+                                           int *cmp,
+                                           red_black_tree_t tree,
+                                           void *key,
+                                           int (*compare_key)(void *, void *, void *),
+                                           void *data)
+{
+  return __red_black_tree_locate_from(parent, cmp, tree->root, key, __order(compare_key, data));
+}
+
+/* Links the fresh node z below y on the side given by cmp,
+   counting it.
+*/
+static void __red_black_tree_attach(red_black_tree_t tree,
+                                    tree_node_t z,
+                                    tree_node_t y,
+                                    int cmp)
+{
+  if (tree->number_entries != RED_BLACK_TREE_UNCOUNTED)
+    tree->number_entries++;
+  __red_black_tree_link(tree, z, y, cmp);
+}
+
+void red_black_tree_insert(red_black_tree_t tree,
+                           void *key,
+                           void *value,
+                           int (*compare_key)(void *, void *, void *),
+                           void *(*copy_key)(void *, void *),
+                           void *(*copy_value)(void *, void *),
+                           void *data)
+{
+  red_black_tree_insert_or_get(NULL, tree, key, value,
+                               compare_key, copy_key, copy_value, data);
+}
+
+int red_black_tree_insert_or_get(void **value_in_tree,
+                                 red_black_tree_t tree,
+                                 void *key,
+                                 void *value,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void *(*copy_key)(void *, void *),
+                                 void *(*copy_value)(void *, void *),
+                                 void *data)
+{
+  tree_node_t y, z;
+  int cmp;
+
+  z = __red_black_tree_locate(&y, &cmp, tree, key, compare_key, data);
+  if (z != NULL)
+  {
+    if (value_in_tree != NULL)
+      *value_in_tree = z->value;
+    return 0;
+  }
+
+  z = __red_black_tree_insert_aux(tree, key, value, copy_key, copy_value, data);
+  __red_black_tree_attach(tree, z, y, cmp);
+  if (value_in_tree != NULL)
+    *value_in_tree = z->value;
+  return 1;
+}
+
+int red_black_tree_upsert(red_black_tree_t tree,
+                          void *key,
+                          void *value,
+                          int (*compare_key)(void *, void *, void *),
+                          void *(*copy_key)(void *, void *),
+                          void *(*copy_value)(void *, void *),
+                          void (*delete_value)(void *, void *),
+                          void *data)
+{
+  tree_node_t y, z;
+  int cmp;
+
+  z = __red_black_tree_locate(&y, &cmp, tree, key, compare_key, data);
+  if (z != NULL)
+  {
+    // Replace the value in place, the key and the node stay.
+    if (tree->inline_entries)
+    {
+      memcpy(z->value, value, tree->value_size);
+    }
+    else
+    {
+      if (delete_value != NULL)
+        delete_value(z->value, data);
+      z->value = copy_value(value, data);
+    }
+    return 1;
+  }
+
+  z = __red_black_tree_insert_aux(tree, key, value, copy_key, copy_value, data);
+  __red_black_tree_attach(tree, z, y, cmp);
+  return 0;
+}
+
+/* Sorts the permutation order[0..n-1] of the batch by key with a
+   stable bottom-up merge sort, so that the first of several equal
+   keys stays first, as with one-by-one insertion.
+*/
+static void __red_black_tree_sort_batch(size_t *order,
+                                        size_t n,
+                                        void **keys,
+                                        int (*compare_key)(void *, void *, void *),
+                                        void *data)
+{
+  size_t *src, *dst, *tmp, width, lo, mid, hi, i, j, k;
+
+  tmp = malloc(n * sizeof(*tmp));
+  if (tmp == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+
+  src = order;
+  dst = tmp;
+  for (width = (size_t)1; width < n; width *= (size_t)2)
+  {
+    for (lo = (size_t)0; lo < n; lo += ((size_t)2) * width)
+    {
+      mid = (lo + width < n) ? lo + width : n;
+      hi = (mid + width < n) ? mid + width : n;
+      i = lo;
+      j = mid;
+      for (k = lo; k < hi; k++)
+      {
+        if ((i < mid) && ((j >= hi) || (compare_key(keys[src[j]], keys[src[i]], data) >= 0)))
+          dst[k] = src[i++];
+        else
+          dst[k] = src[j++];
+      }
+    }
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != order)
+  {
+    for (k = (size_t)0; k < n; k++)
+      order[k] = src[k];
+    free(src);
+  }
+  else
+  {
+    free(dst);
+  }
+}
+
+/* Finds where key belongs starting from the node finger, whose key
+   is not greater than key. Climbs while key lies beyond the subtree
+   of the current node, which only takes a comparison where the
+   node is a left child, then descends from there.
+*/
+static tree_node_t __red_black_tree_locate_finger(tree_node_t *parent,
+                                                  int *cmp,
+                                                  red_black_tree_t tree,
+                                                  tree_node_t finger,
+                                                  void *key,
+                                                  int (*compare_key)(void *, void *, void *),
+                                                  void *data)
+{
+  tree_node_t x;
+  int c;
+
+  if (finger == NULL)
+    return __red_black_tree_locate(parent, cmp, tree, key, compare_key, data);
+
+  for (x = finger; __red_black_tree_parent(x) != NULL; x = __red_black_tree_parent(x))
+  {
+    if (x == __red_black_tree_parent(x)->left)
+    {
+      c = compare_key(key, __red_black_tree_parent(x)->key, data);
+      if (c == 0)
+        return __red_black_tree_parent(x);
+      if (c < 0)
+        break;
+    }
+  }
+  return __red_black_tree_locate_from(parent, cmp, x, key, __order(compare_key, data));
+}
+
+size_t red_black_tree_insert_batch(red_black_tree_t tree,
+                                   void **keys,
+                                   void **values,
+                                   size_t n,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *(*copy_key)(void *, void *),
+                                   void *(*copy_value)(void *, void *),
+                                   void *data)
+{
+  tree_node_t finger, y, z;
+  size_t *order, i, j, inserted;
+  int cmp, sorted;
+
+  sorted = 1;
+  for (i = (size_t)1; sorted && (i < n); i++)
+  {
+    if (compare_key(keys[i - ((size_t)1)], keys[i], data) > 0)
+      sorted = 0;
+  }
+
+  order = NULL;
+  if (!sorted)
+  {
+    order = malloc(n * sizeof(*order));
+    if (order == NULL)
+    {
+      fprintf(stderr, "Error: no memory left.\n");
+      exit(1);
+    }
+    for (i = (size_t)0; i < n; i++)
+      order[i] = i;
+    __red_black_tree_sort_batch(order, n, keys, compare_key, data);
+  }
+
+  inserted = (size_t)0;
+  finger = NULL;
+  for (i = (size_t)0; i < n; i++)
+  {
+    j = (order == NULL) ? i : order[i];
+    z = __red_black_tree_locate_finger(&y, &cmp, tree, finger, keys[j], compare_key, data);
+    if (z == NULL)
+    {
+      z = __red_black_tree_insert_aux(tree, keys[j], values[j], copy_key, copy_value, data);
+      __red_black_tree_attach(tree, z, y, cmp);
+      inserted++;
+    }
+    // Rebalancing moves nodes around but keeps z in the tree, so it
+    // remains a valid starting point for the next, larger key.
+    finger = z;
+  }
+
+  free(order);
+  return inserted;
+}
+
+/* Takes the node z out of the tree, uncounting it. The node
+   itself and its entry are left alone.
+*/
+static void __red_black_tree_unlink(red_black_tree_t tree, tree_node_t z)
+{
+  if (tree->number_entries != RED_BLACK_TREE_UNCOUNTED)
+    tree->number_entries--;
+  __red_black_tree_detach(tree, z);
+}
+
+void red_black_tree_remove(red_black_tree_t tree,
+                           void *key,
+                           int (*compare_key)(void *, void *, void *),
+                           void (*delete_key)(void *, void *),
+                           void (*delete_value)(void *, void *),
+                           void *data)
+{
+  tree_node_t z = __red_black_tree_search_aux(tree->root, key, __order(compare_key, data));
+  if (z == NULL)
+    return;
+
+  __red_black_tree_unlink(tree, z);
+  __red_black_tree_release_entry(tree, z, delete_key, delete_value, data);
+  __red_black_tree_node_free(tree, z);
+}
+
+/* Joins the trees rooted at l and r, of black heights lh resp. rh,
+   whose keys are all smaller resp. greater than the key of the
+   detached node k, returns the new root and sets *height to its
+   black height. The black heights count the root, whatever its
+   color, and an empty tree has black height zero. k goes down the
+   spine of the taller tree to the first black node as high in black
+   nodes as the shorter tree, takes that subtree and the shorter tree
+   as children, and is colored red; the insert fix-up then takes care
+   of a red parent. Runs in O(|lh - rh| + 1), also when updating
+   subtree sizes, which only change on the spine walked down.
+*/
+static tree_node_t __red_black_tree_join_aux(tree_node_t l,
+                                             size_t lh,
+                                             tree_node_t k,
+                                             tree_node_t r,
+                                             size_t rh,
+                                             int ranked,
+                                             size_t *height)
+{
+  struct __red_black_tree_struct_t scratch;
+  tree_node_t c, p, w;
+  size_t h;
+
+  // Blackening a red root keeps a tree valid and adds a black level.
+  if (l != NULL)
+  {
+    __red_black_tree_set_parent(l, NULL);
+    if (__red_black_tree_color(l) == RED_BLACK_TREE_COLOR_RED)
+      lh++;
+    __red_black_tree_set_color(l, RED_BLACK_TREE_COLOR_BLACK);
+  }
+  if (r != NULL)
+  {
+    __red_black_tree_set_parent(r, NULL);
+    if (__red_black_tree_color(r) == RED_BLACK_TREE_COLOR_RED)
+      rh++;
+    __red_black_tree_set_color(r, RED_BLACK_TREE_COLOR_BLACK);
+  }
+
+  if (lh == rh)
+  {
+    k->left = l;
+    k->right = r;
+    k->parent_color = (uintptr_t)RED_BLACK_TREE_COLOR_BLACK;
+    if (ranked)
+      *__red_black_tree_size_slot(k) = __red_black_tree_size(l) + __red_black_tree_size(r) + ((size_t)1);
+    if (l != NULL)
+      __red_black_tree_set_parent(l, k);
+    if (r != NULL)
+      __red_black_tree_set_parent(r, k);
+    *height = lh + ((size_t)1);
+    return k;
+  }
+
+  // Only the root pointer and the ranked flag of the scratch tree
+  // are used by the rotations of the fix-up.
+  scratch.ranked = ranked;
+  p = NULL;
+  if (lh > rh)
+  {
+    scratch.root = l;
+    for (c = l, h = lh;
+         (c != NULL) && ((__red_black_tree_color(c) == RED_BLACK_TREE_COLOR_RED) || (h > rh));
+         c = c->right)
+    {
+      if (__red_black_tree_color(c) == RED_BLACK_TREE_COLOR_BLACK)
+        h--;
+      p = c;
+    }
+    k->left = c;
+    k->right = r;
+    p->right = k;
+  }
+  else
+  {
+    scratch.root = r;
+    for (c = r, h = rh;
+         (c != NULL) && ((__red_black_tree_color(c) == RED_BLACK_TREE_COLOR_RED) || (h > lh));
+         c = c->left)
+    {
+      if (__red_black_tree_color(c) == RED_BLACK_TREE_COLOR_BLACK)
+        h--;
+      p = c;
+    }
+    k->left = l;
+    k->right = c;
+    p->left = k;
+  }
+
+  k->parent_color = ((uintptr_t)p) | ((uintptr_t)RED_BLACK_TREE_COLOR_RED);
+  if (k->left != NULL)
+    __red_black_tree_set_parent(k->left, k);
+  if (k->right != NULL)
+    __red_black_tree_set_parent(k->right, k);
+  if (ranked)
+  {
+    __red_black_tree_update_size(k);
+    for (w = p; w != NULL; w = __red_black_tree_parent(w))
+      __red_black_tree_update_size(w);
+  }
+
+  *height = (lh > rh) ? lh : rh;
+  if (__red_black_tree_insert_fix(&scratch, k))
+    (*height)++;
+  return scratch.root;
+}
+
+/* Splits the subtree rooted at node, of black height h, into the
+   keys less than key and the others, setting *lh and *rh to the
+   black heights of both parts. Going back up, each node on the
+   search path is joined with its subtree on the far side of the cut
+   to the part built so far. Both children of a node have its black
+   height less its own black level, so no height is ever recomputed,
+   and as the parts grow along the path the joins cost O(log n) in
+   total.
+
+   If match is not NULL, the node holding key, if any, is kept out
+   of both parts and returned in *match instead.
+*/
+static void __red_black_tree_split_aux(tree_node_t *left,
+                                       size_t *lh,
+                                       tree_node_t *match,
+                                       tree_node_t *right,
+                                       size_t *rh,
+                                       tree_node_t node,
+                                       size_t h,
+                                       void *key,
+                                       int ranked,
+                                       int (*compare_key)(void *, void *, void *),
+                                       void *data)
+{
+  tree_node_t part;
+  size_t ph;
+  int cmp;
+
+  if (node == NULL)
+  {
+    *left = NULL;
+    *right = NULL;
+    *lh = (size_t)0;
+    *rh = (size_t)0;
+    return;
   }
-  y->parent = x->parent;
-  if (x->parent == NULL)
+
+  if (__red_black_tree_color(node) == RED_BLACK_TREE_COLOR_BLACK)
+    h--;
+  cmp = compare_key(key, node->key, data);
+  if ((cmp == 0) && (match != NULL))
   {
-    tree->root = y;
+    *match = node;
+    *left = node->left;
+    *right = node->right;
+    *lh = h;
+    *rh = h;
   }
-  else if (x == x->parent->left)
+  else if (cmp <= 0)
   {
-    x->parent->left = y;
+    __red_black_tree_split_aux(left, lh, match, &part, &ph, node->left, h, key, ranked, compare_key, data);
+    *right = __red_black_tree_join_aux(part, ph, node, node->right, h, ranked, rh);
   }
   else
   {
-    x->parent->right = y;
+    __red_black_tree_split_aux(&part, &ph, match, right, rh, node->right, h, key, ranked, compare_key, data);
+    *left = __red_black_tree_join_aux(node->left, h, node, part, ph, ranked, lh);
   }
-  y->left = x;
-  x->parent = y;
 }
 
-static void right_rotate(red_black_tree_t tree, tree_node_t y)
+void red_black_tree_split(red_black_tree_t *left,
+                          red_black_tree_t *right,
+                          red_black_tree_t tree,
+                          void *key,
+                          int (*compare_key)(void *, void *, void *),
+                          void *data)
 {
-  tree_node_t x = y->left;
-  y->left = x->right;
-  if (x->right != NULL)
+  red_black_tree_t other;
+  tree_node_t l, r;
+  size_t n, lh, rh;
+
+  // Both halves keep taking nodes from the same arena.
+  other = red_black_tree_create();
+  other->arena = __red_black_tree_arena(tree);
+  if (other->arena != NULL)
+    other->arena->references++;
+  other->ranked = tree->ranked;
+  other->inline_entries = tree->inline_entries;
+  other->key_size = tree->key_size;
+  other->value_size = tree->value_size;
+
+  __red_black_tree_split_aux(&l, &lh, NULL, &r, &rh, tree->root, __red_black_tree_black_height_aux(tree->root),
+                             key, tree->ranked, compare_key, data);
+  tree->root = l;
+  other->root = r;
+  if (tree->ranked)
   {
-    x->right->parent = y;
+    tree->number_entries = __red_black_tree_size(l);
+    other->number_entries = __red_black_tree_size(r);
   }
-  x->parent = y->parent;
-  if (y->parent == NULL)
+  else
+  {
+    // Counted on demand rather than walking either half now.
+    n = tree->number_entries;
+    tree->number_entries = (r == NULL) ? n : (l == NULL) ? ((size_t)0) : RED_BLACK_TREE_UNCOUNTED;
+    other->number_entries = (l == NULL) ? n : (r == NULL) ? ((size_t)0) : RED_BLACK_TREE_UNCOUNTED;
+  }
+
+  *left = tree;
+  *right = other;
+}
+
+/* Moves the subtree rooted at node from the allocator of other to
+   the one of tree, copying each node together with its inline entry
+   into the layout of tree, and computing the subtree sizes if tree
+   keeps them.
+*/
+static tree_node_t __red_black_tree_relocate(red_black_tree_t tree,
+                                             red_black_tree_t other,
+                                             tree_node_t node,
+                                             tree_node_t parent)
+{
+  tree_node_t copy;
+
+  if (node == NULL)
+    return NULL;
+
+  copy = __red_black_tree_node_alloc(tree);
+  copy->key = node->key;
+  copy->value = node->value;
+  copy->parent_color = node->parent_color;
+  if (tree->inline_entries)
   {
-    tree->root = x;
+    __red_black_tree_inline_entry(tree, copy);
+    memcpy(copy->key, node->key, tree->key_size);
+    memcpy(copy->value, node->value, tree->value_size);
   }
-  else if (y == y->parent->right)
+  __red_black_tree_set_parent(copy, parent);
+  copy->left = __red_black_tree_relocate(tree, other, node->left, copy);
+  copy->right = __red_black_tree_relocate(tree, other, node->right, copy);
+  if (tree->ranked)
+    __red_black_tree_update_size(copy);
+  __red_black_tree_node_free(other, node);
+  return copy;
+}
+
+/* Hands the nodes of other over to the allocator of tree and drops
+   the allocator of other. Trees sharing an arena need nothing done,
+   and two arenas of equal node size are merged in constant time,
+   whichever other trees still use them. Only nodes moving between a
+   tree with an arena and one without are copied one by one.
+*/
+static void __red_black_tree_adopt(red_black_tree_t tree, red_black_tree_t other)
+{
+  node_arena_t arena, from;
+
+  arena = __red_black_tree_arena(tree);
+  from = __red_black_tree_arena(other);
+  if ((arena != from) && ((arena == NULL) || (from == NULL) || (arena->node_size != from->node_size)))
+    other->root = __red_black_tree_relocate(tree, other, other->root, NULL);
+  else if (arena != from)
+    __node_arena_merge(arena, from);
+
+  other->arena = NULL;
+  if (from != NULL)
+    __node_arena_release(from);
+}
+
+void red_black_tree_join(red_black_tree_t left,
+                         void *key,
+                         void *value,
+                         red_black_tree_t right,
+                         void *(*copy_key)(void *, void *),
+                         void *(*copy_value)(void *, void *),
+                         void *data)
+{
+  tree_node_t pivot;
+  size_t n, h;
+
+  red_black_tree_set_ranked(right, left->ranked);
+  __red_black_tree_adopt(left, right);
+
+  n = right->number_entries;
+  if ((left->number_entries == RED_BLACK_TREE_UNCOUNTED) || (n == RED_BLACK_TREE_UNCOUNTED))
+    n = RED_BLACK_TREE_UNCOUNTED;
+  else
+    n += left->number_entries;
+
+  if (key != NULL)
   {
-    y->parent->right = x;
+    pivot = __red_black_tree_node_alloc(left);
+    __red_black_tree_store_entry(left, pivot, key, value, copy_key, copy_value, data);
+    if (n != RED_BLACK_TREE_UNCOUNTED)
+      n++;
   }
   else
   {
-    y->parent->left = x;
+    // Without a pivot, the smallest node of right serves as one.
+    pivot = __red_black_tree_first(right->root);
+    if (pivot != NULL)
+      __red_black_tree_unlink(right, pivot);
   }
-  x->right = y;
-  y->parent = x;
+
+  if (pivot != NULL)
+    left->root = __red_black_tree_join_aux(left->root, __red_black_tree_black_height_aux(left->root), pivot,
+                                           right->root, __red_black_tree_black_height_aux(right->root),
+                                           left->ranked, &h);
+  left->number_entries = n;
+  free(right);
+}
+
+/* A pool of worker threads for the set operations. Pending tasks
+   sit on a stack; a thread waiting for a task it handed out runs
+   pending tasks meanwhile instead of blocking a worker.
+*/
+typedef struct __red_black_tree_task_struct_t *red_black_tree_task_t;
+
+struct __red_black_tree_pool_struct_t
+{
+  pthread_t *threads;
+  size_t number_threads;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  red_black_tree_task_t pending;
+  int stopping;
+};
+
+typedef enum
+{
+  RED_BLACK_TREE_UNION = 0,
+  RED_BLACK_TREE_INTERSECTION = 1,
+  RED_BLACK_TREE_DIFFERENCE = 2
+} set_operation_t;
+
+/* Everything a set operation passes down unchanged. */
+typedef struct
+{
+  set_operation_t operation;
+  int (*compare_key)(void *, void *, void *);
+  void (*merge_value)(void *, void *, void *, void *);
+  int ranked;
+  red_black_tree_pool_t pool;
+  void *data;
+} __red_black_tree_set_context_t;
+
+/* Subtrees a set operation drops, chained through the parent word
+   of their roots so that no allocation is needed. They are released
+   by the calling thread once the operation is over.
+*/
+typedef struct
+{
+  tree_node_t head;
+  tree_node_t tail;
+} __red_black_tree_drops_t;
+
+struct __red_black_tree_task_struct_t
+{
+  red_black_tree_task_t next;
+  __red_black_tree_set_context_t *context;
+  tree_node_t t1;
+  size_t h1;
+  tree_node_t t2;
+  size_t h2;
+  int parallel;
+  tree_node_t result;
+  size_t height;
+  __red_black_tree_drops_t drops;
+  int done;
+};
+
+static void __red_black_tree_drop(__red_black_tree_drops_t *drops, tree_node_t node)
+{
+  if (node == NULL)
+    return;
+  node->parent_color = (uintptr_t)0;
+  if (drops->tail == NULL)
+    drops->head = node;
+  else
+    drops->tail->parent_color = (uintptr_t)node;
+  drops->tail = node;
+}
+
+static void __red_black_tree_drop_all(__red_black_tree_drops_t *drops, __red_black_tree_drops_t *more)
+{
+  if (more->head == NULL)
+    return;
+  if (drops->tail == NULL)
+    drops->head = more->head;
+  else
+    drops->tail->parent_color = (uintptr_t)more->head;
+  drops->tail = more->tail;
+}
+
+/* Releases the subtree rooted at node, returning the number of
+   entries released.
+*/
+static size_t __red_black_tree_release_subtree(red_black_tree_t tree,
+                                               tree_node_t node,
+                                               void (*delete_key)(void *, void *),
+                                               void (*delete_value)(void *, void *),
+                                               void *data)
+{
+  size_t n;
+
+  if (node == NULL)
+    return (size_t)0;
+  n = __red_black_tree_release_subtree(tree, node->left, delete_key, delete_value, data);
+  n += __red_black_tree_release_subtree(tree, node->right, delete_key, delete_value, data);
+  __red_black_tree_release_entry(tree, node, delete_key, delete_value, data);
+  __red_black_tree_node_free(tree, node);
+  return n + ((size_t)1);
 }
 
-static void __red_black_tree_transplant(red_black_tree_t tree, tree_node_t u, tree_node_t v)
+/* Takes the minimum node out of the subtree rooted at node, of black
+   height h, into *first and returns the rest, setting *height to its
+   black height. Going back up the left spine, each node is joined
+   with its right subtree to the rest built so far, which costs
+   O(log n) in total as in __red_black_tree_split_aux.
+*/
+static tree_node_t __red_black_tree_split_first_aux(tree_node_t *first,
+                                                    tree_node_t node,
+                                                    size_t h,
+                                                    int ranked,
+                                                    size_t *height)
 {
-  if (u->parent == NULL)
+  tree_node_t rest;
+  size_t rh;
+
+  if (__red_black_tree_color(node) == RED_BLACK_TREE_COLOR_BLACK)
+    h--;
+  if (node->left == NULL)
   {
-    // If u is the root node, update the root of the tree.
-    tree->root = v;
+    *first = node;
+    *height = h;
+    return node->right;
   }
-  else if (u == u->parent->left)
+  rest = __red_black_tree_split_first_aux(first, node->left, h, ranked, &rh);
+  return __red_black_tree_join_aux(rest, rh, node, node->right, h, ranked, height);
+}
+
+/* Joins two trees of black heights lh and rh without a pivot,
+   borrowing the minimum of r, and sets *height to the black height
+   of the result.
+*/
+static tree_node_t __red_black_tree_join2_aux(tree_node_t l,
+                                              size_t lh,
+                                              tree_node_t r,
+                                              size_t rh,
+                                              int ranked,
+                                              size_t *height)
+{
+  tree_node_t pivot, rest;
+
+  if (r == NULL)
   {
-    // If u is a left child, replace u with v as the left child of u's parent.
-    u->parent->left = v;
+    *height = lh;
+    return l;
   }
-  else
+  if (l == NULL)
   {
-    // If u is a right child, replace u with v as the right child of u's parent.
-    u->parent->right = v;
+    *height = rh;
+    return r;
   }
 
-  if (v != NULL)
+  rest = __red_black_tree_split_first_aux(&pivot, r, rh, ranked, &rh);
+  return __red_black_tree_join_aux(l, lh, pivot, rest, rh, ranked, height);
+}
+
+static void __red_black_tree_task_run(red_black_tree_task_t task);
+
+static void *__red_black_tree_pool_worker(void *arg)
+{
+  red_black_tree_pool_t pool;
+  red_black_tree_task_t task;
+
+  pool = arg;
+  pthread_mutex_lock(&pool->lock);
+  while (1)
   {
-    // Update the parent of v if v is not NULL.
-    v->parent = u->parent;
+    while ((pool->pending == NULL) && !pool->stopping)
+      pthread_cond_wait(&pool->changed, &pool->lock);
+    if (pool->pending == NULL)
+      break;
+    task = pool->pending;
+    pool->pending = task->next;
+    pthread_mutex_unlock(&pool->lock);
+    __red_black_tree_task_run(task);
+    pthread_mutex_lock(&pool->lock);
+    task->done = 1;
+    pthread_cond_broadcast(&pool->changed);
   }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
 }
 
-static void __red_black_tree_remove_fix(red_black_tree_t tree, tree_node_t x, tree_node_t x_parent)
+red_black_tree_pool_t red_black_tree_pool_create(size_t number_threads)
 {
-  tree_node_t sibling;
+  red_black_tree_pool_t pool;
+  size_t i;
 
-  while (x != tree->root && (x == NULL || x->color == RED_BLACK_TREE_COLOR_BLACK))
+  pool = calloc(1, sizeof(*pool));
+  if (pool == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  pool->threads = calloc(number_threads + ((size_t)1), sizeof(pthread_t));
+  if (pool->threads == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  pool->number_threads = number_threads;
+  pool->pending = NULL;
+  pool->stopping = 0;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->changed, NULL);
+  for (i = (size_t)0; i < number_threads; i++)
   {
-    if (x == x_parent->left)
+    if (pthread_create(&pool->threads[i], NULL, __red_black_tree_pool_worker, pool) != 0)
     {
-      sibling = x_parent->right;
+      fprintf(stderr, "Error: cannot start a thread.\n");
+      exit(1);
+    }
+  }
+  return pool;
+}
 
-      if (sibling->color == RED_BLACK_TREE_COLOR_RED)
-      {
-        // Case 1: x's sibling is red.
-        sibling->color = RED_BLACK_TREE_COLOR_BLACK;
-        x_parent->color = RED_BLACK_TREE_COLOR_RED;
-        left_rotate(tree, x_parent);
-        sibling = x_parent->right;
-      }
+void red_black_tree_pool_delete(red_black_tree_pool_t pool)
+{
+  size_t i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_broadcast(&pool->changed);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = (size_t)0; i < pool->number_threads; i++)
+    pthread_join(pool->threads[i], NULL);
+  pthread_cond_destroy(&pool->changed);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
 
-      if ((sibling->left == NULL || sibling->left->color == RED_BLACK_TREE_COLOR_BLACK) &&
-          (sibling->right == NULL || sibling->right->color == RED_BLACK_TREE_COLOR_BLACK))
-      {
-        // Case 2: x's sibling is black, and both of sibling's children are black.
-        sibling->color = RED_BLACK_TREE_COLOR_RED;
-        x = x_parent;
-        x_parent = x->parent;
-      }
-      else
-      {
-        if (sibling->right == NULL || sibling->right->color == RED_BLACK_TREE_COLOR_BLACK)
-        {
-          // Case 3: x's sibling is black, sibling's left child is red, and right child is black.
-          sibling->left->color = RED_BLACK_TREE_COLOR_BLACK;
-          sibling->color = RED_BLACK_TREE_COLOR_RED;
-          right_rotate(tree, sibling);
-          sibling = x_parent->right;
-        }
+/* Waits for a task handed to the pool, running pending tasks in the
+   meantime, possibly the awaited one itself.
+*/
+static void __red_black_tree_pool_wait(red_black_tree_pool_t pool, red_black_tree_task_t task)
+{
+  red_black_tree_task_t other;
 
-        // Case 4: x's sibling is black, sibling's right child is red.
-        sibling->color = x_parent->color;
-        x_parent->color = RED_BLACK_TREE_COLOR_BLACK;
-        sibling->right->color = RED_BLACK_TREE_COLOR_BLACK;
-        left_rotate(tree, x_parent);
-        x = tree->root;
-      }
-    }
-    else
+  pthread_mutex_lock(&pool->lock);
+  while (!task->done)
+  {
+    if (pool->pending == NULL)
     {
-      sibling = x_parent->left;
-
-      if (sibling->color == RED_BLACK_TREE_COLOR_RED)
-      {
-        // Case 1: x's sibling is red.
-        sibling->color = RED_BLACK_TREE_COLOR_BLACK;
-        x_parent->color = RED_BLACK_TREE_COLOR_RED;
-        right_rotate(tree, x_parent);
-        sibling = x_parent->left;
-      }
+      pthread_cond_wait(&pool->changed, &pool->lock);
+      continue;
+    }
+    other = pool->pending;
+    pool->pending = other->next;
+    pthread_mutex_unlock(&pool->lock);
+    __red_black_tree_task_run(other);
+    pthread_mutex_lock(&pool->lock);
+    other->done = 1;
+    pthread_cond_broadcast(&pool->changed);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
 
-      if ((sibling->right == NULL || sibling->right->color == RED_BLACK_TREE_COLOR_BLACK) &&
-          (sibling->left == NULL || sibling->left->color == RED_BLACK_TREE_COLOR_BLACK))
-      {
-        // Case 2: x's sibling is black, and both of sibling's children are black.
-        sibling->color = RED_BLACK_TREE_COLOR_RED;
-        x = x_parent;
-        x_parent = x->parent;
-      }
-      else
-      {
-        if (sibling->left == NULL || sibling->left->color == RED_BLACK_TREE_COLOR_BLACK)
-        {
-          // Case 3: x's sibling is black, sibling's right child is red, and left child is black.
-          sibling->right->color = RED_BLACK_TREE_COLOR_BLACK;
-          sibling->color = RED_BLACK_TREE_COLOR_RED;
-          left_rotate(tree, sibling);
-          sibling = x_parent->left;
-        }
+/* Combines the trees rooted at t1 and t2, of black heights h1 resp.
+   h2, following Blelloch, Ferizovic and Sun, "Just Join for Parallel
+   Ordered Sets": t2 is split at the key of the root of t1, the two
+   sides are combined recursively, and the results are joined back
+   around the root of t1 if the operation keeps its key. Returns the
+   combined tree and sets *height to its black height. The black
+   heights of all parts come out of the splits and joins, so this
+   takes O(m log(n/m + 1)) work for trees of m and n >= m entries.
+   Both recursive calls touch disjoint nodes, so while either tree
+   has a black height of RED_BLACK_TREE_SET_GRAIN_HEIGHT or more and
+   parallel is set, one of them goes to the pool.
+*/
+static tree_node_t __red_black_tree_set_aux(__red_black_tree_set_context_t *context,
+                                            __red_black_tree_drops_t *drops,
+                                            tree_node_t t1,
+                                            size_t h1,
+                                            tree_node_t t2,
+                                            size_t h2,
+                                            int parallel,
+                                            size_t *height)
+{
+  struct __red_black_tree_task_struct_t task;
+  tree_node_t l1, r1, l2, r2, match, l, r;
+  red_black_tree_pool_t pool;
+  size_t ch, lh2, rh2, lh, rh;
 
-        // Case 4: x's sibling is black, sibling's left child is red.
-        sibling->color = x_parent->color;
-        x_parent->color = RED_BLACK_TREE_COLOR_BLACK;
-        sibling->left->color = RED_BLACK_TREE_COLOR_BLACK;
-        right_rotate(tree, x_parent);
-        x = tree->root;
-      }
+  if ((t1 == NULL) || (t2 == NULL))
+  {
+    if (context->operation == RED_BLACK_TREE_UNION)
+    {
+      *height = (t1 == NULL) ? h2 : h1;
+      return (t1 == NULL) ? t2 : t1;
+    }
+    if (context->operation == RED_BLACK_TREE_DIFFERENCE)
+    {
+      __red_black_tree_drop(drops, t2);
+      *height = h1;
+      return t1;
     }
+    __red_black_tree_drop(drops, t1);
+    __red_black_tree_drop(drops, t2);
+    *height = (size_t)0;
+    return NULL;
+  }
+
+  l1 = t1->left;
+  r1 = t1->right;
+  ch = (__red_black_tree_color(t1) == RED_BLACK_TREE_COLOR_BLACK) ? h1 - ((size_t)1) : h1;
+  match = NULL;
+  __red_black_tree_split_aux(&l2, &lh2, &match, &r2, &rh2, t2, h2, t1->key,
+                             context->ranked, context->compare_key, context->data);
+
+  // Once both trees are small, their parts only get smaller.
+  pool = context->pool;
+  if (parallel)
+  {
+    parallel = (h1 >= RED_BLACK_TREE_SET_GRAIN_HEIGHT) ||
+               (lh2 >= RED_BLACK_TREE_SET_GRAIN_HEIGHT) ||
+               (rh2 >= RED_BLACK_TREE_SET_GRAIN_HEIGHT);
+  }
+  if (parallel)
+  {
+    task.context = context;
+    task.t1 = r1;
+    task.h1 = ch;
+    task.t2 = r2;
+    task.h2 = rh2;
+    task.parallel = parallel;
+    task.drops.head = NULL;
+    task.drops.tail = NULL;
+    task.done = 0;
+    pthread_mutex_lock(&pool->lock);
+    task.next = pool->pending;
+    pool->pending = &task;
+    pthread_cond_signal(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+
+    l = __red_black_tree_set_aux(context, drops, l1, ch, l2, lh2, parallel, &lh);
+    __red_black_tree_pool_wait(pool, &task);
+    r = task.result;
+    rh = task.height;
+    __red_black_tree_drop_all(drops, &task.drops);
+  }
+  else
+  {
+    l = __red_black_tree_set_aux(context, drops, l1, ch, l2, lh2, parallel, &lh);
+    r = __red_black_tree_set_aux(context, drops, r1, ch, r2, rh2, parallel, &rh);
   }
 
-  if (x != NULL)
-    x->color = RED_BLACK_TREE_COLOR_BLACK;
+  if (match != NULL)
+  {
+    if ((context->operation != RED_BLACK_TREE_DIFFERENCE) && (context->merge_value != NULL))
+      context->merge_value(t1->key, t1->value, match->value, context->data);
+    match->left = NULL;
+    match->right = NULL;
+    __red_black_tree_drop(drops, match);
+  }
+  if ((context->operation == RED_BLACK_TREE_UNION) ||
+      ((context->operation == RED_BLACK_TREE_INTERSECTION) == (match != NULL)))
+    return __red_black_tree_join_aux(l, lh, t1, r, rh, context->ranked, height);
+
+  t1->left = NULL;
+  t1->right = NULL;
+  __red_black_tree_drop(drops, t1);
+  return __red_black_tree_join2_aux(l, lh, r, rh, context->ranked, height);
 }
 
-tree_node_t __red_black_tree_minimum(tree_node_t node)
+static void __red_black_tree_task_run(red_black_tree_task_t task)
 {
-  if (node == NULL)
-    return NULL;
+  task->result = __red_black_tree_set_aux(task->context, &task->drops, task->t1, task->h1, task->t2, task->h2,
+                                          task->parallel, &task->height);
+}
 
-  while (node->left != NULL)
+static void __red_black_tree_set_operation(red_black_tree_t tree,
+                                           red_black_tree_t other,
+                                           set_operation_t operation,
+                                           int (*compare_key)(void *, void *, void *),
+                                           void (*merge_value)(void *, void *, void *, void *),
+                                           void (*delete_key)(void *, void *),
+                                           void (*delete_value)(void *, void *),
+                                           red_black_tree_pool_t pool,
+                                           void *data)
+{
+  __red_black_tree_set_context_t context;
+  __red_black_tree_drops_t drops;
+  tree_node_t node, next;
+  size_t n, released, h;
+
+  // Dropped nodes of both trees then go back to the same allocator,
+  // which merging the arenas arranges in constant time.
+  red_black_tree_set_ranked(other, tree->ranked);
+  __red_black_tree_adopt(tree, other);
+
+  // Every entry of either tree ends up in the result or is dropped.
+  n = other->number_entries;
+  if ((tree->number_entries == RED_BLACK_TREE_UNCOUNTED) || (n == RED_BLACK_TREE_UNCOUNTED))
+    n = RED_BLACK_TREE_UNCOUNTED;
+  else
+    n += tree->number_entries;
+
+  context.operation = operation;
+  context.compare_key = compare_key;
+  context.merge_value = merge_value;
+  context.ranked = tree->ranked;
+  context.pool = pool;
+  context.data = data;
+  drops.head = NULL;
+  drops.tail = NULL;
+  tree->root = __red_black_tree_set_aux(&context, &drops,
+                                        tree->root, __red_black_tree_black_height_aux(tree->root),
+                                        other->root, __red_black_tree_black_height_aux(other->root),
+                                        (pool != NULL) && (pool->number_threads > ((size_t)0)), &h);
+  if (tree->root != NULL)
+    tree->root->parent_color = (uintptr_t)RED_BLACK_TREE_COLOR_BLACK;
+  free(other);
+
+  released = (size_t)0;
+  for (node = drops.head; node != NULL; node = next)
   {
-    node = node->left;
+    next = (tree_node_t)node->parent_color;
+    released += __red_black_tree_release_subtree(tree, node, delete_key, delete_value, data);
   }
+  tree->number_entries = (tree->root == NULL) ? ((size_t)0) :
+                         (n == RED_BLACK_TREE_UNCOUNTED) ? n : n - released;
+}
 
-  return node;
+void red_black_tree_union(red_black_tree_t tree,
+                          red_black_tree_t other,
+                          int (*compare_key)(void *, void *, void *),
+                          void (*merge_value)(void *, void *, void *, void *),
+                          void (*delete_key)(void *, void *),
+                          void (*delete_value)(void *, void *),
+                          red_black_tree_pool_t pool,
+                          void *data)
+{
+  __red_black_tree_set_operation(tree, other, RED_BLACK_TREE_UNION, compare_key, merge_value,
+                                 delete_key, delete_value, pool, data);
 }
 
-void red_black_tree_remove(red_black_tree_t tree,
-                           void *key,
-                           int (*compare_key)(void *, void *, void *),
-                           void (*delete_key)(void *, void *),
-                           void (*delete_value)(void *, void *),
-                           void *data)
+void red_black_tree_intersection(red_black_tree_t tree,
+                                 red_black_tree_t other,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void (*merge_value)(void *, void *, void *, void *),
+                                 void (*delete_key)(void *, void *),
+                                 void (*delete_value)(void *, void *),
+                                 red_black_tree_pool_t pool,
+                                 void *data)
 {
-  tree_node_t z = __red_black_tree_search_aux(tree->root, key, compare_key, data);
-  if (z == NULL)
-    return;
+  __red_black_tree_set_operation(tree, other, RED_BLACK_TREE_INTERSECTION, compare_key, merge_value,
+                                 delete_key, delete_value, pool, data);
+}
 
-  tree_node_t y = z;
-  tree_node_t x;
-  color_t y_original_color = y->color;
+void red_black_tree_difference(red_black_tree_t tree,
+                               red_black_tree_t other,
+                               int (*compare_key)(void *, void *, void *),
+                               void (*delete_key)(void *, void *),
+                               void (*delete_value)(void *, void *),
+                               red_black_tree_pool_t pool,
+                               void *data)
+{
+  __red_black_tree_set_operation(tree, other, RED_BLACK_TREE_DIFFERENCE, compare_key, NULL,
+                                 delete_key, delete_value, pool, data);
+}
+
+/* A frozen snapshot stores entry i of the implicit complete binary
+   tree at index i of its arrays, counting from one: the children of
+   i are 2i and 2i+1. Index 0 is unused and doubles as "no entry".
+*/
+struct __red_black_tree_frozen_struct_t
+{
+  size_t number_entries;
+  void **keys;
+  void **values;
+  long long *integer_keys;
+  void *integer_keys_block;
+  long long (*integer_key)(void *, void *);
+  void *data;
+};
 
-  if (z->left == NULL)
+#define RED_BLACK_TREE_CACHE_LINE ((size_t)64)
+
+/* In-order neighbours of an index in a snapshot of n entries.
+   Climbing out of a left resp. right spine amounts to dropping the
+   trailing zeros resp. ones of the index and one more bit.
+*/
+static size_t __frozen_next(size_t k, size_t n)
+{
+  if (2 * k + 1 <= n)
   {
-    x = z->right;
-    __red_black_tree_transplant(tree, z, z->right);
+    for (k = 2 * k + 1; 2 * k <= n; k = 2 * k)
+      ;
+    return k;
   }
-  else if (z->right == NULL)
+  while (k & ((size_t)1))
+    k >>= 1;
+  return k >> 1;
+}
+
+static size_t __frozen_prev(size_t k, size_t n)
+{
+  if (2 * k <= n)
   {
-    x = z->left;
-    __red_black_tree_transplant(tree, z, z->left);
+    for (k = 2 * k; 2 * k + 1 <= n; k = 2 * k + 1)
+      ;
+    return k;
   }
-  else
+  while ((k != 0) && !(k & ((size_t)1)))
+    k >>= 1;
+  return k >> 1;
+}
+
+static size_t __frozen_first(size_t n)
+{
+  size_t k;
+  if (n == 0)
+    return 0;
+  for (k = 1; 2 * k <= n; k = 2 * k)
+    ;
+  return k;
+}
+
+static size_t __frozen_last(size_t n)
+{
+  size_t k;
+  if (n == 0)
+    return 0;
+  for (k = 1; 2 * k + 1 <= n; k = 2 * k + 1)
+    ;
+  return k;
+}
+
+red_black_tree_frozen_t red_black_tree_freeze(red_black_tree_t tree,
+                                              void *(*copy_key)(void *, void *),
+                                              void *(*copy_value)(void *, void *),
+                                              long long (*integer_key)(void *, void *),
+                                              void *data)
+{
+  red_black_tree_frozen_t frozen;
+  tree_node_t node;
+  size_t n, k;
+  uintptr_t aligned;
+
+  frozen = (red_black_tree_frozen_t)calloc(1, sizeof(*frozen));
+  n = __red_black_tree_count(tree);
+  if (frozen != NULL)
+  {
+    frozen->keys = (void **)calloc(n + 1, sizeof(void *));
+    frozen->values = (void **)calloc(n + 1, sizeof(void *));
+  }
+  if ((frozen == NULL) || (frozen->keys == NULL) || (frozen->values == NULL))
   {
-    // Find the minimum node in the right subtree.
-    y = __red_black_tree_minimum(z->right);
-    y_original_color = y->color;
-    x = y->right;
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  frozen->number_entries = n;
+  frozen->integer_key = integer_key;
+  frozen->data = data;
 
-    if (y->parent != z)
+  if (integer_key != NULL)
+  {
+    // Align the array so that the eight grandchildren of the
+    // grandchildren of index k, at 8k .. 8k+7, share a cache line.
+    frozen->integer_keys_block = malloc((n + 1) * sizeof(long long) + RED_BLACK_TREE_CACHE_LINE);
+    if (frozen->integer_keys_block == NULL)
     {
-      // Transplant y with its right child.
-      __red_black_tree_transplant(tree, y, y->right);
-      y->right = z->right;
-      y->right->parent = y;
+      fprintf(stderr, "Error: no memory left.\n");
+      exit(1);
     }
+    aligned = (uintptr_t)frozen->integer_keys_block;
+    aligned = (aligned + RED_BLACK_TREE_CACHE_LINE - 1) & ~((uintptr_t)(RED_BLACK_TREE_CACHE_LINE - 1));
+    frozen->integer_keys = (long long *)aligned;
+  }
 
-    // Transplant z with y.
-    __red_black_tree_transplant(tree, z, y);
-    y->left = z->left;
-    y->left->parent = y;
-    y->color = z->color;
+  // Walk the tree and the implicit tree in order side by side.
+  k = __frozen_first(n);
+  for (node = __red_black_tree_first(tree->root); node != NULL; node = __red_black_tree_next(node))
+  {
+    frozen->keys[k] = (copy_key == NULL) ? node->key : copy_key(node->key, data);
+    frozen->values[k] = (copy_value == NULL) ? node->value : copy_value(node->value, data);
+    if (integer_key != NULL)
+      frozen->integer_keys[k] = integer_key(node->key, data);
+    k = __frozen_next(k, n);
+  }
+  return frozen;
+}
+
+void red_black_tree_frozen_delete(red_black_tree_frozen_t frozen,
+                                  void (*delete_key)(void *, void *),
+                                  void (*delete_value)(void *, void *),
+                                  void *data)
+{
+  size_t k;
+
+  for (k = 1; k <= frozen->number_entries; k++)
+  {
+    if (delete_key != NULL)
+      delete_key(frozen->keys[k], data);
+    if (delete_value != NULL)
+      delete_value(frozen->values[k], data);
+  }
+  free(frozen->keys);
+  free(frozen->values);
+  free(frozen->integer_keys_block);
+  free(frozen);
+}
+
+size_t red_black_tree_frozen_number_entries(red_black_tree_frozen_t frozen)
+{
+  return frozen->number_entries;
+}
+
+/* Returns the index of the first entry whose key is greater than or
+   equal to key (inclusive) resp. strictly greater (otherwise), or 0.
+
+   The descent always runs down to the bottom, turning the outcome of
+   each comparison into the next index instead of a branch. The last
+   turn to the left is then recovered from the index alone.
+*/
+static size_t __frozen_first_after(red_black_tree_frozen_t frozen,
+                                   void *key,
+                                   int inclusive,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *data)
+{
+  size_t n = frozen->number_entries;
+  size_t k = 1;
+  long long x;
+  const long long *a;
+  int c;
+
+  if (frozen->integer_keys != NULL)
+  {
+    x = frozen->integer_key(key, frozen->data);
+    a = frozen->integer_keys;
+    if (inclusive)
+    {
+      while (k <= n)
+      {
+        __prefetch(a + 8 * k);
+        k = 2 * k + (size_t)(a[k] < x);
+      }
+    }
+    else
+    {
+      while (k <= n)
+      {
+        __prefetch(a + 8 * k);
+        k = 2 * k + (size_t)(a[k] <= x);
+      }
+    }
+  }
+  else
+  {
+    while (k <= n)
+    {
+      c = compare_key(frozen->keys[k], key, data);
+      k = 2 * k + (size_t)(inclusive ? (c < 0) : (c <= 0));
+    }
   }
 
-  if (y_original_color == RED_BLACK_TREE_COLOR_BLACK)
-    __red_black_tree_remove_fix(tree, x, y->parent);
+  // Drop the trailing right turns and the last left turn.
+#if defined(__GNUC__)
+  return k >> (__builtin_ctzll(~((unsigned long long)k)) + 1);
+#else
+  while (k & ((size_t)1))
+    k >>= 1;
+  return k >> 1;
+#endif
+}
+
+/* Compares the key at index k of a snapshot to key. */
+static int __frozen_compare(red_black_tree_frozen_t frozen,
+                            size_t k,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data)
+{
+  long long x;
+
+  if (frozen->integer_keys == NULL)
+    return compare_key(frozen->keys[k], key, data);
+  x = frozen->integer_key(key, frozen->data);
+  return (frozen->integer_keys[k] > x) - (frozen->integer_keys[k] < x);
+}
+
+/* Compares two keys the way a snapshot orders them. */
+static int __frozen_compare_keys(red_black_tree_frozen_t frozen,
+                                 void *key1,
+                                 void *key2,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void *data)
+{
+  long long x1, x2;
+
+  if (frozen->integer_keys == NULL)
+    return compare_key(key1, key2, data);
+  x1 = frozen->integer_key(key1, frozen->data);
+  x2 = frozen->integer_key(key2, frozen->data);
+  return (x1 > x2) - (x1 < x2);
+}
+
+/* Returns the index of the entry with key key, or 0. */
+static size_t __frozen_find(red_black_tree_frozen_t frozen,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data)
+{
+  size_t k;
+
+  k = __frozen_first_after(frozen, key, 1, compare_key, data);
+  if ((k == 0) || (__frozen_compare(frozen, k, key, compare_key, data) != 0))
+    return 0;
+  return k;
+}
+
+static void __frozen_report(void **found_key,
+                            void **found_value,
+                            red_black_tree_frozen_t frozen,
+                            size_t k)
+{
+  // Index 0 holds NULL for both.
+  *found_key = frozen->keys[k];
+  *found_value = frozen->values[k];
+}
+
+void *red_black_tree_frozen_search(red_black_tree_frozen_t frozen,
+                                   void *key,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *data)
+{
+  return frozen->values[__frozen_find(frozen, key, compare_key, data)];
+}
+
+void red_black_tree_frozen_minimum(void **min_key,
+                                   void **min_value,
+                                   red_black_tree_frozen_t frozen)
+{
+  __frozen_report(min_key, min_value, frozen, __frozen_first(frozen->number_entries));
+}
+
+void red_black_tree_frozen_maximum(void **max_key,
+                                   void **max_value,
+                                   red_black_tree_frozen_t frozen)
+{
+  __frozen_report(max_key, max_value, frozen, __frozen_last(frozen->number_entries));
+}
+
+void red_black_tree_frozen_lower_bound(void **found_key,
+                                       void **found_value,
+                                       red_black_tree_frozen_t frozen,
+                                       void *key,
+                                       int (*compare_key)(void *, void *, void *),
+                                       void *data)
+{
+  __frozen_report(found_key, found_value, frozen,
+                  __frozen_first_after(frozen, key, 1, compare_key, data));
+}
 
-  delete_key(z->key, data);
-  delete_value(z->value, data);
-  free(z);
+void red_black_tree_frozen_predecessor(void **prec_key,
+                                       void **prec_value,
+                                       red_black_tree_frozen_t frozen,
+                                       void *key,
+                                       int (*compare_key)(void *, void *, void *),
+                                       void *data)
+{
+  size_t k;
+
+  k = __frozen_find(frozen, key, compare_key, data);
+  if (k != 0)
+    k = __frozen_prev(k, frozen->number_entries);
+  __frozen_report(prec_key, prec_value, frozen, k);
+}
+
+void red_black_tree_frozen_successor(void **succ_key,
+                                     void **succ_value,
+                                     red_black_tree_frozen_t frozen,
+                                     void *key,
+                                     int (*compare_key)(void *, void *, void *),
+                                     void *data)
+{
+  size_t k;
+
+  k = __frozen_find(frozen, key, compare_key, data);
+  if (k != 0)
+    k = __frozen_next(k, frozen->number_entries);
+  __frozen_report(succ_key, succ_value, frozen, k);
+}
+
+size_t red_black_tree_frozen_range_foreach(red_black_tree_frozen_t frozen,
+                                          void *lo,
+                                          void *hi,
+                                          int (*compare_key)(void *, void *, void *),
+                                          int (*visitor)(void *, void *, void *),
+                                          void *data)
+{
+  size_t n = frozen->number_entries;
+  size_t k, end, count = (size_t)0;
+
+  if ((lo != NULL) && (hi != NULL) && (__frozen_compare_keys(frozen, lo, hi, compare_key, data) >= 0))
+    return count;
+
+  if (lo == NULL)
+    k = __frozen_first(n);
+  else
+    k = __frozen_first_after(frozen, lo, 1, compare_key, data);
+
+  // Locate the end of the range up front rather than comparing
+  // every entry visited against hi.
+  end = (hi == NULL) ? ((size_t)0) : __frozen_first_after(frozen, hi, 1, compare_key, data);
+
+  for (; k != end; k = __frozen_next(k, n))
+  {
+    count++;
+    if ((visitor != NULL) && visitor(frozen->keys[k], frozen->values[k], data))
+      break;
+  }
+  return count;
 }
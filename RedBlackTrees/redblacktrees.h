@@ -5,20 +5,306 @@
 
 typedef struct __red_black_tree_struct_t *red_black_tree_t;
 
+/* Handle on an entry of a red-black tree. A position stays valid
+   until its entry is removed from the tree.
+*/
+typedef struct __red_black_tree_position_struct_t *red_black_tree_position_t;
+
+/* In-order cursor over a red-black tree, meant to live on the stack.
+
+   Besides the entries, a cursor can sit on the end position, which
+   lies one past the last entry and one before the first entry.
+   Stepping a cursor costs amortized O(1). Removing the entry a
+   cursor sits on invalidates the cursor; any other change to the
+   tree leaves it usable.
+*/
+typedef struct
+{
+  red_black_tree_t tree;
+  red_black_tree_position_t position;
+} red_black_tree_cursor_t;
+
+/* Allocator statistics of a red-black tree, see
+   red_black_tree_allocator_stats.
+*/
+typedef struct
+{
+  size_t number_slabs;
+  size_t nodes_per_slab;
+  size_t node_size;
+  size_t nodes_reserved;
+  size_t nodes_in_use;
+  size_t nodes_free;
+  size_t bytes_reserved;
+} red_black_tree_allocator_stats_t;
+
+/* Immutable, read-optimized snapshot of a red-black tree, see
+   red_black_tree_freeze.
+*/
+typedef struct __red_black_tree_frozen_struct_t *red_black_tree_frozen_t;
+
+/* A pool of worker threads shared by the set operations
+   red_black_tree_union, red_black_tree_intersection and
+   red_black_tree_difference.
+*/
+typedef struct __red_black_tree_pool_struct_t *red_black_tree_pool_t;
+
 /* Creates an empty red-black tree */
 red_black_tree_t red_black_tree_create();
 
+/* Creates an empty red-black tree whose nodes are taken from a
+   per-tree slab arena holding nodes_per_slab nodes per slab.
+
+   Removed nodes are kept on a free list and reused by later
+   inserts. All slabs are released at once when the tree is
+   deleted.
+
+   A default slab size is used if nodes_per_slab is zero.
+
+*/
+red_black_tree_t red_black_tree_create_with_allocator(size_t nodes_per_slab);
+
+/* Creates an empty red-black tree that stores keys of key_size
+   bytes and values of value_size bytes directly inside its nodes,
+   which are taken from a slab arena as with
+   red_black_tree_create_with_allocator.
+
+   Inserting copies the bytes pointed to by the key and value into
+   the node; keys and values handed out by the tree point into the
+   node. The copy_key, copy_value, delete_key and delete_value
+   arguments of all other functions are ignored for such a tree and
+   may be NULL, so an insert costs no allocation besides the node
+   and a removal or deletion none at all.
+
+*/
+red_black_tree_t red_black_tree_create_inline(size_t key_size,
+                                              size_t value_size,
+                                              size_t nodes_per_slab);
+
+/* Builds a red-black tree from n entries whose keys are already
+   sorted in strictly ascending order, copying the keys and values
+   with copy_key resp. copy_value.
+
+   Runs in O(n) without calling any comparison function. The result
+   is perfectly balanced and its nodes are carved from a single
+   allocation of n nodes in the tree's slab arena, as for trees made
+   by red_black_tree_create_with_allocator.
+
+*/
+red_black_tree_t red_black_tree_build_sorted(void **keys,
+                                             void **values,
+                                             size_t n,
+                                             void *(*copy_key)(void *, void *),
+                                             void *(*copy_value)(void *, void *),
+                                             void *data);
+
+/* Turns the subtree sizes of a red-black tree on (ranked != 0) or
+   off. Trees start without them, with nodes of 40 bytes on 64-bit
+   targets, plus the inline entry if any.
+
+   With subtree sizes, every node counts the entries below it in one
+   more size_t, and red_black_tree_select, red_black_tree_rank and
+   red_black_tree_count_in_range run in O(log n) instead of walking
+   the entries they count. In exchange, every insert and remove walks
+   the whole path from the changed node up to the root to update the
+   counts, O(log n) more work per update even where rebalancing stops
+   early, and red_black_tree_insert_batch loses part of the saving of
+   its finger descent.
+
+   Changing the setting moves every node to a new node of the other
+   layout in O(n), computing the sizes if they are turned on; positions
+   and cursors are invalidated. It is cheapest right after the tree is
+   created.
+
+*/
+void red_black_tree_set_ranked(red_black_tree_t tree, int ranked);
+
+/* Rebuilds a red-black tree into one of minimum height in place,
+   recoloring its nodes.
+
+   Uses the Day-Stout-Warren algorithm: rotations first turn the
+   tree into a sorted chain, then fold the chain into a tree whose
+   levels are all full but the last, whose nodes are colored red.
+   Runs in O(n) time with constant extra memory, without allocating
+   and without calling any comparison function. Positions and
+   cursors stay valid.
+
+*/
+void red_black_tree_rebuild(red_black_tree_t tree);
+
+/* Cuts a red-black tree at a key: *left receives the entries with
+   keys less than key, *right those with keys greater than or equal
+   to key.
+
+   *left is tree itself and *right a new tree, both of which have to
+   be deleted eventually. The nodes are relinked, not copied, in
+   O(log n) time; positions and cursors stay valid. Without subtree
+   sizes, the entries of either half are counted by the first call to
+   red_black_tree_number_entries on it, in O(n). The two trees
+   share the slab arena of tree, if any, which reports the nodes of
+   both in its allocator statistics.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void red_black_tree_split(red_black_tree_t *left,
+                          red_black_tree_t *right,
+                          red_black_tree_t tree,
+                          void *key,
+                          int (*compare_key)(void *, void *, void *),
+                          void *data);
+
+/* Concatenates two red-black trees: all keys of left must be less
+   than key, which must be less than all keys of right. The entries
+   of right and the pivot key and value, copied with copy_key resp.
+   copy_value, move into left, and right is deleted.
+
+   If key is NULL, the trees are simply concatenated and value,
+   copy_key and copy_value are ignored.
+
+   Both trees have to store their entries the same way, i.e. both
+   or neither created with red_black_tree_create_inline, with the
+   same sizes. If the trees differ in keeping subtree sizes, right is
+   converted first as by red_black_tree_set_ranked, in O(m), m being
+   the number of entries of right.
+
+   Runs in O(log n) without copying any node if neither tree uses a
+   slab arena or both do. In the latter case the arena of right is
+   merged into that of left in constant time, even if other trees,
+   e.g. split off either one, still use it; all of them then share
+   the merged arena. Only if exactly one of the trees uses an arena
+   are the nodes of right copied over, in O(m).
+
+*/
+void red_black_tree_join(red_black_tree_t left,
+                         void *key,
+                         void *value,
+                         red_black_tree_t right,
+                         void *(*copy_key)(void *, void *),
+                         void *(*copy_value)(void *, void *),
+                         void *data);
+
+/* Creates a pool of number_threads worker threads for the set
+   operations. The thread calling a set operation works along with
+   them. With zero threads, set operations run on the calling
+   thread only.
+
+*/
+red_black_tree_pool_t red_black_tree_pool_create(size_t number_threads);
+
+/* Stops the threads of a pool and deletes it. No set operation may
+   be running on the pool.
+
+*/
+void red_black_tree_pool_delete(red_black_tree_pool_t pool);
+
+/* Moves all entries of other into tree, deleting other. For a key
+   present in both trees, the entry of tree is kept: merge_value is
+   called with its key, its value, the value from other and the data
+   pointer, and may update the value in place; the key and value
+   from other are then deleted with delete_key resp. delete_value.
+   If merge_value is NULL, the value of tree is kept as is.
+
+   Follows the join-based divide and conquer of Blelloch et al.,
+   splitting other at the root key of tree and recursing on both
+   sides, which takes O(m log(n/m + 1)) time for trees of m and
+   n >= m entries, reusing the nodes. The two sides of large
+   subproblems are processed in parallel on the threads of pool,
+   which may be NULL to run on the calling thread only. compare_key
+   and merge_value must then be safe to call from several threads
+   at once; delete_key and delete_value are only called by the
+   calling thread, after the merge.
+
+   Both trees have to store their entries the same way, as for
+   red_black_tree_join. The nodes of other first go over to the
+   allocator of tree as in red_black_tree_join: in constant time if
+   both or neither use a slab arena, but by copying them in O(m) on
+   top of the bound above if exactly one does or if only one of the
+   trees keeps subtree sizes.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void red_black_tree_union(red_black_tree_t tree,
+                          red_black_tree_t other,
+                          int (*compare_key)(void *, void *, void *),
+                          void (*merge_value)(void *, void *, void *, void *),
+                          void (*delete_key)(void *, void *),
+                          void (*delete_value)(void *, void *),
+                          red_black_tree_pool_t pool,
+                          void *data);
+
+/* Keeps in tree only the keys also present in other, deleting
+   other, in the same way and with the same cost as
+   red_black_tree_union. merge_value is called for every key kept.
+   All entries not kept, from either tree, are deleted with
+   delete_key and delete_value.
+
+*/
+void red_black_tree_intersection(red_black_tree_t tree,
+                                 red_black_tree_t other,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void (*merge_value)(void *, void *, void *, void *),
+                                 void (*delete_key)(void *, void *),
+                                 void (*delete_value)(void *, void *),
+                                 red_black_tree_pool_t pool,
+                                 void *data);
+
+/* Removes from tree the keys present in other, deleting other, in
+   the same way and with the same cost as red_black_tree_union. All
+   entries of other and the entries removed from tree are deleted
+   with delete_key and delete_value.
+
+*/
+void red_black_tree_difference(red_black_tree_t tree,
+                               red_black_tree_t other,
+                               int (*compare_key)(void *, void *, void *),
+                               void (*delete_key)(void *, void *),
+                               void (*delete_value)(void *, void *),
+                               red_black_tree_pool_t pool,
+                               void *data);
+
+/* Fills in the allocator statistics of a red-black tree.
+
+   All counters are zero for a tree that was not created
+   with red_black_tree_create_with_allocator.
+
+*/
+void red_black_tree_allocator_stats(red_black_tree_allocator_stats_t *stats,
+                                    red_black_tree_t tree);
+
 /* Deletes a red-black tree, calling delete_key and delete_value
    on each key resp. value, passing in the data pointer.
+
+   Runs in O(n) with constant extra memory. Either function may be
+   NULL if the keys resp. values need no cleanup; if both are NULL
+   and the tree uses a slab arena of its own, the nodes are not
+   visited at all.
 */
 void red_black_tree_delete(red_black_tree_t tree,
                            void (*delete_key)(void *, void *),
                            void (*delete_value)(void *, void *),
                            void *data);
 
+/* Removes all entries from a red-black tree like
+   red_black_tree_delete, but keeps the tree itself for reuse.
+
+   A tree using a slab arena keeps its largest slab.
+*/
+void red_black_tree_clear(red_black_tree_t tree,
+                          void (*delete_key)(void *, void *),
+                          void (*delete_value)(void *, void *),
+                          void *data);
+
 /* Returns the number of entries in a red-black tree
 
-   Returns zero for an empty tree.
+   Returns zero for an empty tree. Runs in constant time, except for
+   the first call after a split or a set operation on a tree without
+   subtree sizes, which counts the entries in O(n).
 
 */
 size_t red_black_tree_number_entries(red_black_tree_t tree);
@@ -30,6 +316,26 @@ size_t red_black_tree_number_entries(red_black_tree_t tree);
 */
 size_t red_black_tree_height(red_black_tree_t tree);
 
+/* Returns the black height of a red-black tree, i.e. the number
+   of black nodes on any path from the root down to a leaf.
+
+   Runs in O(log n). Returns zero for an empty tree.
+
+*/
+size_t red_black_tree_black_height(red_black_tree_t tree);
+
+/* Returns a lower and an upper bound on the height of a
+   red-black tree without walking the whole tree.
+
+   The bounds follow from the number of entries and the black
+   height and are computed in O(log n). Both are zero for an
+   empty tree.
+
+*/
+void red_black_tree_height_bounds(size_t *min_height,
+                                  size_t *max_height,
+                                  red_black_tree_t tree);
+
 /* Searches a red-black tree for a key, comparing keys with
    compare_key, returning the associated value.
 
@@ -45,6 +351,27 @@ void *red_black_tree_search(red_black_tree_t tree,
                             int (*compare_key)(void *, void *, void *),
                             void *data);
 
+/* Searches a red-black tree for n keys at once, comparing keys with
+   compare_key, and stores the value associated with keys[i] in
+   values[i], or NULL if keys[i] cannot be found.
+
+   Gives the same results as n calls to red_black_tree_search, but
+   advances several lookups side by side and prefetches the nodes
+   they visit, so that on trees exceeding the cache the memory
+   latency of one lookup overlaps with the others.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void red_black_tree_search_batch(void **values,
+                                 red_black_tree_t tree,
+                                 void **keys,
+                                 size_t n,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void *data);
+
 /* Returns the minimum key and associated value, comparing
    the keys with compare_key.
 
@@ -67,6 +394,72 @@ void red_black_tree_maximum(void **max_key,
                             void **max_value,
                             red_black_tree_t tree);
 
+/* Returns the entry with the smallest key greater than or equal
+   to key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void red_black_tree_lower_bound(void **found_key,
+                                void **found_value,
+                                red_black_tree_position_t *position,
+                                red_black_tree_t tree,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data);
+
+/* Returns the entry with the smallest key strictly greater than
+   key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+*/
+void red_black_tree_upper_bound(void **found_key,
+                                void **found_value,
+                                red_black_tree_position_t *position,
+                                red_black_tree_t tree,
+                                void *key,
+                                int (*compare_key)(void *, void *, void *),
+                                void *data);
+
+/* Returns the entry with the largest key less than or equal to
+   key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+*/
+void red_black_tree_floor(void **found_key,
+                          void **found_value,
+                          red_black_tree_position_t *position,
+                          red_black_tree_t tree,
+                          void *key,
+                          int (*compare_key)(void *, void *, void *),
+                          void *data);
+
+/* Returns the entry with the smallest key greater than or equal
+   to key, together with its position. Same as
+   red_black_tree_lower_bound.
+
+*/
+void red_black_tree_ceiling(void **found_key,
+                            void **found_value,
+                            red_black_tree_position_t *position,
+                            red_black_tree_t tree,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data);
+
+/* Returns the key resp. value of the entry at a position. */
+void *red_black_tree_position_key(red_black_tree_position_t position);
+void *red_black_tree_position_value(red_black_tree_position_t position);
+
 /* Returns the predecessor of a key and value associated with that
    key, comparing the keys with compare_key.
 
@@ -105,6 +498,141 @@ void red_black_tree_successor(void **succ_key,
                               int (*compare_key)(void *, void *, void *),
                               void *data);
 
+/* Positions a cursor on the first entry of a tree resp. on the end
+   position.
+
+   red_black_tree_cursor_begin returns 1 if the cursor sits on an
+   entry and 0 if the tree is empty. red_black_tree_cursor_end
+   always returns 0.
+
+   Forward traversal:  for (ok = red_black_tree_cursor_begin(&c, t);
+                            ok; ok = red_black_tree_cursor_next(&c))
+   Reverse traversal:  red_black_tree_cursor_end(&c, t);
+                       while (red_black_tree_cursor_prev(&c))
+
+*/
+int red_black_tree_cursor_begin(red_black_tree_cursor_t *cursor,
+                                red_black_tree_t tree);
+int red_black_tree_cursor_end(red_black_tree_cursor_t *cursor,
+                              red_black_tree_t tree);
+
+/* Positions a cursor on the entry with the smallest key greater
+   than or equal to key, or on the end position if there is none.
+
+   Returns 1 if the cursor sits on an entry, 0 otherwise.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int red_black_tree_cursor_seek(red_black_tree_cursor_t *cursor,
+                               red_black_tree_t tree,
+                               void *key,
+                               int (*compare_key)(void *, void *, void *),
+                               void *data);
+
+/* Positions a cursor on the entry at position, or on the end
+   position if position is NULL.
+
+   Returns 1 if the cursor sits on an entry, 0 otherwise.
+
+*/
+int red_black_tree_cursor_at(red_black_tree_cursor_t *cursor,
+                             red_black_tree_t tree,
+                             red_black_tree_position_t position);
+
+/* Moves a cursor to the next resp. previous entry in key order.
+   Moving from the end position goes to the first resp. last entry.
+
+   Returns 1 if the cursor sits on an entry afterwards, 0 if it
+   reached the end position.
+
+*/
+int red_black_tree_cursor_next(red_black_tree_cursor_t *cursor);
+int red_black_tree_cursor_prev(red_black_tree_cursor_t *cursor);
+
+/* Returns 1 if a cursor sits on an entry, 0 if it sits on the
+   end position.
+*/
+int red_black_tree_cursor_valid(red_black_tree_cursor_t *cursor);
+
+/* Returns the key resp. value of the entry a cursor sits on.
+   The cursor must not sit on the end position.
+*/
+void *red_black_tree_cursor_key(red_black_tree_cursor_t *cursor);
+void *red_black_tree_cursor_value(red_black_tree_cursor_t *cursor);
+
+/* Returns the entry with the k-th smallest key, counting from zero,
+   together with its position, in O(log n) if the tree keeps subtree
+   sizes, see red_black_tree_set_ranked, and in O(log n + k) by
+   stepping through the entries otherwise.
+
+   Returns NULL for the key, the value and the position if the tree
+   has k entries or less. position may be NULL if it is not needed.
+
+*/
+void red_black_tree_select(void **found_key,
+                           void **found_value,
+                           red_black_tree_position_t *position,
+                           red_black_tree_t tree,
+                           size_t k);
+
+/* Returns the rank of a key, i.e. the number of keys in the tree
+   strictly less than key, in O(log n) with subtree sizes and in
+   O(log n + rank) otherwise. The key does not need to be present
+   in the tree.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t red_black_tree_rank(red_black_tree_t tree,
+                           void *key,
+                           int (*compare_key)(void *, void *, void *),
+                           void *data);
+
+/* Returns the number of entries with lo <= key < hi in O(log n)
+   with subtree sizes and in O(log n + k) for k such entries
+   otherwise. A NULL lo resp. hi leaves the range unbounded on that
+   side.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t red_black_tree_count_in_range(red_black_tree_t tree,
+                                     void *lo,
+                                     void *hi,
+                                     int (*compare_key)(void *, void *, void *),
+                                     void *data);
+
+/* Visits the entries with lo <= key < hi in key order, calling
+   visitor on each key and value with the data pointer, in
+   O(log n + k) for k visited entries.
+
+   A NULL lo resp. hi leaves the range unbounded on that side.
+   The scan stops early as soon as visitor returns a non-zero
+   value. If visitor is NULL, the entries are only counted, at the
+   cost of red_black_tree_count_in_range.
+
+   Returns the number of entries visited, including the one on
+   which the scan was stopped.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t red_black_tree_range_foreach(red_black_tree_t tree,
+                                   void *lo,
+                                   void *hi,
+                                   int (*compare_key)(void *, void *, void *),
+                                   int (*visitor)(void *, void *, void *),
+                                   void *data);
+
 /* Inserts a key and an associated value into a tree, comparing the
    keys with compare_key and copying the key and value with the
    copy_key resp. copy_value functions.
@@ -122,6 +650,81 @@ void red_black_tree_insert(red_black_tree_t tree,
                            void *(*copy_value)(void *, void *),
                            void *data);
 
+/* Inserts a key and an associated value into a tree unless the key
+   is already present, descending the tree only once.
+
+   Returns 1 if a new entry was inserted, copying the key and value
+   with copy_key resp. copy_value. Returns 0 if the key was already
+   present, in which case the tree is left unchanged.
+
+   In both cases, if value_in_tree is not NULL, it is set to the
+   value now associated with the key in the tree.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int red_black_tree_insert_or_get(void **value_in_tree,
+                                 red_black_tree_t tree,
+                                 void *key,
+                                 void *value,
+                                 int (*compare_key)(void *, void *, void *),
+                                 void *(*copy_key)(void *, void *),
+                                 void *(*copy_value)(void *, void *),
+                                 void *data);
+
+/* Inserts a key and an associated value into a tree, or replaces
+   the value if the key is already present, descending the tree
+   only once.
+
+   A replaced value is deleted with delete_value and the new one
+   copied with copy_value in place; the stored key is kept. A new
+   entry copies both the key and the value. delete_value may be
+   NULL if the values need no cleanup.
+
+   Returns 1 if the key was already present, 0 otherwise.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int red_black_tree_upsert(red_black_tree_t tree,
+                          void *key,
+                          void *value,
+                          int (*compare_key)(void *, void *, void *),
+                          void *(*copy_key)(void *, void *),
+                          void *(*copy_value)(void *, void *),
+                          void (*delete_value)(void *, void *),
+                          void *data);
+
+/* Inserts n keys and their associated values into a tree, copying
+   them with copy_key resp. copy_value. Keys already present in the
+   tree, and repeated keys within the batch after their first
+   occurrence, are skipped as with red_black_tree_insert.
+
+   The batch is sorted first unless its keys already come in
+   ascending order. Each key is then located by climbing from the
+   previous insertion point instead of descending from the root,
+   which saves comparisons and cache misses for clustered keys.
+
+   Returns the number of entries actually inserted.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t red_black_tree_insert_batch(red_black_tree_t tree,
+                                   void **keys,
+                                   void **values,
+                                   size_t n,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *(*copy_key)(void *, void *),
+                                   void *(*copy_value)(void *, void *),
+                                   void *data);
+
 /* Removes a key and the associated value in a tree, comparing the
    keys with compare_key and deleting the key and value with the
    delete_key resp. delete_value function.
@@ -138,4 +741,96 @@ void red_black_tree_remove(red_black_tree_t tree,
                            void (*delete_value)(void *, void *),
                            void *data);
 
+/* Takes an immutable snapshot of a red-black tree for lookup-heavy
+   phases, copying the keys and values with copy_key resp. copy_value.
+   Either function may be NULL, in which case the snapshot shares the
+   keys resp. values with the tree, which then must not remove them
+   while the snapshot is in use.
+
+   The snapshot keeps its entries in arrays laid out in Eytzinger
+   (breadth-first) order, so a descent reads one contiguous array
+   instead of chasing node pointers, and the top levels shared by all
+   lookups stay in cache. The tree itself is not changed and may go
+   on being modified or be deleted afterwards.
+
+   If integer_key is not NULL, it maps a key and the data pointer to
+   a long long, and must preserve the order of the keys. The
+   snapshot then also stores the mapped keys and searches them with a
+   branchless, prefetching descent that never calls a compare_key
+   function; the compare_key arguments of the functions below are
+   ignored and may be NULL.
+
+   Runs in O(n).
+
+*/
+red_black_tree_frozen_t red_black_tree_freeze(red_black_tree_t tree,
+                                              void *(*copy_key)(void *, void *),
+                                              void *(*copy_value)(void *, void *),
+                                              long long (*integer_key)(void *, void *),
+                                              void *data);
+
+/* Deletes a snapshot, calling delete_key and delete_value on each
+   key resp. value, passing in the data pointer. Either function may
+   be NULL, e.g. if the snapshot shares its keys resp. values with
+   the tree.
+*/
+void red_black_tree_frozen_delete(red_black_tree_frozen_t frozen,
+                                  void (*delete_key)(void *, void *),
+                                  void (*delete_value)(void *, void *),
+                                  void *data);
+
+/* Returns the number of entries in a snapshot. */
+size_t red_black_tree_frozen_number_entries(red_black_tree_frozen_t frozen);
+
+/* Same as red_black_tree_search, red_black_tree_minimum,
+   red_black_tree_maximum, red_black_tree_lower_bound,
+   red_black_tree_predecessor and red_black_tree_successor,
+   on a snapshot.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void *red_black_tree_frozen_search(red_black_tree_frozen_t frozen,
+                                   void *key,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *data);
+void red_black_tree_frozen_minimum(void **min_key,
+                                   void **min_value,
+                                   red_black_tree_frozen_t frozen);
+void red_black_tree_frozen_maximum(void **max_key,
+                                   void **max_value,
+                                   red_black_tree_frozen_t frozen);
+void red_black_tree_frozen_lower_bound(void **found_key,
+                                       void **found_value,
+                                       red_black_tree_frozen_t frozen,
+                                       void *key,
+                                       int (*compare_key)(void *, void *, void *),
+                                       void *data);
+void red_black_tree_frozen_predecessor(void **prec_key,
+                                       void **prec_value,
+                                       red_black_tree_frozen_t frozen,
+                                       void *key,
+                                       int (*compare_key)(void *, void *, void *),
+                                       void *data);
+void red_black_tree_frozen_successor(void **succ_key,
+                                     void **succ_value,
+                                     red_black_tree_frozen_t frozen,
+                                     void *key,
+                                     int (*compare_key)(void *, void *, void *),
+                                     void *data);
+
+/* Same as red_black_tree_range_foreach on a snapshot. Runs in
+   O(log n + k) for k entries in the range, also when only
+   counting.
+
+*/
+size_t red_black_tree_frozen_range_foreach(red_black_tree_frozen_t frozen,
+                                          void *lo,
+                                          void *hi,
+                                          int (*compare_key)(void *, void *, void *),
+                                          int (*visitor)(void *, void *, void *),
+                                          void *data);
+
 #endif
@@ -0,0 +1,750 @@
+#ifndef RED_BLACK_TREES_TEMPLATE_H
+#define RED_BLACK_TREES_TEMPLATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Generator for type-specialized red-black trees.
+
+   RB_TREE_DEFINE(prefix, key_type, value_type, cmp) emits a red-black
+   tree type prefix_t storing keys of key_type and values of value_type
+   by value inside its nodes, together with the functions
+
+     prefix_t     prefix_create(void);
+     void         prefix_delete(prefix_t tree);
+     size_t       prefix_number_entries(prefix_t tree);
+     size_t       prefix_height(prefix_t tree);
+     value_type * prefix_search(prefix_t tree, key_type key);
+     void         prefix_minimum(key_type **min_key, value_type **min_value, prefix_t tree);
+     void         prefix_maximum(key_type **max_key, value_type **max_value, prefix_t tree);
+     void         prefix_predecessor(key_type **prec_key, value_type **prec_value,
+                                     prefix_t tree, key_type key);
+     void         prefix_successor(key_type **succ_key, value_type **succ_value,
+                                   prefix_t tree, key_type key);
+     int          prefix_insert(prefix_t tree, key_type key, value_type value);
+     int          prefix_remove(prefix_t tree, key_type key);
+
+   which behave like their counterparts in redblacktrees.h: keys and
+   values handed out point into the tree and NULL stands for "none",
+   inserting a key that is already present leaves the tree unchanged,
+   and insert resp. remove return 1 if they changed the tree.
+
+   cmp is called as cmp(a, b) on two key_type values and must return
+   a negative, zero or positive int. It is expanded inline in every
+   descent, so it may be a function-like macro, e.g.
+
+     #define INT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+     RB_TREE_DEFINE(int_tree, int, int, INT_CMP)
+
+   All functions are static inline, so the macro can be expanded in
+   a header. Nodes are carved from slabs of RB_TREE_NODES_PER_SLAB
+   nodes owned by the tree, removed nodes are kept on a free list for
+   the next inserts, and deleting the tree frees the slabs without
+   visiting the nodes. Running out of memory prints an error and
+   exits, as elsewhere in this library.
+
+   RB_TREE_DEFINE is built from two lower layers, which redblacktrees.c
+   instantiates as well for its void * API:
+
+   RB_TREE_DEFINE_NODE(prefix, key_type, value_type) emits the node
+   type prefix_node_t, whose color lives in the lowest bit of the
+   parent pointer, and its accessors __prefix_parent, __prefix_color,
+   __prefix_is_black, __prefix_set_parent and __prefix_set_color.
+   Trees that keep subtree sizes store them right behind the node,
+   see __prefix_size_slot.
+
+   RB_TREE_DEFINE_CORE(prefix, tree_type, key_type, compare,
+   context_type, ranked) emits the algorithms on such nodes for a tree
+   type tree_type that points to a struct with a root member: the
+   rotations, the insert and remove fix-ups, __prefix_link and
+   __prefix_detach to add resp. take out a node, the descents
+   __prefix_search_aux, __prefix_first_after, __prefix_last_before and
+   __prefix_locate_from, the in-order walk __prefix_first, _last, _next
+   and _prev, and the heights. Keys are ordered by
+   compare(a, b, context), where context of context_type is passed
+   down from the caller of each descent. ranked(tree) tells whether
+   the nodes of a tree carry subtree sizes to be kept up to date;
+   RB_TREE_UNRANKED says never. Neither layer allocates nodes or
+   counts entries.
+*/
+
+#define RB_TREE_RED 0
+#define RB_TREE_BLACK 1
+
+#define RB_TREE_NODES_PER_SLAB ((size_t)1024)
+
+#define RB_TREE_UNRANKED(tree) ((void)(tree), 0)
+
+
+#define RB_TREE_DEFINE_NODE(prefix, key_type, value_type)                                      \
+                                                                                               \
+  typedef struct prefix##_node_struct_t *prefix##_node_t;                                      \
+  struct prefix##_node_struct_t                                                                \
+  {                                                                                            \
+    key_type key;                                                                              \
+    value_type value;                                                                          \
+    uintptr_t parent_color; /* parent pointer, lowest bit set for black */                     \
+    prefix##_node_t left;                                                                      \
+    prefix##_node_t right;                                                                     \
+  };                                                                                           \
+                                                                                               \
+  static inline prefix##_node_t __##prefix##_parent(prefix##_node_t node)                      \
+  {                                                                                            \
+    return (prefix##_node_t)(node->parent_color & ~((uintptr_t)1));                            \
+  }                                                                                            \
+                                                                                               \
+  static inline int __##prefix##_color(prefix##_node_t node)                                   \
+  {                                                                                            \
+    return (int)(node->parent_color & ((uintptr_t)1));                                         \
+  }                                                                                            \
+                                                                                               \
+  static inline int __##prefix##_is_black(prefix##_node_t node)                                \
+  {                                                                                            \
+    return (node == NULL) || (__##prefix##_color(node) == RB_TREE_BLACK);                      \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_set_parent(prefix##_node_t node, prefix##_node_t parent)     \
+  {                                                                                            \
+    node->parent_color = ((uintptr_t)parent) | (node->parent_color & ((uintptr_t)1));          \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_set_color(prefix##_node_t node, int color)                   \
+  {                                                                                            \
+    node->parent_color = (node->parent_color & ~((uintptr_t)1)) | ((uintptr_t)color);          \
+  }                                                                                            \
+                                                                                               \
+  static inline size_t *__##prefix##_size_slot(prefix##_node_t node)                           \
+  {                                                                                            \
+    return (size_t *)(node + 1);                                                               \
+  }                                                                                            \
+                                                                                               \
+  static inline size_t __##prefix##_size(prefix##_node_t node)                                 \
+  {                                                                                            \
+    return (node == NULL) ? ((size_t)0) : *__##prefix##_size_slot(node);                       \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_update_size(prefix##_node_t node)                            \
+  {                                                                                            \
+    *__##prefix##_size_slot(node) = __##prefix##_size(node->left) +                            \
+                                    __##prefix##_size(node->right) + ((size_t)1);              \
+  }
+
+
+#define RB_TREE_DEFINE_CORE(prefix, tree_type, key_type, compare, context_type, ranked)        \
+                                                                                               \
+  static inline void __##prefix##_replace_child(tree_type tree,                                \
+                                                prefix##_node_t parent,                        \
+                                                prefix##_node_t old_child,                     \
+                                                prefix##_node_t new_child)                     \
+  {                                                                                            \
+    if (parent == NULL)                                                                        \
+      tree->root = new_child;                                                                  \
+    else if (parent->left == old_child)                                                        \
+      parent->left = new_child;                                                                \
+    else                                                                                       \
+      parent->right = new_child;                                                               \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_left_rotate(tree_type tree, prefix##_node_t x)               \
+  {                                                                                            \
+    prefix##_node_t y = x->right;                                                              \
+    x->right = y->left;                                                                        \
+    if (y->left != NULL)                                                                       \
+      __##prefix##_set_parent(y->left, x);                                                     \
+    __##prefix##_set_parent(y, __##prefix##_parent(x));                                        \
+    __##prefix##_replace_child(tree, __##prefix##_parent(x), x, y);                            \
+    y->left = x;                                                                               \
+    __##prefix##_set_parent(x, y);                                                             \
+    if (ranked(tree))                                                                          \
+    {                                                                                          \
+      *__##prefix##_size_slot(y) = *__##prefix##_size_slot(x);                                 \
+      __##prefix##_update_size(x);                                                             \
+    }                                                                                          \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_right_rotate(tree_type tree, prefix##_node_t y)              \
+  {                                                                                            \
+    prefix##_node_t x = y->left;                                                               \
+    y->left = x->right;                                                                        \
+    if (x->right != NULL)                                                                      \
+      __##prefix##_set_parent(x->right, y);                                                    \
+    __##prefix##_set_parent(x, __##prefix##_parent(y));                                        \
+    __##prefix##_replace_child(tree, __##prefix##_parent(y), y, x);                            \
+    x->right = y;                                                                              \
+    __##prefix##_set_parent(y, x);                                                             \
+    if (ranked(tree))                                                                          \
+    {                                                                                          \
+      *__##prefix##_size_slot(x) = *__##prefix##_size_slot(y);                                 \
+      __##prefix##_update_size(y);                                                             \
+    }                                                                                          \
+  }                                                                                            \
+                                                                                               \
+  /* Restores the red-black properties after linking the red node z.                           \
+     Returns non-zero if the fix-up reached the root and the black                             \
+     height of the tree grew by one. */                                                        \
+  static inline int __##prefix##_insert_fix(tree_type tree, prefix##_node_t z)                 \
+  {                                                                                            \
+    prefix##_node_t p, g, y;                                                                   \
+    int grown;                                                                                 \
+    while ((z != tree->root) && !__##prefix##_is_black(__##prefix##_parent(z)))                \
+    {                                                                                          \
+      p = __##prefix##_parent(z);                                                              \
+      g = __##prefix##_parent(p);                                                              \
+      y = (p == g->left) ? g->right : g->left;                                                 \
+      if (!__##prefix##_is_black(y))                                                           \
+      {                                                                                        \
+        /* red uncle */                                                                        \
+        __##prefix##_set_color(p, RB_TREE_BLACK);                                              \
+        __##prefix##_set_color(y, RB_TREE_BLACK);                                              \
+        __##prefix##_set_color(g, RB_TREE_RED);                                                \
+        z = g;                                                                                 \
+      }                                                                                        \
+      else if (p == g->left)                                                                   \
+      {                                                                                        \
+        if (z == p->right)                                                                     \
+        {                                                                                      \
+          z = p;                                                                               \
+          __##prefix##_left_rotate(tree, z);                                                   \
+          p = __##prefix##_parent(z);                                                          \
+        }                                                                                      \
+        __##prefix##_set_color(p, RB_TREE_BLACK);                                              \
+        __##prefix##_set_color(g, RB_TREE_RED);                                                \
+        __##prefix##_right_rotate(tree, g);                                                    \
+      }                                                                                        \
+      else                                                                                     \
+      {                                                                                        \
+        if (z == p->left)                                                                      \
+        {                                                                                      \
+          z = p;                                                                               \
+          __##prefix##_right_rotate(tree, z);                                                  \
+          p = __##prefix##_parent(z);                                                          \
+        }                                                                                      \
+        __##prefix##_set_color(p, RB_TREE_BLACK);                                              \
+        __##prefix##_set_color(g, RB_TREE_RED);                                                \
+        __##prefix##_left_rotate(tree, g);                                                     \
+      }                                                                                        \
+    }                                                                                          \
+    grown = (__##prefix##_color(tree->root) == RB_TREE_RED);                                   \
+    __##prefix##_set_color(tree->root, RB_TREE_BLACK);                                         \
+    return grown;                                                                              \
+  }                                                                                            \
+                                                                                               \
+  /* Links the fresh node z below y on the side given by side, or as                           \
+     the root if y is NULL, and restores the red-black properties. */                          \
+  static inline void __##prefix##_link(tree_type tree,                                         \
+                                       prefix##_node_t z,                                      \
+                                       prefix##_node_t y,                                      \
+                                       int side)                                               \
+  {                                                                                            \
+    prefix##_node_t w;                                                                         \
+    if (ranked(tree))                                                                          \
+    {                                                                                          \
+      for (w = y; w != NULL; w = __##prefix##_parent(w))                                       \
+        (*__##prefix##_size_slot(w))++;                                                        \
+    }                                                                                          \
+    __##prefix##_set_parent(z, y);                                                             \
+    if (y == NULL)                                                                             \
+      tree->root = z;                                                                          \
+    else if (side < 0)                                                                         \
+      y->left = z;                                                                             \
+    else                                                                                       \
+      y->right = z;                                                                            \
+    __##prefix##_insert_fix(tree, z);                                                          \
+  }                                                                                            \
+                                                                                               \
+  /* Accounts for a node leaving the subtrees rooted at node and at                            \
+     all its ancestors, if the tree keeps subtree sizes. */                                    \
+  static inline void __##prefix##_shrink_path(tree_type tree, prefix##_node_t node)            \
+  {                                                                                            \
+    if (!ranked(tree))                                                                         \
+      return;                                                                                  \
+    for (; node != NULL; node = __##prefix##_parent(node))                                     \
+      (*__##prefix##_size_slot(node))--;                                                       \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_transplant(tree_type tree,                                   \
+                                             prefix##_node_t u,                                \
+                                             prefix##_node_t v)                                \
+  {                                                                                            \
+    __##prefix##_replace_child(tree, __##prefix##_parent(u), u, v);                            \
+    if (v != NULL)                                                                             \
+      __##prefix##_set_parent(v, __##prefix##_parent(u));                                      \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_remove_fix(tree_type tree,                                   \
+                                             prefix##_node_t x,                                \
+                                             prefix##_node_t x_parent)                         \
+  {                                                                                            \
+    prefix##_node_t w;                                                                         \
+    while ((x != tree->root) && __##prefix##_is_black(x))                                      \
+    {                                                                                          \
+      if (x == x_parent->left)                                                                 \
+      {                                                                                        \
+        w = x_parent->right;                                                                   \
+        if (!__##prefix##_is_black(w))                                                         \
+        {                                                                                      \
+          __##prefix##_set_color(w, RB_TREE_BLACK);                                            \
+          __##prefix##_set_color(x_parent, RB_TREE_RED);                                       \
+          __##prefix##_left_rotate(tree, x_parent);                                            \
+          w = x_parent->right;                                                                 \
+        }                                                                                      \
+        if (__##prefix##_is_black(w->left) && __##prefix##_is_black(w->right))                 \
+        {                                                                                      \
+          __##prefix##_set_color(w, RB_TREE_RED);                                              \
+          x = x_parent;                                                                        \
+          x_parent = __##prefix##_parent(x);                                                   \
+        }                                                                                      \
+        else                                                                                   \
+        {                                                                                      \
+          if (__##prefix##_is_black(w->right))                                                 \
+          {                                                                                    \
+            __##prefix##_set_color(w->left, RB_TREE_BLACK);                                    \
+            __##prefix##_set_color(w, RB_TREE_RED);                                            \
+            __##prefix##_right_rotate(tree, w);                                                \
+            w = x_parent->right;                                                               \
+          }                                                                                    \
+          __##prefix##_set_color(w, __##prefix##_color(x_parent));                             \
+          __##prefix##_set_color(x_parent, RB_TREE_BLACK);                                     \
+          __##prefix##_set_color(w->right, RB_TREE_BLACK);                                     \
+          __##prefix##_left_rotate(tree, x_parent);                                            \
+          x = tree->root;                                                                      \
+        }                                                                                      \
+      }                                                                                        \
+      else                                                                                     \
+      {                                                                                        \
+        w = x_parent->left;                                                                    \
+        if (!__##prefix##_is_black(w))                                                         \
+        {                                                                                      \
+          __##prefix##_set_color(w, RB_TREE_BLACK);                                            \
+          __##prefix##_set_color(x_parent, RB_TREE_RED);                                       \
+          __##prefix##_right_rotate(tree, x_parent);                                           \
+          w = x_parent->left;                                                                  \
+        }                                                                                      \
+        if (__##prefix##_is_black(w->left) && __##prefix##_is_black(w->right))                 \
+        {                                                                                      \
+          __##prefix##_set_color(w, RB_TREE_RED);                                              \
+          x = x_parent;                                                                        \
+          x_parent = __##prefix##_parent(x);                                                   \
+        }                                                                                      \
+        else                                                                                   \
+        {                                                                                      \
+          if (__##prefix##_is_black(w->left))                                                  \
+          {                                                                                    \
+            __##prefix##_set_color(w->right, RB_TREE_BLACK);                                   \
+            __##prefix##_set_color(w, RB_TREE_RED);                                            \
+            __##prefix##_left_rotate(tree, w);                                                 \
+            w = x_parent->left;                                                                \
+          }                                                                                    \
+          __##prefix##_set_color(w, __##prefix##_color(x_parent));                             \
+          __##prefix##_set_color(x_parent, RB_TREE_BLACK);                                     \
+          __##prefix##_set_color(w->left, RB_TREE_BLACK);                                      \
+          __##prefix##_right_rotate(tree, x_parent);                                           \
+          x = tree->root;                                                                      \
+        }                                                                                      \
+      }                                                                                        \
+    }                                                                                          \
+    if (x != NULL)                                                                             \
+      __##prefix##_set_color(x, RB_TREE_BLACK);                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline prefix##_node_t __##prefix##_first(prefix##_node_t node)                       \
+  {                                                                                            \
+    if (node == NULL)                                                                          \
+      return NULL;                                                                             \
+    while (node->left != NULL)                                                                 \
+      node = node->left;                                                                       \
+    return node;                                                                               \
+  }                                                                                            \
+                                                                                               \
+  static inline prefix##_node_t __##prefix##_last(prefix##_node_t node)                        \
+  {                                                                                            \
+    if (node == NULL)                                                                          \
+      return NULL;                                                                             \
+    while (node->right != NULL)                                                                \
+      node = node->right;                                                                      \
+    return node;                                                                               \
+  }                                                                                            \
+                                                                                               \
+  /* In-order neighbours of a node, following the parent pointers.                             \
+     Walking the whole tree this way touches every edge twice, so a                            \
+     step costs amortized O(1). */                                                             \
+  static inline prefix##_node_t __##prefix##_next(prefix##_node_t x)                           \
+  {                                                                                            \
+    prefix##_node_t y;                                                                         \
+    if (x->right != NULL)                                                                      \
+      return __##prefix##_first(x->right);                                                     \
+    y = __##prefix##_parent(x);                                                                \
+    while ((y != NULL) && (x == y->right))                                                     \
+    {                                                                                          \
+      x = y;                                                                                   \
+      y = __##prefix##_parent(y);                                                              \
+    }                                                                                          \
+    return y;                                                                                  \
+  }                                                                                            \
+                                                                                               \
+  static inline prefix##_node_t __##prefix##_prev(prefix##_node_t x)                           \
+  {                                                                                            \
+    prefix##_node_t y;                                                                         \
+    if (x->left != NULL)                                                                       \
+      return __##prefix##_last(x->left);                                                       \
+    y = __##prefix##_parent(x);                                                                \
+    while ((y != NULL) && (x == y->left))                                                      \
+    {                                                                                          \
+      x = y;                                                                                   \
+      y = __##prefix##_parent(y);                                                              \
+    }                                                                                          \
+    return y;                                                                                  \
+  }                                                                                            \
+                                                                                               \
+  /* Takes the node z out of the tree and restores the red-black                               \
+     properties. The node itself and its entry are left alone. */                              \
+  static inline void __##prefix##_detach(tree_type tree, prefix##_node_t z)                    \
+  {                                                                                            \
+    prefix##_node_t y, x, x_parent;                                                            \
+    int y_original_color;                                                                      \
+    y = z;                                                                                     \
+    y_original_color = __##prefix##_color(y);                                                  \
+    if ((z->left == NULL) || (z->right == NULL))                                               \
+      __##prefix##_shrink_path(tree, __##prefix##_parent(z));                                  \
+    if (z->left == NULL)                                                                       \
+    {                                                                                          \
+      x = z->right;                                                                            \
+      x_parent = __##prefix##_parent(z);                                                       \
+      __##prefix##_transplant(tree, z, z->right);                                              \
+    }                                                                                          \
+    else if (z->right == NULL)                                                                 \
+    {                                                                                          \
+      x = z->left;                                                                             \
+      x_parent = __##prefix##_parent(z);                                                       \
+      __##prefix##_transplant(tree, z, z->left);                                               \
+    }                                                                                          \
+    else                                                                                       \
+    {                                                                                          \
+      y = __##prefix##_first(z->right);                                                        \
+      y_original_color = __##prefix##_color(y);                                                \
+      __##prefix##_shrink_path(tree, __##prefix##_parent(y));                                  \
+      x = y->right;                                                                            \
+      x_parent = y;                                                                            \
+      if (__##prefix##_parent(y) != z)                                                         \
+      {                                                                                        \
+        x_parent = __##prefix##_parent(y);                                                     \
+        __##prefix##_transplant(tree, y, y->right);                                            \
+        y->right = z->right;                                                                   \
+        __##prefix##_set_parent(y->right, y);                                                  \
+      }                                                                                        \
+      __##prefix##_transplant(tree, z, y);                                                     \
+      y->left = z->left;                                                                       \
+      __##prefix##_set_parent(y->left, y);                                                     \
+      __##prefix##_set_color(y, __##prefix##_color(z));                                        \
+      if (ranked(tree))                                                                        \
+        *__##prefix##_size_slot(y) = *__##prefix##_size_slot(z);                               \
+    }                                                                                          \
+    if (y_original_color == RB_TREE_BLACK)                                                     \
+      __##prefix##_remove_fix(tree, x, x_parent);                                              \
+  }                                                                                            \
+                                                                                               \
+  static inline prefix##_node_t __##prefix##_search_aux(prefix##_node_t node,                  \
+                                                        key_type key,                          \
+                                                        context_type context)                  \
+  {                                                                                            \
+    int c;                                                                                     \
+    while (node != NULL)                                                                       \
+    {                                                                                          \
+      c = compare(key, node->key, context);                                                    \
+      if (c == 0)                                                                              \
+        return node;                                                                           \
+      node = (c < 0) ? node->left : node->right;                                               \
+    }                                                                                          \
+    return NULL;                                                                               \
+  }                                                                                            \
+                                                                                               \
+  /* Returns the node with the smallest key greater than or equal to                           \
+     key (inclusive) resp. strictly greater than key, or NULL. */                              \
+  static inline prefix##_node_t __##prefix##_first_after(prefix##_node_t node,                 \
+                                                         key_type key,                         \
+                                                         int inclusive,                        \
+                                                         context_type context)                 \
+  {                                                                                            \
+    prefix##_node_t best = NULL;                                                               \
+    int c;                                                                                     \
+    while (node != NULL)                                                                       \
+    {                                                                                          \
+      c = compare(key, node->key, context);                                                    \
+      if ((c < 0) || ((c == 0) && inclusive))                                                  \
+      {                                                                                        \
+        best = node;                                                                           \
+        if (c == 0)                                                                            \
+          break;                                                                               \
+        node = node->left;                                                                     \
+      }                                                                                        \
+      else                                                                                     \
+      {                                                                                        \
+        node = node->right;                                                                    \
+      }                                                                                        \
+    }                                                                                          \
+    return best;                                                                               \
+  }                                                                                            \
+                                                                                               \
+  /* Returns the node with the largest key less than or equal to                               \
+     key (inclusive) resp. strictly less than key, or NULL. */                                 \
+  static inline prefix##_node_t __##prefix##_last_before(prefix##_node_t node,                 \
+                                                         key_type key,                         \
+                                                         int inclusive,                        \
+                                                         context_type context)                 \
+  {                                                                                            \
+    prefix##_node_t best = NULL;                                                               \
+    int c;                                                                                     \
+    while (node != NULL)                                                                       \
+    {                                                                                          \
+      c = compare(key, node->key, context);                                                    \
+      if ((c > 0) || ((c == 0) && inclusive))                                                  \
+      {                                                                                        \
+        best = node;                                                                           \
+        if (c == 0)                                                                            \
+          break;                                                                               \
+        node = node->right;                                                                    \
+      }                                                                                        \
+      else                                                                                     \
+      {                                                                                        \
+        node = node->left;                                                                     \
+      }                                                                                        \
+    }                                                                                          \
+    return best;                                                                               \
+  }                                                                                            \
+                                                                                               \
+  /* Descends once from node x looking for key. Returns the node                               \
+     holding the key if there is one. Otherwise returns NULL and sets                          \
+     *parent and *side to the node a new entry has to be linked to                             \
+     and the side it goes on. */                                                               \
+  static inline prefix##_node_t __##prefix##_locate_from(prefix##_node_t *parent,              \
+                                                         int *side,                            \
+                                                         prefix##_node_t x,                    \
+                                                         key_type key,                         \
+                                                         context_type context)                 \
+  {                                                                                            \
+    prefix##_node_t y = NULL;                                                                  \
+    int c = 0;                                                                                 \
+    while (x != NULL)                                                                          \
+    {                                                                                          \
+      c = compare(key, x->key, context);                                                       \
+      if (c == 0)                                                                              \
+        return x;                                                                              \
+      y = x;                                                                                   \
+      x = (c < 0) ? x->left : x->right;                                                        \
+    }                                                                                          \
+    *parent = y;                                                                               \
+    *side = c;                                                                                 \
+    return NULL;                                                                               \
+  }                                                                                            \
+                                                                                               \
+  static inline size_t __##prefix##_height_aux(prefix##_node_t node)                           \
+  {                                                                                            \
+    size_t l, r;                                                                               \
+    if (node == NULL)                                                                          \
+      return ((size_t)0);                                                                      \
+    l = __##prefix##_height_aux(node->left);                                                   \
+    r = __##prefix##_height_aux(node->right);                                                  \
+    return ((l > r) ? l : r) + ((size_t)1);                                                    \
+  }                                                                                            \
+                                                                                               \
+  /* Every root-to-leaf path has the same number of black nodes, so                            \
+     following the left spine is enough. */                                                    \
+  static inline size_t __##prefix##_black_height_aux(prefix##_node_t node)                     \
+  {                                                                                            \
+    size_t bh = (size_t)0;                                                                     \
+    for (; node != NULL; node = node->left)                                                    \
+    {                                                                                          \
+      if (__##prefix##_color(node) == RB_TREE_BLACK)                                           \
+        bh++;                                                                                  \
+    }                                                                                          \
+    return bh;                                                                                 \
+  }
+
+
+#define RB_TREE_DEFINE(prefix, key_type, value_type, cmp)                                      \
+                                                                                               \
+  RB_TREE_DEFINE_NODE(prefix, key_type, value_type)                                            \
+                                                                                               \
+  typedef struct prefix##_slab_struct_t *prefix##_slab_t;                                      \
+  struct prefix##_slab_struct_t                                                                \
+  {                                                                                            \
+    prefix##_slab_t next;                                                                      \
+    size_t used;                                                                               \
+    struct prefix##_node_struct_t nodes[RB_TREE_NODES_PER_SLAB];                               \
+  };                                                                                           \
+                                                                                               \
+  typedef struct prefix##_struct_t *prefix##_t;                                                \
+  struct prefix##_struct_t                                                                     \
+  {                                                                                            \
+    prefix##_node_t root;                                                                      \
+    size_t number_entries;                                                                     \
+    prefix##_slab_t slabs;                                                                     \
+    prefix##_node_t free_list; /* linked through left */                                       \
+  };                                                                                           \
+                                                                                               \
+  static inline int __##prefix##_compare(key_type a, key_type b, int context)                  \
+  {                                                                                            \
+    (void)context;                                                                             \
+    return cmp(a, b);                                                                          \
+  }                                                                                            \
+                                                                                               \
+  RB_TREE_DEFINE_CORE(prefix, prefix##_t, key_type,                                            \
+                      __##prefix##_compare, int, RB_TREE_UNRANKED)                             \
+                                                                                               \
+  static inline prefix##_t prefix##_create(void)                                               \
+  {                                                                                            \
+    prefix##_t tree;                                                                           \
+    tree = calloc(1, sizeof(*tree));                                                           \
+    if (tree == NULL)                                                                          \
+    {                                                                                          \
+      fprintf(stderr, "Error: no memory left.\n");                                             \
+      exit(1);                                                                                 \
+    }                                                                                          \
+    tree->root = NULL;                                                                         \
+    tree->number_entries = (size_t)0;                                                          \
+    tree->slabs = NULL;                                                                        \
+    tree->free_list = NULL;                                                                    \
+    return tree;                                                                               \
+  }                                                                                            \
+                                                                                               \
+  static inline void prefix##_delete(prefix##_t tree)                                          \
+  {                                                                                            \
+    prefix##_slab_t slab, next;                                                                \
+    for (slab = tree->slabs; slab != NULL; slab = next)                                        \
+    {                                                                                          \
+      next = slab->next;                                                                       \
+      free(slab);                                                                              \
+    }                                                                                          \
+    free(tree);                                                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline prefix##_node_t __##prefix##_node_alloc(prefix##_t tree)                       \
+  {                                                                                            \
+    prefix##_slab_t slab;                                                                      \
+    prefix##_node_t node;                                                                      \
+    if (tree->free_list != NULL)                                                               \
+    {                                                                                          \
+      node = tree->free_list;                                                                  \
+      tree->free_list = node->left;                                                            \
+      return node;                                                                             \
+    }                                                                                          \
+    slab = tree->slabs;                                                                        \
+    if ((slab == NULL) || (slab->used >= RB_TREE_NODES_PER_SLAB))                              \
+    {                                                                                          \
+      slab = malloc(sizeof(*slab));                                                            \
+      if (slab == NULL)                                                                        \
+      {                                                                                        \
+        fprintf(stderr, "Error: no memory left.\n");                                           \
+        exit(1);                                                                               \
+      }                                                                                        \
+      slab->next = tree->slabs;                                                                \
+      slab->used = (size_t)0;                                                                  \
+      tree->slabs = slab;                                                                      \
+    }                                                                                          \
+    return &slab->nodes[slab->used++];                                                         \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_node_free(prefix##_t tree, prefix##_node_t node)             \
+  {                                                                                            \
+    node->left = tree->free_list;                                                              \
+    tree->free_list = node;                                                                    \
+  }                                                                                            \
+                                                                                               \
+  static inline size_t prefix##_number_entries(prefix##_t tree)                                \
+  {                                                                                            \
+    return tree->number_entries;                                                               \
+  }                                                                                            \
+                                                                                               \
+  static inline size_t prefix##_height(prefix##_t tree)                                        \
+  {                                                                                            \
+    return __##prefix##_height_aux(tree->root);                                                \
+  }                                                                                            \
+                                                                                               \
+  static inline value_type *prefix##_search(prefix##_t tree, key_type key)                     \
+  {                                                                                            \
+    prefix##_node_t node;                                                                      \
+    node = __##prefix##_search_aux(tree->root, key, 0);                                        \
+    if (node == NULL)                                                                          \
+      return NULL;                                                                             \
+    return &node->value;                                                                       \
+  }                                                                                            \
+                                                                                               \
+  static inline void __##prefix##_report(key_type **found_key,                                 \
+                                         value_type **found_value,                             \
+                                         prefix##_node_t node)                                 \
+  {                                                                                            \
+    if (node == NULL)                                                                          \
+    {                                                                                          \
+      *found_key = NULL;                                                                       \
+      *found_value = NULL;                                                                     \
+      return;                                                                                  \
+    }                                                                                          \
+    *found_key = &node->key;                                                                   \
+    *found_value = &node->value;                                                               \
+  }                                                                                            \
+                                                                                               \
+  static inline void prefix##_minimum(key_type **min_key,                                      \
+                                      value_type **min_value,                                  \
+                                      prefix##_t tree)                                         \
+  {                                                                                            \
+    __##prefix##_report(min_key, min_value, __##prefix##_first(tree->root));                   \
+  }                                                                                            \
+                                                                                               \
+  static inline void prefix##_maximum(key_type **max_key,                                      \
+                                      value_type **max_value,                                  \
+                                      prefix##_t tree)                                         \
+  {                                                                                            \
+    __##prefix##_report(max_key, max_value, __##prefix##_last(tree->root));                    \
+  }                                                                                            \
+                                                                                               \
+  static inline void prefix##_predecessor(key_type **prec_key,                                 \
+                                          value_type **prec_value,                             \
+                                          prefix##_t tree,                                     \
+                                          key_type key)                                        \
+  {                                                                                            \
+    prefix##_node_t x;                                                                         \
+    x = __##prefix##_search_aux(tree->root, key, 0);                                           \
+    __##prefix##_report(prec_key, prec_value, (x == NULL) ? NULL : __##prefix##_prev(x));      \
+  }                                                                                            \
+                                                                                               \
+  static inline void prefix##_successor(key_type **succ_key,                                   \
+                                        value_type **succ_value,                               \
+                                        prefix##_t tree,                                       \
+                                        key_type key)                                          \
+  {                                                                                            \
+    prefix##_node_t x;                                                                         \
+    x = __##prefix##_search_aux(tree->root, key, 0);                                           \
+    __##prefix##_report(succ_key, succ_value, (x == NULL) ? NULL : __##prefix##_next(x));      \
+  }                                                                                            \
+                                                                                               \
+  static inline int prefix##_insert(prefix##_t tree, key_type key, value_type value)           \
+  {                                                                                            \
+    prefix##_node_t y, z;                                                                      \
+    int side;                                                                                  \
+    if (__##prefix##_locate_from(&y, &side, tree->root, key, 0) != NULL)                       \
+      return 0;                                                                                \
+    z = __##prefix##_node_alloc(tree);                                                         \
+    z->key = key;                                                                              \
+    z->value = value;                                                                          \
+    z->parent_color = (uintptr_t)0; /* red */                                                  \
+    z->left = NULL;                                                                            \
+    z->right = NULL;                                                                           \
+    __##prefix##_link(tree, z, y, side);                                                       \
+    tree->number_entries++;                                                                    \
+    return 1;                                                                                  \
+  }                                                                                            \
+                                                                                               \
+  static inline int prefix##_remove(prefix##_t tree, key_type key)                             \
+  {                                                                                            \
+    prefix##_node_t z;                                                                         \
+    z = __##prefix##_search_aux(tree->root, key, 0);                                           \
+    if (z == NULL)                                                                             \
+      return 0;                                                                                \
+    __##prefix##_detach(tree, z);                                                              \
+    tree->number_entries--;                                                                    \
+    __##prefix##_node_free(tree, z);                                                           \
+    return 1;                                                                                  \
+  }
+
+#endif
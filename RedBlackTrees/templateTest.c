@@ -0,0 +1,134 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "redblacktrees.h"
+#include "redblacktrees_template.h"
+
+#define MAX_VALUES 1000000
+#define NUM_LOOKUPS 2000000
+
+#define INT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+RB_TREE_DEFINE(int_tree, int, int, INT_CMP)
+
+int compare_int(void *a, void *b, void *data)
+{
+    int *ia = (int *)a;
+    int *ib = (int *)b;
+    return (*ia > *ib) - (*ia < *ib);
+}
+
+static void *copy_int(void *ptr, void *data)
+{
+    int *new_int = (int *)malloc(sizeof(int));
+    if (new_int == NULL)
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+    *new_int = *(int *)ptr;
+    return new_int;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int *lookups;
+
+// Looks every key up, counting the hits.
+static double time_void_tree(red_black_tree_t tree, long *hits)
+{
+    double start = now();
+    *hits = 0;
+    for (int i = 0; i < NUM_LOOKUPS; i++)
+    {
+        if (red_black_tree_search(tree, &lookups[i], compare_int, NULL) != NULL)
+            (*hits)++;
+    }
+    return now() - start;
+}
+
+static double time_int_tree(int_tree_t tree, long *hits)
+{
+    double start = now();
+    *hits = 0;
+    for (int i = 0; i < NUM_LOOKUPS; i++)
+    {
+        if (int_tree_search(tree, lookups[i]) != NULL)
+            (*hits)++;
+    }
+    return now() - start;
+}
+
+static void delete_int(void *ptr, void *data)
+{
+    free(ptr);
+}
+
+// Times the lookups against trees of n keys, one line per tree.
+static void run(FILE *outputFile, int n)
+{
+    red_black_tree_t plain = red_black_tree_create();
+    red_black_tree_t inlined = red_black_tree_create_inline(sizeof(int), sizeof(int), 0);
+    int_tree_t typed = int_tree_create();
+
+    // Half of the lookups miss.
+    for (int i = 0; i < n; i++)
+    {
+        int key = rand() % (2 * n);
+        red_black_tree_insert(plain, &key, &key, compare_int, copy_int, copy_int, NULL);
+        red_black_tree_insert(inlined, &key, &key, compare_int, NULL, NULL, NULL);
+        int_tree_insert(typed, key, key);
+    }
+    for (int i = 0; i < NUM_LOOKUPS; i++)
+        lookups[i] = rand() % (2 * n);
+
+    printf("Looking up %d keys in %zu entries.\n", NUM_LOOKUPS, int_tree_number_entries(typed));
+
+    long hits;
+    double elapsed = time_void_tree(plain, &hits);
+    printf("  red_black_tree_search, copied keys: %.2f M lookups/s, %ld hits\n", NUM_LOOKUPS / elapsed / 1e6, hits);
+    fprintf(outputFile, "%d,void * copied,%.0f\n", n, NUM_LOOKUPS / elapsed);
+
+    elapsed = time_void_tree(inlined, &hits);
+    printf("  red_black_tree_search, inline keys: %.2f M lookups/s, %ld hits\n", NUM_LOOKUPS / elapsed / 1e6, hits);
+    fprintf(outputFile, "%d,void * inline,%.0f\n", n, NUM_LOOKUPS / elapsed);
+
+    elapsed = time_int_tree(typed, &hits);
+    printf("  int_tree_search: %.2f M lookups/s, %ld hits\n", NUM_LOOKUPS / elapsed / 1e6, hits);
+    fprintf(outputFile, "%d,RB_TREE_DEFINE int,%.0f\n", n, NUM_LOOKUPS / elapsed);
+
+    red_black_tree_delete(plain, delete_int, delete_int, NULL);
+    red_black_tree_delete(inlined, NULL, NULL, NULL);
+    int_tree_delete(typed);
+}
+
+int main()
+{
+    lookups = (int *)malloc(NUM_LOOKUPS * sizeof(int));
+    if (lookups == NULL)
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+
+    srand(time(NULL));
+
+    FILE *outputFile = fopen("RB_template_data.csv", "w");
+
+    fprintf(outputFile, "Number of Entries,Tree,Lookups per s\n");
+
+    // From trees that stay in cache, where the comparison calls show,
+    // to trees where cache misses dominate.
+    for (int n = 1000; n <= MAX_VALUES; n *= 10)
+        run(outputFile, n);
+
+    fclose(outputFile);
+    free(lookups);
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "redblacktrees.h"
+
+#define NUM_BASE 2000000
+#define NUM_DELTA 200000
+#define MAX_THREADS 8
+
+int compare_int(void *a, void *b, void *data)
+{
+    int *ia = (int *)a;
+    int *ib = (int *)b;
+    return (*ia > *ib) - (*ia < *ib);
+}
+
+// Values of the delta replace those of the base.
+static void take_delta(void *key, void *value, void *delta_value, void *data)
+{
+    *(int *)value = *(int *)delta_value;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int *base_keys;
+static int *delta_keys;
+
+static red_black_tree_t build(int *keys, int n)
+{
+    red_black_tree_t tree = red_black_tree_create_inline(sizeof(int), sizeof(int), 0);
+    for (int i = 0; i < n; i++)
+        red_black_tree_insert(tree, &keys[i], &keys[i], compare_int, NULL, NULL, NULL);
+    return tree;
+}
+
+// Merges the delta one insert at a time, as done before set operations.
+static double run_inserts()
+{
+    red_black_tree_t base = build(base_keys, NUM_BASE);
+
+    double start = now();
+    for (int i = 0; i < NUM_DELTA; i++)
+    {
+        int *value;
+        if (!red_black_tree_insert_or_get((void **)&value, base, &delta_keys[i], &delta_keys[i],
+                                          compare_int, NULL, NULL, NULL))
+            *value = delta_keys[i];
+    }
+    double elapsed = now() - start;
+
+    red_black_tree_delete(base, NULL, NULL, NULL);
+    return elapsed;
+}
+
+static double run_union(int workers)
+{
+    red_black_tree_t base = build(base_keys, NUM_BASE);
+    red_black_tree_t delta = build(delta_keys, NUM_DELTA);
+    red_black_tree_pool_t pool = red_black_tree_pool_create((size_t)workers);
+
+    double start = now();
+    red_black_tree_union(base, delta, compare_int, take_delta, NULL, NULL, pool, NULL);
+    double elapsed = now() - start;
+
+    red_black_tree_pool_delete(pool);
+    red_black_tree_delete(base, NULL, NULL, NULL);
+    return elapsed;
+}
+
+int main()
+{
+    base_keys = (int *)malloc(NUM_BASE * sizeof(int));
+    delta_keys = (int *)malloc(NUM_DELTA * sizeof(int));
+    if ((base_keys == NULL) || (delta_keys == NULL))
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+
+    srand(time(NULL));
+    for (int i = 0; i < NUM_BASE; i++)
+        base_keys[i] = rand();
+    for (int i = 0; i < NUM_DELTA; i++)
+        delta_keys[i] = rand();
+
+    printf("Merging %d delta keys into %d base keys.\n", NUM_DELTA, NUM_BASE);
+
+    FILE *outputFile = fopen("RB_union_data.csv", "w");
+
+    fprintf(outputFile, "Threads,Inserts s,Union s\n");
+
+    double inserts = run_inserts();
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        double merged = run_union(threads - 1);
+
+        printf("%d threads: inserts %.3f s, union %.3f s\n", threads, inserts, merged);
+        fprintf(outputFile, "%d,%.3f,%.3f\n", threads, inserts, merged);
+    }
+
+    fclose(outputFile);
+    free(base_keys);
+    free(delta_keys);
+
+    return 0;
+}
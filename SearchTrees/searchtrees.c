@@ -1,6 +1,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 typedef struct __tree_node_struct_t *tree_node_t;
 struct __tree_node_struct_t
@@ -12,13 +13,209 @@ struct __tree_node_struct_t
   tree_node_t right;
 };
 
+#define SEARCH_TREE_DEFAULT_NODES_PER_SLAB ((size_t)1024)
+
+/* Number of lookups search_tree_search_batch advances in lockstep. */
+#define SEARCH_TREE_SEARCH_GROUP ((size_t)16)
+
+/* Weight balance factor of SEARCH_TREE_MODE_SCAPEGOAT, between 1/2
+   and 1. Lower values keep the tree flatter at the price of more
+   frequent rebuilds.
+*/
+#define SEARCH_TREE_SCAPEGOAT_ALPHA (0.7)
+
+#if defined(__GNUC__)
+#define __prefetch(address) __builtin_prefetch(address)
+#else
+#define __prefetch(address) ((void)(address))
+#endif
+
+typedef struct __node_slab_struct_t *node_slab_t;
+struct __node_slab_struct_t
+{
+  node_slab_t next;
+  size_t capacity;
+  size_t used;
+  struct __tree_node_struct_t nodes[];
+};
+
+typedef struct __node_arena_struct_t *node_arena_t;
+struct __node_arena_struct_t
+{
+  node_slab_t slabs;
+  tree_node_t free_list;
+  size_t node_size;
+  size_t nodes_per_slab;
+  size_t number_slabs;
+  size_t nodes_reserved;
+  size_t nodes_in_use;
+};
+
 struct __search_tree_struct_t
 {
   tree_node_t root;
+  node_arena_t arena;
+  size_t number_entries;
+  size_t max_depth;
+  size_t max_entries;
+  int mode;
+  int inline_entries;
+  size_t key_size;
+  size_t value_size;
 };
 
 #include "searchtrees.h"
 
+static size_t __align_up(size_t n)
+{
+  size_t a;
+
+  a = sizeof(void *);
+  return ((n + a - ((size_t)1)) / a) * a;
+}
+
+static node_arena_t __node_arena_create(size_t nodes_per_slab,
+                                        size_t node_size)
+{
+  node_arena_t arena;
+
+  arena = calloc(1, sizeof(*arena));
+  if (arena == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  if (nodes_per_slab == ((size_t)0))
+    nodes_per_slab = SEARCH_TREE_DEFAULT_NODES_PER_SLAB;
+  arena->slabs = NULL;
+  arena->free_list = NULL;
+  arena->node_size = node_size;
+  arena->nodes_per_slab = nodes_per_slab;
+  return arena;
+}
+
+static void __node_arena_delete(node_arena_t arena)
+{
+  node_slab_t slab, next;
+
+  for (slab = arena->slabs; slab != NULL; slab = next)
+  {
+    next = slab->next;
+    free(slab);
+  }
+  free(arena);
+}
+
+static void __node_arena_reset(node_arena_t arena)
+{
+  node_slab_t slab, next, keep;
+
+  keep = arena->slabs;
+  for (slab = arena->slabs; slab != NULL; slab = slab->next)
+  {
+    if (slab->capacity > keep->capacity)
+      keep = slab;
+  }
+  for (slab = arena->slabs; slab != NULL; slab = next)
+  {
+    next = slab->next;
+    if (slab != keep)
+      free(slab);
+  }
+
+  arena->slabs = keep;
+  arena->free_list = NULL;
+  arena->number_slabs = (size_t)0;
+  arena->nodes_reserved = (size_t)0;
+  arena->nodes_in_use = (size_t)0;
+  if (keep != NULL)
+  {
+    keep->next = NULL;
+    keep->used = (size_t)0;
+    arena->number_slabs = (size_t)1;
+    arena->nodes_reserved = keep->capacity;
+  }
+}
+
+static node_slab_t __node_arena_grow(node_arena_t arena,
+                                     size_t capacity)
+{
+  node_slab_t slab;
+
+  slab = malloc(sizeof(*slab) + capacity * arena->node_size);
+  if (slab == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  slab->next = arena->slabs;
+  slab->capacity = capacity;
+  slab->used = (size_t)0;
+  arena->slabs = slab;
+  arena->number_slabs++;
+  arena->nodes_reserved += capacity;
+  return slab;
+}
+
+static tree_node_t __node_arena_alloc(node_arena_t arena)
+{
+  node_slab_t slab;
+  tree_node_t node;
+
+  if (arena->free_list != NULL)
+  {
+    node = arena->free_list;
+    arena->free_list = node->left;
+    arena->nodes_in_use++;
+    return node;
+  }
+
+  slab = arena->slabs;
+  if ((slab == NULL) || (slab->used >= slab->capacity))
+    slab = __node_arena_grow(arena, arena->nodes_per_slab);
+
+  node = (tree_node_t)(((unsigned char *)slab->nodes) +
+                       slab->used * arena->node_size);
+  slab->used++;
+  arena->nodes_in_use++;
+  return node;
+}
+
+static void __node_arena_free(node_arena_t arena,
+                              tree_node_t node)
+{
+  node->left = arena->free_list;
+  arena->free_list = node;
+  arena->nodes_in_use--;
+}
+
+static tree_node_t __search_tree_node_alloc(search_tree_t tree)
+{
+  tree_node_t node;
+
+  if (tree->arena != NULL)
+    return __node_arena_alloc(tree->arena);
+
+  node = calloc(1, sizeof(*node));
+  if (node == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  return node;
+}
+
+static void __search_tree_node_free(search_tree_t tree,
+                                    tree_node_t node)
+{
+  if (tree->arena != NULL)
+  {
+    __node_arena_free(tree->arena, node);
+    return;
+  }
+  free(node);
+}
+
 search_tree_t search_tree_create()
 {
   search_tree_t tree;
@@ -30,24 +227,329 @@ search_tree_t search_tree_create()
     exit(1);
   }
   tree->root = NULL;
+  tree->arena = NULL;
+  tree->number_entries = (size_t)0;
+  tree->max_depth = (size_t)0;
+  tree->max_entries = (size_t)0;
+  tree->mode = SEARCH_TREE_MODE_PLAIN;
+  tree->inline_entries = 0;
+  tree->key_size = (size_t)0;
+  tree->value_size = (size_t)0;
   return tree;
 }
 
-static void __search_tree_delete_aux(tree_node_t node,
-                                     void (*delete_key)(void *, void *),
-                                     void (*delete_value)(void *, void *),
-                                     void *data)
+search_tree_t search_tree_create_with_allocator(size_t nodes_per_slab)
 {
+  search_tree_t tree;
 
-  if (node == NULL)
+  tree = search_tree_create();
+  tree->arena = __node_arena_create(nodes_per_slab,
+                                    sizeof(struct __tree_node_struct_t));
+  return tree;
+}
+
+search_tree_t search_tree_create_inline(size_t key_size,
+                                        size_t value_size,
+                                        size_t nodes_per_slab)
+{
+  search_tree_t tree;
+  size_t node_size;
+
+  node_size = sizeof(struct __tree_node_struct_t) +
+              __align_up(key_size) +
+              __align_up(value_size);
+
+  tree = search_tree_create();
+  tree->arena = __node_arena_create(nodes_per_slab, node_size);
+  tree->inline_entries = 1;
+  tree->key_size = key_size;
+  tree->value_size = value_size;
+  return tree;
+}
+
+/* Rotates x above its parent, keeping the in-order sequence. */
+static void __search_tree_rotate_up(search_tree_t tree,
+                                    tree_node_t x)
+{
+  tree_node_t p, g;
+
+  p = x->parent;
+  g = p->parent;
+  if (x == p->left)
+  {
+    p->left = x->right;
+    if (x->right != NULL)
+      x->right->parent = p;
+    x->right = p;
+  }
+  else
+  {
+    p->right = x->left;
+    if (x->left != NULL)
+      x->left->parent = p;
+    x->left = p;
+  }
+  p->parent = x;
+  x->parent = g;
+  if (g == NULL)
+  {
+    tree->root = x;
+  }
+  else
+  {
+    if (g->left == p)
+    {
+      g->left = x;
+    }
+    else
+    {
+      g->right = x;
+    }
+  }
+}
+
+/* Moves x up to the root by zig-zig and zig-zag steps, plus a
+   final zig if x started at odd depth. Rotating the parent first
+   on a zig-zig is what roughly halves the depth of the nodes along
+   the access path and gives the amortized bound.
+*/
+static void __search_tree_splay(search_tree_t tree,
+                                tree_node_t x)
+{
+  tree_node_t p, g;
+
+  while ((p = x->parent) != NULL)
+  {
+    g = p->parent;
+    if (g == NULL)
+    {
+      __search_tree_rotate_up(tree, x);
+    }
+    else
+    {
+      if ((g->left == p) == (p->left == x))
+      {
+        __search_tree_rotate_up(tree, p);
+        __search_tree_rotate_up(tree, x);
+      }
+      else
+      {
+        __search_tree_rotate_up(tree, x);
+        __search_tree_rotate_up(tree, x);
+      }
+    }
+  }
+}
+
+static void __search_tree_store_entry(search_tree_t tree,
+                                      tree_node_t node,
+                                      void *key,
+                                      void *value,
+                                      void *(*copy_key)(void *, void *),
+                                      void *(*copy_value)(void *, void *),
+                                      void *data)
+{
+  if (tree->inline_entries)
+  {
+    node->key = (void *)(node + 1);
+    node->value = (void *)(((unsigned char *)node->key) +
+                           __align_up(tree->key_size));
+    memcpy(node->key, key, tree->key_size);
+    memcpy(node->value, value, tree->value_size);
     return;
-  __search_tree_delete_aux(node->left,
-                           delete_key, delete_value, data);
-  __search_tree_delete_aux(node->right,
-                           delete_key, delete_value, data);
-  delete_key(node->key, data);
-  delete_value(node->value, data);
-  free(node);
+  }
+  node->key = copy_key(key, data);
+  node->value = copy_value(value, data);
+}
+
+static void __search_tree_release_entry(search_tree_t tree,
+                                        tree_node_t node,
+                                        void (*delete_key)(void *, void *),
+                                        void (*delete_value)(void *, void *),
+                                        void *data)
+{
+  if (tree->inline_entries)
+    return;
+  if (delete_key != NULL)
+    delete_key(node->key, data);
+  if (delete_value != NULL)
+    delete_value(node->value, data);
+}
+
+void search_tree_allocator_stats(search_tree_allocator_stats_t *stats,
+                                 search_tree_t tree)
+{
+  node_arena_t arena;
+
+  arena = tree->arena;
+  if (arena == NULL)
+  {
+    stats->node_size = sizeof(struct __tree_node_struct_t);
+    stats->number_slabs = (size_t)0;
+    stats->nodes_per_slab = (size_t)0;
+    stats->nodes_reserved = (size_t)0;
+    stats->nodes_in_use = (size_t)0;
+    stats->nodes_free = (size_t)0;
+    stats->bytes_reserved = (size_t)0;
+    return;
+  }
+  stats->node_size = arena->node_size;
+  stats->number_slabs = arena->number_slabs;
+  stats->nodes_per_slab = arena->nodes_per_slab;
+  stats->nodes_reserved = arena->nodes_reserved;
+  stats->nodes_in_use = arena->nodes_in_use;
+  stats->nodes_free = arena->nodes_reserved - arena->nodes_in_use;
+  stats->bytes_reserved = arena->number_slabs * sizeof(struct __node_slab_struct_t) +
+                          arena->nodes_reserved * arena->node_size;
+}
+
+static tree_node_t __search_tree_build_aux(search_tree_t tree,
+                                           void **keys,
+                                           void **values,
+                                           size_t lo,
+                                           size_t hi,
+                                           tree_node_t parent,
+                                           void *(*copy_key)(void *, void *),
+                                           void *(*copy_value)(void *, void *),
+                                           void *data)
+{
+  tree_node_t node;
+  size_t mid;
+
+  if (lo >= hi)
+    return NULL;
+
+  mid = lo + (hi - lo) / ((size_t)2);
+  node = __node_arena_alloc(tree->arena);
+  __search_tree_store_entry(tree,
+                            node,
+                            keys[mid],
+                            values[mid],
+                            copy_key,
+                            copy_value,
+                            data);
+  node->parent = parent;
+  node->left = __search_tree_build_aux(tree,
+                                       keys,
+                                       values,
+                                       lo,
+                                       mid,
+                                       node,
+                                       copy_key,
+                                       copy_value,
+                                       data);
+  node->right = __search_tree_build_aux(tree,
+                                        keys,
+                                        values,
+                                        mid + ((size_t)1),
+                                        hi,
+                                        node,
+                                        copy_key,
+                                        copy_value,
+                                        data);
+  return node;
+}
+
+search_tree_t search_tree_build_sorted(void **keys,
+                                       void **values,
+                                       size_t n,
+                                       void *(*copy_key)(void *, void *),
+                                       void *(*copy_value)(void *, void *),
+                                       void *data)
+{
+  search_tree_t tree;
+  size_t height;
+
+  tree = search_tree_create_with_allocator((size_t)0);
+  if (n == ((size_t)0))
+    return tree;
+  __node_arena_grow(tree->arena, n);
+
+  tree->root = __search_tree_build_aux(tree,
+                                       keys,
+                                       values,
+                                       (size_t)0,
+                                       n,
+                                       NULL,
+                                       copy_key,
+                                       copy_value,
+                                       data);
+  for (height = (size_t)1; (n >> height) > ((size_t)0); height++)
+    ;
+  tree->number_entries = n;
+  tree->max_depth = height;
+  tree->max_entries = n;
+  return tree;
+}
+
+static void __search_tree_clear_aux(search_tree_t tree,
+                                    void (*delete_key)(void *, void *),
+                                    void (*delete_value)(void *, void *),
+                                    void *data)
+{
+  tree_node_t node, parent;
+
+  if ((tree->arena != NULL) &&
+      (tree->inline_entries ||
+       ((delete_key == NULL) && (delete_value == NULL))))
+  {
+    __node_arena_reset(tree->arena);
+    tree->root = NULL;
+    tree->number_entries = (size_t)0;
+    tree->max_depth = (size_t)0;
+    tree->max_entries = (size_t)0;
+    return;
+  }
+
+  /* Post-order walk through the parent pointers: go down to a
+     leaf, unhook it from its parent, release it and climb back.
+     Constant extra memory, even on a degenerate tree.
+  */
+  node = tree->root;
+  while (node != NULL)
+  {
+    if (node->left != NULL)
+    {
+      node = node->left;
+    }
+    else
+    {
+      if (node->right != NULL)
+      {
+        node = node->right;
+      }
+      else
+      {
+        parent = node->parent;
+        if (parent != NULL)
+        {
+          if (parent->left == node)
+          {
+            parent->left = NULL;
+          }
+          else
+          {
+            parent->right = NULL;
+          }
+        }
+        __search_tree_release_entry(tree,
+                                    node,
+                                    delete_key,
+                                    delete_value,
+                                    data);
+        if (tree->arena == NULL)
+          free(node);
+        node = parent;
+      }
+    }
+  }
+
+  if (tree->arena != NULL)
+    __node_arena_reset(tree->arena);
+  tree->root = NULL;
+  tree->number_entries = (size_t)0;
+  tree->max_depth = (size_t)0;
+  tree->max_entries = (size_t)0;
 }
 
 void search_tree_delete(search_tree_t tree,
@@ -55,44 +557,96 @@ void search_tree_delete(search_tree_t tree,
                         void (*delete_value)(void *, void *),
                         void *data)
 {
-  __search_tree_delete_aux(tree->root,
-                           delete_key,
-                           delete_value,
-                           data);
+  __search_tree_clear_aux(tree,
+                          delete_key,
+                          delete_value,
+                          data);
+  if (tree->arena != NULL)
+    __node_arena_delete(tree->arena);
   free(tree);
 }
 
-static size_t __search_tree_number_entries_aux(tree_node_t node)
+void search_tree_clear(search_tree_t tree,
+                       void (*delete_key)(void *, void *),
+                       void (*delete_value)(void *, void *),
+                       void *data)
 {
-  size_t l, r, n;
-
-  if (node == NULL)
-    return ((size_t)0);
-
-  l = __search_tree_number_entries_aux(node->left);
-  r = __search_tree_number_entries_aux(node->right);
-
-  n = (l + r) + ((size_t)1);
-
-  return n;
+  __search_tree_clear_aux(tree,
+                          delete_key,
+                          delete_value,
+                          data);
 }
 
 size_t search_tree_number_entries(search_tree_t tree)
 {
-  return __search_tree_number_entries_aux(tree->root);
+  return tree->number_entries;
 }
 
-static size_t __search_tree_height_aux(tree_node_t node)
+/* Returns floor(log(n) / log(1 / alpha)), the depth beyond which a
+   scapegoat tree holding n entries gets rebuilt, or zero if n is
+   zero.
+*/
+static size_t __search_tree_scapegoat_depth(size_t n)
 {
-  size_t l, r, h;
-
-  if (node == NULL)
-    return ((size_t)0);
+  double x;
+  size_t d;
+
+  d = (size_t)0;
+  for (x = 1.0 / SEARCH_TREE_SCAPEGOAT_ALPHA;
+       x <= ((double)n);
+       x /= SEARCH_TREE_SCAPEGOAT_ALPHA)
+    d++;
+  return d;
+}
 
-  l = __search_tree_height_aux(node->left);
-  r = __search_tree_height_aux(node->right);
+/* Walks the tree through the parent pointers, keeping track of
+   where it came from, so the height of a degenerate tree can be
+   taken without recursing once per level.
+*/
+static size_t __search_tree_height_aux(tree_node_t node)
+{
+  tree_node_t prev, next;
+  size_t depth, h;
 
-  h = ((l > r) ? l : r) + ((size_t)1);
+  h = (size_t)0;
+  depth = (size_t)0;
+  prev = (node == NULL) ? NULL : node->parent;
+  while (node != NULL)
+  {
+    if (prev == node->parent)
+    {
+      depth++;
+      if (depth > h)
+        h = depth;
+      if (node->left != NULL)
+      {
+        next = node->left;
+      }
+      else
+      {
+        next = (node->right != NULL) ? node->right : node->parent;
+      }
+    }
+    else
+    {
+      if ((prev == node->left) && (node->right != NULL))
+      {
+        next = node->right;
+      }
+      else
+      {
+        next = node->parent;
+      }
+    }
+    if (next == node->parent)
+    {
+      depth--;
+      if (depth == ((size_t)0))
+        break;
+    }
+    prev = node;
+    node = next;
+  }
 
   return h;
 }
@@ -102,6 +656,44 @@ size_t search_tree_height(search_tree_t tree)
   return __search_tree_height_aux(tree->root);
 }
 
+void search_tree_height_bounds(size_t *min_height,
+                               size_t *max_height,
+                               search_tree_t tree)
+{
+  size_t n, lo;
+
+  n = tree->number_entries;
+  if (n == ((size_t)0))
+  {
+    *min_height = (size_t)0;
+    *max_height = (size_t)0;
+    return;
+  }
+
+  if (tree->mode == SEARCH_TREE_MODE_SPLAY)
+  {
+    *max_height = n;
+  }
+  else
+  {
+    /* Removals and rebuilds never make a node deeper than the
+       deepest one, so the deepest insertion seen since the tree
+       was last empty bounds the height from above.
+    */
+    *max_height = tree->max_depth;
+    if (tree->mode == SEARCH_TREE_MODE_SCAPEGOAT)
+    {
+      lo = __search_tree_scapegoat_depth(tree->max_entries) + ((size_t)2);
+      if (lo < *max_height)
+        *max_height = lo;
+    }
+  }
+
+  for (lo = (size_t)1; n > ((size_t)1); n >>= 1)
+    lo++;
+  *min_height = lo;
+}
+
 static tree_node_t __search_tree_search_aux(tree_node_t node,
                                             void *key,
                                             int (*compare_key)(void *, void *, void *),
@@ -109,22 +701,213 @@ static tree_node_t __search_tree_search_aux(tree_node_t node,
 {
   int cmp;
 
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if (cmp == 0)
+      return node;
+    if (cmp < 0)
+    {
+      node = node->left;
+    }
+    else
+    {
+      node = node->right;
+    }
+  }
+  return NULL;
+}
+
+static tree_node_t __search_tree_first_after(tree_node_t node,
+                                             void *key,
+                                             int inclusive,
+                                             int (*compare_key)(void *, void *, void *),
+                                             void *data)
+{
+  tree_node_t best;
+  int cmp;
+
+  best = NULL;
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if ((cmp < 0) || ((cmp == 0) && inclusive))
+    {
+      best = node;
+      if (cmp == 0)
+        break;
+      node = node->left;
+    }
+    else
+    {
+      node = node->right;
+    }
+  }
+  return best;
+}
+
+static tree_node_t __search_tree_last_before(tree_node_t node,
+                                             void *key,
+                                             int inclusive,
+                                             int (*compare_key)(void *, void *, void *),
+                                             void *data)
+{
+  tree_node_t best;
+  int cmp;
+
+  best = NULL;
+  while (node != NULL)
+  {
+    cmp = compare_key(key, node->key, data);
+    if ((cmp > 0) || ((cmp == 0) && inclusive))
+    {
+      best = node;
+      if (cmp == 0)
+        break;
+      node = node->right;
+    }
+    else
+    {
+      node = node->left;
+    }
+  }
+  return best;
+}
+
+static void __search_tree_report(void **found_key,
+                                 void **found_value,
+                                 search_tree_position_t *position,
+                                 tree_node_t node)
+{
+  if (position != NULL)
+    *position = (search_tree_position_t)node;
   if (node == NULL)
-    return NULL;
+  {
+    *found_key = NULL;
+    *found_value = NULL;
+    return;
+  }
+  *found_key = node->key;
+  *found_value = node->value;
+}
 
-  cmp = compare_key(key, node->key, data);
+void search_tree_lower_bound(void **found_key,
+                             void **found_value,
+                             search_tree_position_t *position,
+                             search_tree_t tree,
+                             void *key,
+                             int (*compare_key)(void *, void *, void *),
+                             void *data)
+{
+  __search_tree_report(found_key,
+                       found_value,
+                       position,
+                       __search_tree_first_after(tree->root,
+                                                 key,
+                                                 1,
+                                                 compare_key,
+                                                 data));
+}
 
-  if (cmp == 0)
-    return node;
-  if (cmp < 0)
-    return __search_tree_search_aux(node->left,
-                                    key,
-                                    compare_key,
-                                    data);
-  return __search_tree_search_aux(node->right,
-                                  key,
-                                  compare_key,
-                                  data);
+void search_tree_upper_bound(void **found_key,
+                             void **found_value,
+                             search_tree_position_t *position,
+                             search_tree_t tree,
+                             void *key,
+                             int (*compare_key)(void *, void *, void *),
+                             void *data)
+{
+  __search_tree_report(found_key,
+                       found_value,
+                       position,
+                       __search_tree_first_after(tree->root,
+                                                 key,
+                                                 0,
+                                                 compare_key,
+                                                 data));
+}
+
+void search_tree_floor(void **found_key,
+                       void **found_value,
+                       search_tree_position_t *position,
+                       search_tree_t tree,
+                       void *key,
+                       int (*compare_key)(void *, void *, void *),
+                       void *data)
+{
+  __search_tree_report(found_key,
+                       found_value,
+                       position,
+                       __search_tree_last_before(tree->root,
+                                                 key,
+                                                 1,
+                                                 compare_key,
+                                                 data));
+}
+
+void search_tree_ceiling(void **found_key,
+                         void **found_value,
+                         search_tree_position_t *position,
+                         search_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data)
+{
+  search_tree_lower_bound(found_key,
+                          found_value,
+                          position,
+                          tree,
+                          key,
+                          compare_key,
+                          data);
+}
+
+void *search_tree_position_key(search_tree_position_t position)
+{
+  return ((tree_node_t)position)->key;
+}
+
+void *search_tree_position_value(search_tree_position_t position)
+{
+  return ((tree_node_t)position)->value;
+}
+
+static tree_node_t __search_tree_locate(tree_node_t *parent,
+                                        int *cmp,
+                                        size_t *depth,
+                                        search_tree_t tree,
+                                        void *key,
+                                        int (*compare_key)(void *, void *, void *),
+                                        void *data)
+{
+  tree_node_t x, y;
+  size_t d;
+  int c;
+
+  c = 0;
+  d = (size_t)1;
+  y = NULL;
+  x = tree->root;
+  while (x != NULL)
+  {
+    c = compare_key(key, x->key, data);
+    if (c == 0)
+      return x;
+    d++;
+    y = x;
+    if (c < 0)
+    {
+      x = x->left;
+    }
+    else
+    {
+      x = x->right;
+    }
+  }
+  *parent = y;
+  *cmp = c;
+  *depth = d;
+  return NULL;
 }
 
 void *search_tree_search(search_tree_t tree,
@@ -132,7 +915,26 @@ void *search_tree_search(search_tree_t tree,
                          int (*compare_key)(void *, void *, void *),
                          void *data)
 {
-  tree_node_t node;
+  tree_node_t node, parent;
+  size_t depth;
+  int cmp;
+
+  if (tree->mode == SEARCH_TREE_MODE_SPLAY)
+  {
+    node = __search_tree_locate(&parent, &cmp, &depth,
+                                tree,
+                                key,
+                                compare_key,
+                                data);
+    if (node == NULL)
+    {
+      if (parent != NULL)
+        __search_tree_splay(tree, parent);
+      return NULL;
+    }
+    __search_tree_splay(tree, node);
+    return node->value;
+  }
 
   node = __search_tree_search_aux(tree->root,
                                   key,
@@ -143,6 +945,72 @@ void *search_tree_search(search_tree_t tree,
   return node->value;
 }
 
+/* Same scheme as red_black_tree_search_batch: lookups run in groups,
+   one step per lookup and round, with the keys of the current nodes
+   prefetched before the comparisons and the next nodes prefetched
+   right after.
+*/
+void search_tree_search_batch(void **values,
+                              search_tree_t tree,
+                              void **keys,
+                              size_t n,
+                              int (*compare_key)(void *, void *, void *),
+                              void *data)
+{
+  tree_node_t nodes[SEARCH_TREE_SEARCH_GROUP];
+  size_t start, group, i, active;
+  int cmp;
+
+  for (start = 0; start < n; start += group)
+  {
+    group = n - start;
+    if (group > SEARCH_TREE_SEARCH_GROUP)
+      group = SEARCH_TREE_SEARCH_GROUP;
+
+    for (i = 0; i < group; i++)
+    {
+      nodes[i] = tree->root;
+      values[start + i] = NULL;
+    }
+
+    for (active = (tree->root == NULL) ? 0 : group; active > 0;)
+    {
+      for (i = 0; i < group; i++)
+      {
+        if (nodes[i] != NULL)
+          __prefetch(nodes[i]->key);
+      }
+
+      active = 0;
+      for (i = 0; i < group; i++)
+      {
+        if (nodes[i] == NULL)
+          continue;
+        cmp = compare_key(keys[start + i], nodes[i]->key, data);
+        if (cmp == 0)
+        {
+          values[start + i] = nodes[i]->value;
+          nodes[i] = NULL;
+          continue;
+        }
+        if (cmp < 0)
+        {
+          nodes[i] = nodes[i]->left;
+        }
+        else
+        {
+          nodes[i] = nodes[i]->right;
+        }
+        if (nodes[i] != NULL)
+        {
+          __prefetch(nodes[i]);
+          active++;
+        }
+      }
+    }
+  }
+}
+
 void search_tree_minimum(void **min_key,
                          void **min_value,
                          search_tree_t tree)
@@ -163,24 +1031,80 @@ void search_tree_minimum(void **min_key,
   *min_value = node->value;
 }
 
-void search_tree_maximum(void **max_key,
-                         void **max_value,
-                         search_tree_t tree)
+void search_tree_maximum(void **max_key,
+                         void **max_value,
+                         search_tree_t tree)
+{
+  tree_node_t node;
+
+  if (tree->root == NULL)
+  {
+    *max_key = NULL;
+    *max_value = NULL;
+    return;
+  }
+
+  for (node = tree->root; node->right != NULL; node = node->right)
+    ;
+
+  *max_key = node->key;
+  *max_value = node->value;
+}
+
+static tree_node_t __search_tree_next(tree_node_t x)
+{
+  tree_node_t y;
+
+  if (x->right != NULL)
+  {
+    for (y = x->right; y->left != NULL; y = y->left)
+      ;
+    return y;
+  }
+
+  for (y = x->parent; ((y != NULL) && (x == y->right));)
+  {
+    x = y;
+    y = y->parent;
+  }
+  return y;
+}
+
+static tree_node_t __search_tree_prev(tree_node_t x)
 {
-  tree_node_t node;
+  tree_node_t y;
 
-  if (tree->root == NULL)
+  if (x->left != NULL)
   {
-    *max_key = NULL;
-    *max_value = NULL;
-    return;
+    for (y = x->left; y->right != NULL; y = y->right)
+      ;
+    return y;
   }
 
-  for (node = tree->root; node->right != NULL; node = node->right)
-    ;
+  for (y = x->parent; ((y != NULL) && (x == y->left));)
+  {
+    x = y;
+    y = y->parent;
+  }
+  return y;
+}
 
-  *max_key = node->key;
-  *max_value = node->value;
+static tree_node_t __search_tree_first(tree_node_t node)
+{
+  if (node == NULL)
+    return NULL;
+  while (node->left != NULL)
+    node = node->left;
+  return node;
+}
+
+static tree_node_t __search_tree_last(tree_node_t node)
+{
+  if (node == NULL)
+    return NULL;
+  while (node->right != NULL)
+    node = node->right;
+  return node;
 }
 
 void search_tree_predecessor(void **prec_key,
@@ -204,21 +1128,7 @@ void search_tree_predecessor(void **prec_key,
     return;
   }
 
-  if (x->left != NULL)
-  {
-    for (y = x->left; y->right != NULL; y = y->right)
-      ;
-    *prec_key = y->key;
-    *prec_value = y->value;
-    return;
-  }
-
-  for (y = x->parent; ((y != NULL) && (x == y->left));)
-  {
-    x = y;
-    y = y->parent;
-  }
-
+  y = __search_tree_prev(x);
   if (y == NULL)
   {
     *prec_key = NULL;
@@ -250,95 +1160,370 @@ void search_tree_successor(void **succ_key,
     return;
   }
 
-  if (x->right != NULL)
+  y = __search_tree_next(x);
+  if (y == NULL)
   {
-    for (y = x->right; y->left != NULL; y = y->left)
-      ;
-    *succ_key = y->key;
-    *succ_value = y->value;
+    *succ_key = NULL;
+    *succ_value = NULL;
     return;
   }
+  *succ_key = y->key;
+  *succ_value = y->value;
+}
 
-  for (y = x->parent; ((y != NULL) && (x == y->right));)
+int search_tree_cursor_begin(search_tree_cursor_t *cursor,
+                             search_tree_t tree)
+{
+  cursor->tree = tree;
+  cursor->position = (search_tree_position_t)__search_tree_first(tree->root);
+  return cursor->position != NULL;
+}
+
+int search_tree_cursor_end(search_tree_cursor_t *cursor,
+                           search_tree_t tree)
+{
+  cursor->tree = tree;
+  cursor->position = NULL;
+  return 0;
+}
+
+int search_tree_cursor_seek(search_tree_cursor_t *cursor,
+                            search_tree_t tree,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data)
+{
+  cursor->tree = tree;
+  cursor->position = (search_tree_position_t)__search_tree_first_after(tree->root,
+                                                                       key,
+                                                                       1,
+                                                                       compare_key,
+                                                                       data);
+  return cursor->position != NULL;
+}
+
+int search_tree_cursor_at(search_tree_cursor_t *cursor,
+                          search_tree_t tree,
+                          search_tree_position_t position)
+{
+  cursor->tree = tree;
+  cursor->position = position;
+  return cursor->position != NULL;
+}
+
+int search_tree_cursor_next(search_tree_cursor_t *cursor)
+{
+  tree_node_t node;
+
+  node = (tree_node_t)cursor->position;
+  if (node == NULL)
   {
-    x = y;
-    y = y->parent;
+    node = __search_tree_first(cursor->tree->root);
+  }
+  else
+  {
+    node = __search_tree_next(node);
   }
+  cursor->position = (search_tree_position_t)node;
+  return node != NULL;
+}
 
-  if (y == NULL)
+int search_tree_cursor_prev(search_tree_cursor_t *cursor)
+{
+  tree_node_t node;
+
+  node = (tree_node_t)cursor->position;
+  if (node == NULL)
   {
-    *succ_key = NULL;
-    *succ_value = NULL;
-    return;
+    node = __search_tree_last(cursor->tree->root);
   }
-  *succ_key = y->key;
-  *succ_value = y->value;
+  else
+  {
+    node = __search_tree_prev(node);
+  }
+  cursor->position = (search_tree_position_t)node;
+  return node != NULL;
 }
 
-static tree_node_t __search_tree_insert_aux(void *key,
-                                            void *value,
-                                            void *(*copy_key)(void *, void *),
-                                            void *(*copy_value)(void *, void *),
-                                            void *data)
+int search_tree_cursor_valid(search_tree_cursor_t *cursor)
 {
-  tree_node_t new_node;
+  return cursor->position != NULL;
+}
 
-  new_node = calloc(1, sizeof(*new_node));
-  if (new_node == NULL)
+void *search_tree_cursor_key(search_tree_cursor_t *cursor)
+{
+  return ((tree_node_t)cursor->position)->key;
+}
+
+void *search_tree_cursor_value(search_tree_cursor_t *cursor)
+{
+  return ((tree_node_t)cursor->position)->value;
+}
+
+size_t search_tree_range_foreach(search_tree_t tree,
+                                void *lo,
+                                void *hi,
+                                int (*compare_key)(void *, void *, void *),
+                                int (*visitor)(void *, void *, void *),
+                                void *data)
+{
+  tree_node_t node;
+  size_t count;
+
+  if (lo == NULL)
   {
-    fprintf(stderr, "Error: no memory left.\n");
-    exit(1);
+    node = __search_tree_first(tree->root);
+  }
+  else
+  {
+    node = __search_tree_first_after(tree->root,
+                                     lo,
+                                     1,
+                                     compare_key,
+                                     data);
   }
 
-  new_node->key = copy_key(key, data);
-  new_node->value = copy_value(value, data);
-  new_node->parent = NULL;
-  new_node->left = NULL;
-  new_node->right = NULL;
+  count = (size_t)0;
+  for (; node != NULL; node = __search_tree_next(node))
+  {
+    if ((hi != NULL) && (compare_key(node->key, hi, data) >= 0))
+      break;
+    count++;
+    if ((visitor != NULL) && visitor(node->key, node->value, data))
+      break;
+  }
+  return count;
+}
 
-  return new_node;
+static size_t __search_tree_count(tree_node_t node)
+{
+  tree_node_t x, last;
+  size_t n;
+
+  if (node == NULL)
+    return ((size_t)0);
+  last = __search_tree_last(node);
+  n = (size_t)1;
+  for (x = __search_tree_first(node); x != last; x = __search_tree_next(x))
+    n++;
+  return n;
 }
 
-void search_tree_insert(search_tree_t tree,
-                        void *key,
-                        void *value,
-                        int (*compare_key)(void *, void *, void *),
-                        void *(*copy_key)(void *, void *),
-                        void *(*copy_value)(void *, void *),
-                        void *data)
+/* Performs count left rotations down the right spine hanging off
+   scanner, every other node of the spine becoming the left child
+   of the next one.
+*/
+static void __search_tree_compress(tree_node_t scanner,
+                                   size_t count)
 {
-  tree_node_t x, y, z;
+  tree_node_t child;
+  size_t i;
 
-  if (__search_tree_search_aux(tree->root,
-                               key,
-                               compare_key,
-                               data) != NULL)
-    return;
+  for (i = (size_t)0; i < count; i++)
+  {
+    child = scanner->right;
+    scanner->right = child->right;
+    scanner->right->parent = scanner;
+    scanner = scanner->right;
+    child->right = scanner->left;
+    if (child->right != NULL)
+      child->right->parent = child;
+    scanner->left = child;
+    child->parent = scanner;
+  }
+}
 
-  z = __search_tree_insert_aux(key, value,
-                               copy_key, copy_value,
-                               data);
+/* Rebuilds the subtree rooted at node, holding n entries, into a
+   tree of minimum height in place, using the Day-Stout-Warren
+   algorithm: right rotations first turn the subtree into a sorted
+   right spine, then rounds of left rotations fold the spine into
+   a complete tree. Runs in O(n) time and constant extra memory,
+   without calling the comparison function.
+
+   Returns the new root of the subtree, which takes the place of
+   node below its parent.
+*/
+static tree_node_t __search_tree_rebuild(search_tree_t tree,
+                                         tree_node_t node,
+                                         size_t n)
+{
+  struct __tree_node_struct_t pseudo_root;
+  tree_node_t parent, tail, rest, child;
+  size_t full;
+  int is_left;
+
+  parent = node->parent;
+  is_left = ((parent != NULL) && (parent->left == node));
+  pseudo_root.parent = NULL;
+  pseudo_root.left = NULL;
+  pseudo_root.right = node;
+  node->parent = &pseudo_root;
+
+  tail = &pseudo_root;
+  rest = node;
+  while (rest != NULL)
+  {
+    if (rest->left == NULL)
+    {
+      tail = rest;
+      rest = rest->right;
+    }
+    else
+    {
+      child = rest->left;
+      rest->left = child->right;
+      if (rest->left != NULL)
+        rest->left->parent = rest;
+      child->right = rest;
+      rest->parent = child;
+      tail->right = child;
+      child->parent = tail;
+      rest = child;
+    }
+  }
 
-  if (tree->root == NULL)
+  /* Fold the nodes beyond the largest complete tree into the
+     bottom level first, then halve the spine until one node is
+     left on it.
+  */
+  for (full = (size_t)1; ((full << 1) + ((size_t)1)) <= n; full = (full << 1) + ((size_t)1))
+    ;
+  __search_tree_compress(&pseudo_root, n - full);
+  while (full > ((size_t)1))
   {
-    tree->root = z;
-    return;
+    full >>= 1;
+    __search_tree_compress(&pseudo_root, full);
   }
 
-  x = tree->root;
-  y = NULL;
-  while (x != NULL)
+  node = pseudo_root.right;
+  node->parent = parent;
+  if (parent == NULL)
   {
-    y = x;
-    if (compare_key(z->key, x->key, data) < 0)
+    tree->root = node;
+  }
+  else
+  {
+    if (is_left)
     {
-      x = x->left;
+      parent->left = node;
     }
     else
     {
-      x = x->right;
+      parent->right = node;
+    }
+  }
+  return node;
+}
+
+/* Called after z got attached at depth in a scapegoat tree. Walks up
+   from z, counting subtree sizes, to the first ancestor one of whose
+   children holds more than alpha times its entries, and rebuilds
+   that ancestor's subtree.
+*/
+static void __search_tree_scapegoat_insert_fix(search_tree_t tree,
+                                               tree_node_t z,
+                                               size_t depth)
+{
+  tree_node_t x, p, sibling;
+  size_t size, parent_size;
+
+  if (tree->number_entries > tree->max_entries)
+    tree->max_entries = tree->number_entries;
+  if ((depth - ((size_t)1)) <= __search_tree_scapegoat_depth(tree->number_entries))
+    return;
+
+  x = z;
+  size = (size_t)1;
+  while ((p = x->parent) != NULL)
+  {
+    sibling = (p->left == x) ? p->right : p->left;
+    parent_size = size + ((size_t)1) + __search_tree_count(sibling);
+    if ((((double)size) > (SEARCH_TREE_SCAPEGOAT_ALPHA * ((double)parent_size))) ||
+        (p->parent == NULL))
+    {
+      __search_tree_rebuild(tree, p, parent_size);
+      return;
     }
+    x = p;
+    size = parent_size;
   }
+}
+
+/* Called after a removal from a scapegoat tree. Rebuilds the whole
+   tree once it has shrunk below alpha times the largest size it had
+   since it was last rebuilt.
+*/
+static void __search_tree_scapegoat_remove_fix(search_tree_t tree)
+{
+  if (((double)tree->number_entries) >=
+      (SEARCH_TREE_SCAPEGOAT_ALPHA * ((double)tree->max_entries)))
+    return;
+  if (tree->root != NULL)
+    __search_tree_rebuild(tree, tree->root, tree->number_entries);
+  tree->max_entries = tree->number_entries;
+}
+
+void search_tree_rebalance(search_tree_t tree)
+{
+  size_t n, height;
+
+  n = tree->number_entries;
+  if (n == ((size_t)0))
+    return;
+  __search_tree_rebuild(tree, tree->root, n);
+  for (height = (size_t)1; (n >> height) > ((size_t)0); height++)
+    ;
+  tree->max_depth = height;
+  tree->max_entries = n;
+}
+
+void search_tree_set_mode(search_tree_t tree,
+                          search_tree_mode_t mode)
+{
+  if (tree->mode == ((int)mode))
+    return;
+
+  /* Rotations may have moved nodes below the deepest insertion. */
+  if (tree->mode == SEARCH_TREE_MODE_SPLAY)
+    tree->max_depth = search_tree_height(tree);
+
+  if (mode == SEARCH_TREE_MODE_SCAPEGOAT)
+    search_tree_rebalance(tree);
+  tree->max_entries = tree->number_entries;
+  tree->mode = mode;
+}
+
+static tree_node_t __search_tree_insert_aux(search_tree_t tree,
+                                            void *key,
+                                            void *value,
+                                            void *(*copy_key)(void *, void *),
+                                            void *(*copy_value)(void *, void *),
+                                            void *data)
+{
+  tree_node_t new_node;
+
+  new_node = __search_tree_node_alloc(tree);
+
+  __search_tree_store_entry(tree,
+                            new_node,
+                            key,
+                            value,
+                            copy_key,
+                            copy_value,
+                            data);
+  new_node->parent = NULL;
+  new_node->left = NULL;
+  new_node->right = NULL;
+
+  return new_node;
+}
+
+static void __search_tree_attach(search_tree_t tree,
+                                 tree_node_t z,
+                                 tree_node_t y,
+                                 int cmp,
+                                 size_t depth)
+{
   z->parent = y;
   if (y == NULL)
   {
@@ -346,7 +1531,7 @@ void search_tree_insert(search_tree_t tree,
   }
   else
   {
-    if (compare_key(z->key, y->key, data) < 0)
+    if (cmp < 0)
     {
       y->left = z;
     }
@@ -355,6 +1540,111 @@ void search_tree_insert(search_tree_t tree,
       y->right = z;
     }
   }
+  tree->number_entries++;
+  if (depth > tree->max_depth)
+    tree->max_depth = depth;
+  if (tree->mode == SEARCH_TREE_MODE_SCAPEGOAT)
+    __search_tree_scapegoat_insert_fix(tree, z, depth);
+}
+
+void search_tree_insert(search_tree_t tree,
+                        void *key,
+                        void *value,
+                        int (*compare_key)(void *, void *, void *),
+                        void *(*copy_key)(void *, void *),
+                        void *(*copy_value)(void *, void *),
+                        void *data)
+{
+  search_tree_insert_or_get(NULL,
+                            tree,
+                            key,
+                            value,
+                            compare_key,
+                            copy_key,
+                            copy_value,
+                            data);
+}
+
+int search_tree_insert_or_get(void **value_in_tree,
+                              search_tree_t tree,
+                              void *key,
+                              void *value,
+                              int (*compare_key)(void *, void *, void *),
+                              void *(*copy_key)(void *, void *),
+                              void *(*copy_value)(void *, void *),
+                              void *data)
+{
+  tree_node_t y, z;
+  size_t depth;
+  int cmp;
+
+  z = __search_tree_locate(&y, &cmp, &depth,
+                           tree,
+                           key,
+                           compare_key,
+                           data);
+  if (z != NULL)
+  {
+    if (tree->mode == SEARCH_TREE_MODE_SPLAY)
+      __search_tree_splay(tree, z);
+    if (value_in_tree != NULL)
+      *value_in_tree = z->value;
+    return 0;
+  }
+
+  z = __search_tree_insert_aux(tree, key, value,
+                               copy_key, copy_value,
+                               data);
+  __search_tree_attach(tree, z, y, cmp, depth);
+  if (tree->mode == SEARCH_TREE_MODE_SPLAY)
+    __search_tree_splay(tree, z);
+  if (value_in_tree != NULL)
+    *value_in_tree = z->value;
+  return 1;
+}
+
+int search_tree_upsert(search_tree_t tree,
+                       void *key,
+                       void *value,
+                       int (*compare_key)(void *, void *, void *),
+                       void *(*copy_key)(void *, void *),
+                       void *(*copy_value)(void *, void *),
+                       void (*delete_value)(void *, void *),
+                       void *data)
+{
+  tree_node_t y, z;
+  size_t depth;
+  int cmp;
+
+  z = __search_tree_locate(&y, &cmp, &depth,
+                           tree,
+                           key,
+                           compare_key,
+                           data);
+  if (z != NULL)
+  {
+    if (tree->inline_entries)
+    {
+      memcpy(z->value, value, tree->value_size);
+    }
+    else
+    {
+      if (delete_value != NULL)
+        delete_value(z->value, data);
+      z->value = copy_value(value, data);
+    }
+    if (tree->mode == SEARCH_TREE_MODE_SPLAY)
+      __search_tree_splay(tree, z);
+    return 1;
+  }
+
+  z = __search_tree_insert_aux(tree, key, value,
+                               copy_key, copy_value,
+                               data);
+  __search_tree_attach(tree, z, y, cmp, depth);
+  if (tree->mode == SEARCH_TREE_MODE_SPLAY)
+    __search_tree_splay(tree, z);
+  return 0;
 }
 
 static void __search_tree_remove_aux_transplant(search_tree_t tree,
@@ -429,19 +1719,57 @@ void search_tree_remove(search_tree_t tree,
                         void (*delete_value)(void *, void *),
                         void *data)
 {
-  tree_node_t z;
+  tree_node_t y, z;
+  size_t depth;
+  int cmp;
 
-  z = __search_tree_search_aux(tree->root,
-                               key,
-                               compare_key,
-                               data);
+  if (tree->mode == SEARCH_TREE_MODE_SPLAY)
+  {
+    z = __search_tree_locate(&y, &cmp, &depth,
+                             tree,
+                             key,
+                             compare_key,
+                             data);
+    if (z == NULL)
+    {
+      if (y != NULL)
+        __search_tree_splay(tree, y);
+      return;
+    }
+    /* Once z is the root, unlinking it only pulls its
+       successor up, which is the usual top-down splay
+       deletion up to where the two subtrees are joined.
+    */
+    __search_tree_splay(tree, z);
+  }
+  else
+  {
+    z = __search_tree_search_aux(tree->root,
+                                 key,
+                                 compare_key,
+                                 data);
+  }
 
   if (z == NULL)
     return;
 
   __search_tree_remove_aux(tree, z);
+  tree->number_entries--;
+  if (tree->number_entries == ((size_t)0))
+  {
+    tree->max_depth = (size_t)0;
+    tree->max_entries = (size_t)0;
+  }
+  else
+  {
+    if (tree->mode == SEARCH_TREE_MODE_SCAPEGOAT)
+      __search_tree_scapegoat_remove_fix(tree);
+  }
 
-  delete_key(z->key, data);
-  delete_value(z->value, data);
-  free(z);
+  __search_tree_release_entry(tree,
+                              z,
+                              delete_key,
+                              delete_value,
+                              data);
+  __search_tree_node_free(tree, z);
 }
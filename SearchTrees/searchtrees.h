@@ -5,20 +5,169 @@
 
 typedef struct __search_tree_struct_t * search_tree_t;
 
+/* Handle on an entry of a search tree. A position stays valid
+   until its entry is removed from the tree.
+*/
+typedef struct __search_tree_position_struct_t * search_tree_position_t;
+
+/* In-order cursor over a search tree, meant to live on the stack.
+
+   Besides the entries, a cursor can sit on the end position, which
+   lies one past the last entry and one before the first entry.
+   Stepping a cursor costs amortized O(1). Removing the entry a
+   cursor sits on invalidates the cursor; any other change to the
+   tree leaves it usable.
+*/
+typedef struct
+{
+  search_tree_t tree;
+  search_tree_position_t position;
+} search_tree_cursor_t;
+
+/* Allocator statistics of a search tree, see
+   search_tree_allocator_stats.
+*/
+typedef struct
+{
+  size_t number_slabs;
+  size_t nodes_per_slab;
+  size_t node_size;
+  size_t nodes_reserved;
+  size_t nodes_in_use;
+  size_t nodes_free;
+  size_t bytes_reserved;
+} search_tree_allocator_stats_t;
+
+/* Balancing modes of a search tree, see search_tree_set_mode. */
+typedef enum
+{
+  SEARCH_TREE_MODE_PLAIN = 0,
+  SEARCH_TREE_MODE_SPLAY = 1,
+  SEARCH_TREE_MODE_SCAPEGOAT = 2
+} search_tree_mode_t;
+
 /* Creates an empty search tree */
 search_tree_t search_tree_create();
 
+/* Creates an empty search tree whose nodes are taken from a
+   per-tree slab arena holding nodes_per_slab nodes per slab.
+
+   Removed nodes are kept on a free list and reused by later
+   inserts. All slabs are released at once when the tree is
+   deleted.
+
+   A default slab size is used if nodes_per_slab is zero.
+
+*/
+search_tree_t search_tree_create_with_allocator(size_t nodes_per_slab);
+
+/* Creates an empty search tree that stores keys of key_size bytes
+   and values of value_size bytes directly inside its nodes, which
+   are taken from a slab arena as with
+   search_tree_create_with_allocator.
+
+   Inserting copies the bytes pointed to by the key and value into
+   the node; keys and values handed out by the tree point into the
+   node. The copy_key, copy_value, delete_key and delete_value
+   arguments of all other functions are ignored for such a tree and
+   may be NULL, so an insert costs no allocation besides the node
+   and a removal or deletion none at all.
+
+*/
+search_tree_t search_tree_create_inline(size_t key_size,
+                                        size_t value_size,
+                                        size_t nodes_per_slab);
+
+/* Builds a search tree from n entries whose keys are already
+   sorted in strictly ascending order, copying the keys and values
+   with copy_key resp. copy_value.
+
+   Runs in O(n) without calling any comparison function. The result
+   is perfectly balanced and its nodes are carved from a single
+   allocation of n nodes in the tree's slab arena, as for trees made
+   by search_tree_create_with_allocator.
+
+*/
+search_tree_t search_tree_build_sorted(void **keys,
+                                       void **values,
+                                       size_t n,
+                                       void *(*copy_key)(void *, void *),
+                                       void *(*copy_value)(void *, void *),
+                                       void *data);
+
+/* Rebuilds a search tree into one of minimum height in place.
+
+   Uses the Day-Stout-Warren algorithm: rotations first turn the
+   tree into a sorted chain, then fold the chain into a tree whose
+   levels are all full but the last. Runs in O(n) time with constant
+   extra memory, without allocating and without calling any
+   comparison function. Positions and cursors stay valid.
+
+*/
+void search_tree_rebalance(search_tree_t tree);
+
+/* Sets the balancing mode of a search tree. Trees start out in
+   SEARCH_TREE_MODE_PLAIN, where nodes stay where they were inserted.
+
+   In SEARCH_TREE_MODE_SPLAY, search_tree_search, search_tree_insert,
+   search_tree_insert_or_get, search_tree_upsert and
+   search_tree_remove rotate the node they accessed, or the last
+   node visited if the key is missing, up to the root. Frequently
+   accessed keys thus stay near the root, while any sequence of m
+   such operations costs O((m + n) log n). Other functions do not
+   restructure the tree. The height of a splay tree is only bounded
+   by its number of entries.
+
+   In SEARCH_TREE_MODE_SCAPEGOAT, an insertion deeper than
+   log(n) / log(1 / alpha), alpha being 0.7, rebuilds the smallest
+   ancestor subtree that is out of weight balance into a tree of
+   minimum height, and a removal that leaves fewer than alpha times
+   the largest number of entries since the last full rebuild
+   rebuilds the whole tree. This keeps the height in O(log n), with
+   amortized O(log n) updates, without storing anything in the
+   nodes. Switching to this mode rebuilds the whole tree in O(n).
+
+   The mode can be changed at any time. Nodes are only relinked,
+   never moved, so positions and cursors stay valid in every mode.
+
+*/
+void search_tree_set_mode(search_tree_t tree,
+                          search_tree_mode_t mode);
+
+/* Fills in the allocator statistics of a search tree.
+
+   All counters are zero for a tree that was not created
+   with search_tree_create_with_allocator.
+
+*/
+void search_tree_allocator_stats(search_tree_allocator_stats_t *stats,
+                                 search_tree_t tree);
+
 /* Deletes a search tree, calling delete_key and delete_value
    on each key resp. value, passing in the data pointer.
+
+   Runs in O(n) with constant extra memory. Either function may be
+   NULL if the keys resp. values need no cleanup; if both are NULL
+   and the tree uses a slab arena, the nodes are not visited at all.
 */
 void search_tree_delete(search_tree_t tree,
                         void (*delete_key)(void *, void *),
                         void (*delete_value)(void *, void *),
                         void *data);
 
+/* Removes all entries from a search tree like search_tree_delete,
+   but keeps the tree itself for reuse.
+
+   A tree using a slab arena keeps its largest slab.
+*/
+void search_tree_clear(search_tree_t tree,
+                       void (*delete_key)(void *, void *),
+                       void (*delete_value)(void *, void *),
+                       void *data);
+
 /* Returns the number of entries in a search tree
 
-   Returns zero for an empty tree.
+   Returns zero for an empty tree. Runs in constant time.
 
 */
 size_t search_tree_number_entries(search_tree_t tree);
@@ -30,6 +179,21 @@ size_t search_tree_number_entries(search_tree_t tree);
 */
 size_t search_tree_height(search_tree_t tree);
 
+/* Returns a lower and an upper bound on the height of a
+   search tree in constant time, without walking the tree.
+
+   The lower bound follows from the number of entries, the
+   upper bound is the depth of the deepest insertion since
+   the tree was last empty, or the number of entries in
+   SEARCH_TREE_MODE_SPLAY. In SEARCH_TREE_MODE_SCAPEGOAT, it is
+   at most two more than the rebuild depth of the largest size
+   since the last full rebuild. Both are zero for an empty tree.
+
+*/
+void search_tree_height_bounds(size_t *min_height,
+                               size_t *max_height,
+                               search_tree_t tree);
+
 /* Searches a search tree for a key, comparing keys with
    compare_key, returning the associated value.
 
@@ -45,6 +209,27 @@ void *search_tree_search(search_tree_t tree,
                          int (*compare_key)(void *, void *, void *),
                          void *data);
 
+/* Searches a search tree for n keys at once, comparing keys with
+   compare_key, and stores the value associated with keys[i] in
+   values[i], or NULL if keys[i] cannot be found.
+
+   Gives the same results as n calls to search_tree_search, but
+   advances several lookups side by side and prefetches the nodes
+   they visit, so that on trees exceeding the cache the memory
+   latency of one lookup overlaps with the others.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void search_tree_search_batch(void **values,
+                              search_tree_t tree,
+                              void **keys,
+                              size_t n,
+                              int (*compare_key)(void *, void *, void *),
+                              void *data);
+
 /* Returns the minimum key and associated value, comparing
    the keys with compare_key.
 
@@ -67,6 +252,72 @@ void search_tree_maximum(void **max_key,
                          void **max_value,
                          search_tree_t tree);
 
+/* Returns the entry with the smallest key greater than or equal
+   to key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void search_tree_lower_bound(void **found_key,
+                             void **found_value,
+                             search_tree_position_t *position,
+                             search_tree_t tree,
+                             void *key,
+                             int (*compare_key)(void *, void *, void *),
+                             void *data);
+
+/* Returns the entry with the smallest key strictly greater than
+   key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+*/
+void search_tree_upper_bound(void **found_key,
+                             void **found_value,
+                             search_tree_position_t *position,
+                             search_tree_t tree,
+                             void *key,
+                             int (*compare_key)(void *, void *, void *),
+                             void *data);
+
+/* Returns the entry with the largest key less than or equal to
+   key, together with its position, in a single descent.
+
+   Returns NULL for the key, the value and the position if there
+   is no such entry. position may be NULL if it is not needed.
+
+*/
+void search_tree_floor(void **found_key,
+                       void **found_value,
+                       search_tree_position_t *position,
+                       search_tree_t tree,
+                       void *key,
+                       int (*compare_key)(void *, void *, void *),
+                       void *data);
+
+/* Returns the entry with the smallest key greater than or equal
+   to key, together with its position. Same as
+   search_tree_lower_bound.
+
+*/
+void search_tree_ceiling(void **found_key,
+                         void **found_value,
+                         search_tree_position_t *position,
+                         search_tree_t tree,
+                         void *key,
+                         int (*compare_key)(void *, void *, void *),
+                         void *data);
+
+/* Returns the key resp. value of the entry at a position. */
+void *search_tree_position_key(search_tree_position_t position);
+void *search_tree_position_value(search_tree_position_t position);
+
 /* Returns the predecessor of a key and value associated with that
    key, comparing the keys with compare_key.
 
@@ -105,6 +356,94 @@ void search_tree_successor(void **succ_key,
                            int (*compare_key)(void *, void *, void *),
                            void *data);
 
+/* Positions a cursor on the first entry of a tree resp. on the end
+   position.
+
+   search_tree_cursor_begin returns 1 if the cursor sits on an
+   entry and 0 if the tree is empty. search_tree_cursor_end
+   always returns 0.
+
+   Forward traversal:  for (ok = search_tree_cursor_begin(&c, t);
+                            ok; ok = search_tree_cursor_next(&c))
+   Reverse traversal:  search_tree_cursor_end(&c, t);
+                       while (search_tree_cursor_prev(&c))
+
+*/
+int search_tree_cursor_begin(search_tree_cursor_t *cursor,
+                             search_tree_t tree);
+int search_tree_cursor_end(search_tree_cursor_t *cursor,
+                           search_tree_t tree);
+
+/* Positions a cursor on the entry with the smallest key greater
+   than or equal to key, or on the end position if there is none.
+
+   Returns 1 if the cursor sits on an entry, 0 otherwise.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int search_tree_cursor_seek(search_tree_cursor_t *cursor,
+                            search_tree_t tree,
+                            void *key,
+                            int (*compare_key)(void *, void *, void *),
+                            void *data);
+
+/* Positions a cursor on the entry at position, or on the end
+   position if position is NULL.
+
+   Returns 1 if the cursor sits on an entry, 0 otherwise.
+
+*/
+int search_tree_cursor_at(search_tree_cursor_t *cursor,
+                          search_tree_t tree,
+                          search_tree_position_t position);
+
+/* Moves a cursor to the next resp. previous entry in key order.
+   Moving from the end position goes to the first resp. last entry.
+
+   Returns 1 if the cursor sits on an entry afterwards, 0 if it
+   reached the end position.
+
+*/
+int search_tree_cursor_next(search_tree_cursor_t *cursor);
+int search_tree_cursor_prev(search_tree_cursor_t *cursor);
+
+/* Returns 1 if a cursor sits on an entry, 0 if it sits on the
+   end position.
+*/
+int search_tree_cursor_valid(search_tree_cursor_t *cursor);
+
+/* Returns the key resp. value of the entry a cursor sits on.
+   The cursor must not sit on the end position.
+*/
+void *search_tree_cursor_key(search_tree_cursor_t *cursor);
+void *search_tree_cursor_value(search_tree_cursor_t *cursor);
+
+/* Visits the entries with lo <= key < hi in key order, calling
+   visitor on each key and value with the data pointer, in
+   O(log n + k) for k visited entries on a balanced tree.
+
+   A NULL lo resp. hi leaves the range unbounded on that side.
+   The scan stops early as soon as visitor returns a non-zero
+   value. If visitor is NULL, the entries are only counted.
+
+   Returns the number of entries visited, including the one on
+   which the scan was stopped.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t search_tree_range_foreach(search_tree_t tree,
+                                void *lo,
+                                void *hi,
+                                int (*compare_key)(void *, void *, void *),
+                                int (*visitor)(void *, void *, void *),
+                                void *data);
+
 /* Inserts a key and an associated value into a tree, comparing the
    keys with compare_key and copying the key and value with the
    copy_key resp. copy_value functions.
@@ -122,6 +461,55 @@ void search_tree_insert(search_tree_t tree,
                         void *(*copy_value)(void *, void *),
                         void *data);
 
+/* Inserts a key and an associated value into a tree unless the key
+   is already present, descending the tree only once.
+
+   Returns 1 if a new entry was inserted, copying the key and value
+   with copy_key resp. copy_value. Returns 0 if the key was already
+   present, in which case the tree is left unchanged.
+
+   In both cases, if value_in_tree is not NULL, it is set to the
+   value now associated with the key in the tree.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int search_tree_insert_or_get(void **value_in_tree,
+                              search_tree_t tree,
+                              void *key,
+                              void *value,
+                              int (*compare_key)(void *, void *, void *),
+                              void *(*copy_key)(void *, void *),
+                              void *(*copy_value)(void *, void *),
+                              void *data);
+
+/* Inserts a key and an associated value into a tree, or replaces
+   the value if the key is already present, descending the tree
+   only once.
+
+   A replaced value is deleted with delete_value and the new one
+   copied with copy_value in place; the stored key is kept. A new
+   entry copies both the key and the value. delete_value may be
+   NULL if the values need no cleanup.
+
+   Returns 1 if the key was already present, 0 otherwise.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+int search_tree_upsert(search_tree_t tree,
+                       void *key,
+                       void *value,
+                       int (*compare_key)(void *, void *, void *),
+                       void *(*copy_key)(void *, void *),
+                       void *(*copy_value)(void *, void *),
+                       void (*delete_value)(void *, void *),
+                       void *data);
+
 /* Removes a key and the associated value in a tree, comparing the
    keys with compare_key and deleting the key and value with the
    delete_key resp. delete_value function.
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "searchtrees.h"
+#include "../RedBlackTrees/redblacktrees.h"
+
+#define NUM_VALUES 100000
+#define NUM_LOOKUPS 2000000
+
+int compare_int(void *a, void *b, void *data)
+{
+    int *ia = (int *)a;
+    int *ib = (int *)b;
+    return (*ia > *ib) - (*ia < *ib);
+}
+
+static void *copy_key(void *key, void *data)
+{
+    int *original_key = (int *)key;
+    int *new_key = (int *)malloc(sizeof(int));
+    if (new_key == NULL)
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+    *new_key = *original_key;
+    return new_key;
+}
+
+static void *copy_value(void *value, void *data)
+{
+    int *original_value = (int *)value;
+    int *new_value = (int *)malloc(sizeof(int));
+    if (new_value == NULL)
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+    *new_value = *original_value;
+    return new_value;
+}
+
+static void *xmalloc(size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr == NULL)
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static void shuffle(int *a, int n)
+{
+    for (int i = n - 1; i > 0; i--)
+    {
+        int j = rand() % (i + 1);
+        int t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+    }
+}
+
+// Draws NUM_LOOKUPS keys such that the key of rank r is drawn with
+// probability proportional to 1 / r^s. Ranks are mapped onto keys by
+// a random permutation, so popular keys are spread over the tree.
+static void zipf_sample(int *lookups, const int *keys, double s)
+{
+    double *cdf = (double *)xmalloc(NUM_VALUES * sizeof(double));
+    double total = 0.0;
+
+    for (int r = 0; r < NUM_VALUES; r++)
+    {
+        total += 1.0 / pow((double)(r + 1), s);
+        cdf[r] = total;
+    }
+
+    for (int i = 0; i < NUM_LOOKUPS; i++)
+    {
+        double u = total * ((double)rand() / ((double)RAND_MAX + 1.0));
+        int lo = 0;
+        int hi = NUM_VALUES - 1;
+        while (lo < hi)
+        {
+            int mid = lo + (hi - lo) / 2;
+            if (cdf[mid] <= u)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        lookups[i] = keys[lo];
+    }
+
+    free(cdf);
+}
+
+static double time_search_tree(search_tree_mode_t mode, const int *keys, int *lookups, size_t *height)
+{
+    search_tree_t tree = search_tree_create();
+    search_tree_set_mode(tree, mode);
+
+    for (int i = 0; i < NUM_VALUES; i++)
+        search_tree_insert(tree, (void *)&keys[i], (void *)&keys[i], compare_int, copy_key, copy_value, NULL);
+
+    clock_t start = clock();
+    for (int i = 0; i < NUM_LOOKUPS; i++)
+    {
+        if (search_tree_search(tree, &lookups[i], compare_int, NULL) == NULL)
+        {
+            fprintf(stderr, "Error: key %d not found.\n", lookups[i]);
+            exit(1);
+        }
+    }
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    *height = search_tree_height(tree);
+    search_tree_delete(tree, free, free, NULL);
+    return elapsed;
+}
+
+static double time_red_black_tree(const int *keys, int *lookups, size_t *height)
+{
+    red_black_tree_t tree = red_black_tree_create();
+
+    for (int i = 0; i < NUM_VALUES; i++)
+        red_black_tree_insert(tree, (void *)&keys[i], (void *)&keys[i], compare_int, copy_key, copy_value, NULL);
+
+    clock_t start = clock();
+    for (int i = 0; i < NUM_LOOKUPS; i++)
+    {
+        if (red_black_tree_search(tree, &lookups[i], compare_int, NULL) == NULL)
+        {
+            fprintf(stderr, "Error: key %d not found.\n", lookups[i]);
+            exit(1);
+        }
+    }
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    *height = red_black_tree_height(tree);
+    red_black_tree_delete(tree, free, free, NULL);
+    return elapsed;
+}
+
+int main()
+{
+    static const double skews[] = {0.0, 0.8, 1.0, 1.2, 1.5};
+    int *keys = (int *)xmalloc(NUM_VALUES * sizeof(int));
+    int *ranks = (int *)xmalloc(NUM_VALUES * sizeof(int));
+    int *lookups = (int *)xmalloc(NUM_LOOKUPS * sizeof(int));
+
+    srand(time(NULL));
+
+    for (int i = 0; i < NUM_VALUES; i++)
+        keys[i] = i;
+    shuffle(keys, NUM_VALUES);
+    for (int i = 0; i < NUM_VALUES; i++)
+        ranks[i] = i;
+    shuffle(ranks, NUM_VALUES);
+
+    printf("%d keys, %d lookups per run.\n", NUM_VALUES, NUM_LOOKUPS);
+
+    FILE *outputFile = fopen("zipf_data.csv", "w");
+
+    fprintf(outputFile, "Skew,BST Time,Splay Time,RB Time\n");
+
+    for (size_t k = 0; k < sizeof(skews) / sizeof(skews[0]); k++)
+    {
+        size_t bst_height, splay_height, rb_height;
+
+        zipf_sample(lookups, ranks, skews[k]);
+
+        double bst = time_search_tree(SEARCH_TREE_MODE_PLAIN, keys, lookups, &bst_height);
+        double splay = time_search_tree(SEARCH_TREE_MODE_SPLAY, keys, lookups, &splay_height);
+        double rb = time_red_black_tree(keys, lookups, &rb_height);
+
+        printf("s = %.1f: BST %.3f s (height %zu), splay %.3f s (height %zu), red-black %.3f s (height %zu)\n",
+               skews[k], bst, bst_height, splay, splay_height, rb, rb_height);
+        fprintf(outputFile, "%.1f,%.3f,%.3f,%.3f\n", skews[k], bst, splay, rb);
+    }
+
+    fclose(outputFile);
+
+    free(lookups);
+    free(ranks);
+    free(keys);
+
+    return 0;
+}
@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../RedBlackTrees/redblacktrees.h"
+
+#define SHARDED_RED_BLACK_TREE_CACHE_LINE ((size_t)64)
+
+/* The padding keeps the locks of two shards on different cache
+   lines, so that threads writing to different shards do not bounce
+   a line between them.
+*/
+typedef struct __shard_struct_t *shard_t;
+struct __shard_struct_t
+{
+  pthread_rwlock_t lock;
+  red_black_tree_t tree;
+  unsigned char padding[SHARDED_RED_BLACK_TREE_CACHE_LINE];
+};
+
+struct __sharded_red_black_tree_struct_t
+{
+  shard_t shards;
+  size_t number_shards;
+  void **split_keys;
+  unsigned char *split_key_bytes;
+  int inline_entries;
+};
+
+#include "shardedredblacktrees.h"
+
+static void *__sharded_red_black_tree_malloc(size_t size)
+{
+  void *ptr;
+
+  ptr = malloc(size);
+  if (ptr == NULL)
+  {
+    fprintf(stderr, "Error: no memory left.\n");
+    exit(1);
+  }
+  return ptr;
+}
+
+static sharded_red_black_tree_t __sharded_red_black_tree_create_aux(size_t number_splits,
+                                                                    size_t key_size,
+                                                                    size_t value_size,
+                                                                    int inline_entries)
+{
+  sharded_red_black_tree_t tree;
+  size_t i;
+
+  tree = __sharded_red_black_tree_malloc(sizeof(*tree));
+  tree->number_shards = number_splits + ((size_t)1);
+  tree->shards = __sharded_red_black_tree_malloc(tree->number_shards * sizeof(*tree->shards));
+  tree->split_keys = __sharded_red_black_tree_malloc((number_splits + ((size_t)1)) * sizeof(void *));
+  tree->split_key_bytes = NULL;
+  tree->inline_entries = inline_entries;
+  for (i = (size_t)0; i < tree->number_shards; i++)
+  {
+    pthread_rwlock_init(&tree->shards[i].lock, NULL);
+    if (inline_entries)
+    {
+      tree->shards[i].tree = red_black_tree_create_inline(key_size, value_size, (size_t)0);
+    }
+    else
+    {
+      tree->shards[i].tree = red_black_tree_create_with_allocator((size_t)0);
+    }
+  }
+  return tree;
+}
+
+sharded_red_black_tree_t sharded_red_black_tree_create(void **split_keys,
+                                                       size_t number_splits,
+                                                       void *(*copy_key)(void *, void *),
+                                                       void *data)
+{
+  sharded_red_black_tree_t tree;
+  size_t i;
+
+  tree = __sharded_red_black_tree_create_aux(number_splits, (size_t)0, (size_t)0, 0);
+  for (i = (size_t)0; i < number_splits; i++)
+    tree->split_keys[i] = copy_key(split_keys[i], data);
+  return tree;
+}
+
+sharded_red_black_tree_t sharded_red_black_tree_create_inline(void **split_keys,
+                                                              size_t number_splits,
+                                                              size_t key_size,
+                                                              size_t value_size)
+{
+  sharded_red_black_tree_t tree;
+  size_t i;
+
+  tree = __sharded_red_black_tree_create_aux(number_splits, key_size, value_size, 1);
+  tree->split_key_bytes = __sharded_red_black_tree_malloc(number_splits * key_size + ((size_t)1));
+  for (i = (size_t)0; i < number_splits; i++)
+  {
+    tree->split_keys[i] = tree->split_key_bytes + i * key_size;
+    memcpy(tree->split_keys[i], split_keys[i], key_size);
+  }
+  return tree;
+}
+
+void sharded_red_black_tree_delete(sharded_red_black_tree_t tree,
+                                   void (*delete_key)(void *, void *),
+                                   void (*delete_value)(void *, void *),
+                                   void *data)
+{
+  size_t i;
+
+  for (i = (size_t)0; i < tree->number_shards; i++)
+  {
+    red_black_tree_delete(tree->shards[i].tree, delete_key, delete_value, data);
+    pthread_rwlock_destroy(&tree->shards[i].lock);
+  }
+  if (tree->inline_entries)
+  {
+    free(tree->split_key_bytes);
+  }
+  else
+  {
+    if (delete_key != NULL)
+    {
+      for (i = (size_t)0; (i + ((size_t)1)) < tree->number_shards; i++)
+        delete_key(tree->split_keys[i], data);
+    }
+  }
+  free(tree->split_keys);
+  free(tree->shards);
+  free(tree);
+}
+
+size_t sharded_red_black_tree_number_shards(sharded_red_black_tree_t tree)
+{
+  return tree->number_shards;
+}
+
+/* Returns the shard a key belongs to, i.e. the number of split keys
+   not greater than the key.
+*/
+static shard_t __sharded_red_black_tree_shard(sharded_red_black_tree_t tree,
+                                              void *key,
+                                              int (*compare_key)(void *, void *, void *),
+                                              void *data)
+{
+  size_t lo, hi, mid;
+
+  lo = (size_t)0;
+  hi = tree->number_shards - ((size_t)1);
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / ((size_t)2);
+    if (compare_key(key, tree->split_keys[mid], data) < 0)
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid + ((size_t)1);
+    }
+  }
+  return &tree->shards[lo];
+}
+
+size_t sharded_red_black_tree_number_entries(sharded_red_black_tree_t tree)
+{
+  size_t i, n;
+
+  n = (size_t)0;
+  for (i = (size_t)0; i < tree->number_shards; i++)
+  {
+    pthread_rwlock_rdlock(&tree->shards[i].lock);
+    n += red_black_tree_number_entries(tree->shards[i].tree);
+    pthread_rwlock_unlock(&tree->shards[i].lock);
+  }
+  return n;
+}
+
+void *sharded_red_black_tree_search(sharded_red_black_tree_t tree,
+                                    void *key,
+                                    int (*compare_key)(void *, void *, void *),
+                                    void *data)
+{
+  shard_t shard;
+  void *value;
+
+  shard = __sharded_red_black_tree_shard(tree, key, compare_key, data);
+  pthread_rwlock_rdlock(&shard->lock);
+  value = red_black_tree_search(shard->tree, key, compare_key, data);
+  pthread_rwlock_unlock(&shard->lock);
+  return value;
+}
+
+void sharded_red_black_tree_minimum(void **min_key,
+                                    void **min_value,
+                                    sharded_red_black_tree_t tree)
+{
+  size_t i;
+
+  *min_key = NULL;
+  *min_value = NULL;
+  for (i = (size_t)0; (i < tree->number_shards) && (*min_key == NULL); i++)
+  {
+    pthread_rwlock_rdlock(&tree->shards[i].lock);
+    red_black_tree_minimum(min_key, min_value, tree->shards[i].tree);
+    pthread_rwlock_unlock(&tree->shards[i].lock);
+  }
+}
+
+void sharded_red_black_tree_maximum(void **max_key,
+                                    void **max_value,
+                                    sharded_red_black_tree_t tree)
+{
+  size_t i;
+
+  *max_key = NULL;
+  *max_value = NULL;
+  for (i = tree->number_shards; (i > ((size_t)0)) && (*max_key == NULL); i--)
+  {
+    pthread_rwlock_rdlock(&tree->shards[i - ((size_t)1)].lock);
+    red_black_tree_maximum(max_key, max_value, tree->shards[i - ((size_t)1)].tree);
+    pthread_rwlock_unlock(&tree->shards[i - ((size_t)1)].lock);
+  }
+}
+
+/* red_black_tree_range_foreach hands the same data pointer to the
+   comparison function and the visitor. The scan across shards needs
+   to learn whether the visitor stopped it, so both get wrapped.
+*/
+typedef struct
+{
+  int (*compare_key)(void *, void *, void *);
+  int (*visitor)(void *, void *, void *);
+  void *data;
+  int stopped;
+} __sharded_red_black_tree_scan_t;
+
+static int __sharded_red_black_tree_scan_compare(void *a, void *b, void *data)
+{
+  __sharded_red_black_tree_scan_t *scan;
+
+  scan = data;
+  return scan->compare_key(a, b, scan->data);
+}
+
+static int __sharded_red_black_tree_scan_visit(void *key, void *value, void *data)
+{
+  __sharded_red_black_tree_scan_t *scan;
+
+  scan = data;
+  if ((scan->visitor != NULL) && scan->visitor(key, value, scan->data))
+    scan->stopped = 1;
+  return scan->stopped;
+}
+
+size_t sharded_red_black_tree_range_foreach(sharded_red_black_tree_t tree,
+                                            void *lo,
+                                            void *hi,
+                                            int (*compare_key)(void *, void *, void *),
+                                            int (*visitor)(void *, void *, void *),
+                                            void *data)
+{
+  __sharded_red_black_tree_scan_t scan;
+  shard_t shard, last;
+  size_t count;
+
+  shard = (lo == NULL) ? tree->shards : __sharded_red_black_tree_shard(tree, lo, compare_key, data);
+  last = (hi == NULL) ? &tree->shards[tree->number_shards - ((size_t)1)] :
+                        __sharded_red_black_tree_shard(tree, hi, compare_key, data);
+  scan.compare_key = compare_key;
+  scan.visitor = visitor;
+  scan.data = data;
+  scan.stopped = 0;
+
+  count = (size_t)0;
+  for (; (shard <= last) && !scan.stopped; shard++)
+  {
+    pthread_rwlock_rdlock(&shard->lock);
+    if (visitor == NULL)
+    {
+      count += red_black_tree_range_foreach(shard->tree, lo, hi,
+                                            __sharded_red_black_tree_scan_compare,
+                                            NULL, &scan);
+    }
+    else
+    {
+      count += red_black_tree_range_foreach(shard->tree, lo, hi,
+                                            __sharded_red_black_tree_scan_compare,
+                                            __sharded_red_black_tree_scan_visit, &scan);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+  }
+  return count;
+}
+
+void sharded_red_black_tree_insert(sharded_red_black_tree_t tree,
+                                   void *key,
+                                   void *value,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *(*copy_key)(void *, void *),
+                                   void *(*copy_value)(void *, void *),
+                                   void *data)
+{
+  shard_t shard;
+
+  shard = __sharded_red_black_tree_shard(tree, key, compare_key, data);
+  pthread_rwlock_wrlock(&shard->lock);
+  red_black_tree_insert(shard->tree, key, value, compare_key, copy_key, copy_value, data);
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+void sharded_red_black_tree_remove(sharded_red_black_tree_t tree,
+                                   void *key,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void (*delete_key)(void *, void *),
+                                   void (*delete_value)(void *, void *),
+                                   void *data)
+{
+  shard_t shard;
+
+  shard = __sharded_red_black_tree_shard(tree, key, compare_key, data);
+  pthread_rwlock_wrlock(&shard->lock);
+  red_black_tree_remove(shard->tree, key, compare_key, delete_key, delete_value, data);
+  pthread_rwlock_unlock(&shard->lock);
+}
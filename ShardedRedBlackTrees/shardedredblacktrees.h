@@ -0,0 +1,173 @@
+#ifndef SHARDED_RED_BLACK_TREES_H
+#define SHARDED_RED_BLACK_TREES_H
+
+#include <stdlib.h>
+
+/* A set of red-black trees, the shards, each holding the entries of
+   one range of keys, so that threads working on keys in different
+   ranges do not wait for each other.
+
+   Shard i holds the keys k with split_keys[i - 1] <= k < split_keys[i],
+   the first and last shard being unbounded below resp. above. Each
+   shard has its own read-write lock and its own slab arena for its
+   nodes, so neither locking nor node allocation is shared between
+   shards. Writers to uniformly spread keys thus rarely contend once
+   there are several shards per thread.
+
+   All functions may be called concurrently, except
+   sharded_red_black_tree_delete.
+
+*/
+typedef struct __sharded_red_black_tree_struct_t *sharded_red_black_tree_t;
+
+/* Creates an empty sharded tree with number_splits + 1 shards, split
+   at the given keys, which must be sorted in strictly ascending
+   order. The split keys are copied with copy_key, passing in the
+   data pointer.
+
+*/
+sharded_red_black_tree_t sharded_red_black_tree_create(void **split_keys,
+                                                       size_t number_splits,
+                                                       void *(*copy_key)(void *, void *),
+                                                       void *data);
+
+/* Creates an empty sharded tree as sharded_red_black_tree_create,
+   whose shards store keys of key_size bytes and values of
+   value_size bytes inside their nodes, as red-black trees made by
+   red_black_tree_create_inline do. The split keys are copied
+   bytewise.
+
+   The copy_key, copy_value, delete_key and delete_value arguments
+   of all other functions are ignored for such a tree and may be
+   NULL, so inserts and removals need no allocation besides the
+   shard's slab arena.
+
+*/
+sharded_red_black_tree_t sharded_red_black_tree_create_inline(void **split_keys,
+                                                              size_t number_splits,
+                                                              size_t key_size,
+                                                              size_t value_size);
+
+/* Deletes a sharded tree, calling delete_key and delete_value on
+   each key resp. value, split keys included, passing in the data
+   pointer.
+
+   No other thread may use the tree concurrently. Either function
+   may be NULL if the keys resp. values need no cleanup.
+*/
+void sharded_red_black_tree_delete(sharded_red_black_tree_t tree,
+                                   void (*delete_key)(void *, void *),
+                                   void (*delete_value)(void *, void *),
+                                   void *data);
+
+/* Returns the number of shards of a sharded tree */
+size_t sharded_red_black_tree_number_shards(sharded_red_black_tree_t tree);
+
+/* Returns the number of entries in a sharded tree
+
+   Locks one shard at a time, so the count need not match any
+   single point in time if other threads write concurrently.
+
+*/
+size_t sharded_red_black_tree_number_entries(sharded_red_black_tree_t tree);
+
+/* Searches a sharded tree for a key, comparing keys with
+   compare_key, returning the associated value.
+
+   Returns NULL if the sought for key cannot be found. The value
+   stays valid until the key gets removed.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void *sharded_red_black_tree_search(sharded_red_black_tree_t tree,
+                                    void *key,
+                                    int (*compare_key)(void *, void *, void *),
+                                    void *data);
+
+/* Returns the minimum key and associated value over all shards.
+
+   Returns NULL for both the key and the value if the
+   tree is empty.
+
+*/
+void sharded_red_black_tree_minimum(void **min_key,
+                                    void **min_value,
+                                    sharded_red_black_tree_t tree);
+
+/* Returns the maximum key and associated value over all shards.
+
+   Returns NULL for both the key and the value if the
+   tree is empty.
+
+*/
+void sharded_red_black_tree_maximum(void **max_key,
+                                    void **max_value,
+                                    sharded_red_black_tree_t tree);
+
+/* Visits the entries with lo <= key < hi in key order across the
+   shards, calling visitor on each key and value with the data
+   pointer.
+
+   A NULL lo resp. hi leaves the range unbounded on that side.
+   The scan stops early as soon as visitor returns a non-zero
+   value. If visitor is NULL, the entries are only counted.
+
+   Each shard is read-locked while it is being scanned, so the
+   entries of one shard come from a single point in time, while
+   shards scanned later may reflect later writes. visitor must not
+   modify the tree.
+
+   Returns the number of entries visited, including the one on
+   which the scan was stopped.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+size_t sharded_red_black_tree_range_foreach(sharded_red_black_tree_t tree,
+                                            void *lo,
+                                            void *hi,
+                                            int (*compare_key)(void *, void *, void *),
+                                            int (*visitor)(void *, void *, void *),
+                                            void *data);
+
+/* Inserts a key and an associated value into a sharded tree,
+   comparing the keys with compare_key and copying the key and value
+   with the copy_key resp. copy_value functions.
+
+   The tree is left unchanged if the key is already present.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void sharded_red_black_tree_insert(sharded_red_black_tree_t tree,
+                                   void *key,
+                                   void *value,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void *(*copy_key)(void *, void *),
+                                   void *(*copy_value)(void *, void *),
+                                   void *data);
+
+/* Removes a key and the associated value in a sharded tree,
+   comparing the keys with compare_key and deleting the key and
+   value with the delete_key resp. delete_value function.
+
+   compare_key takes two keys and the data pointer in
+   argument. It returns -1, 0, 1 depending on the
+   ordering of the two keys.
+
+*/
+void sharded_red_black_tree_remove(sharded_red_black_tree_t tree,
+                                   void *key,
+                                   int (*compare_key)(void *, void *, void *),
+                                   void (*delete_key)(void *, void *),
+                                   void (*delete_value)(void *, void *),
+                                   void *data);
+
+#endif
@@ -0,0 +1,109 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "shardedredblacktrees.h"
+
+#define NUM_VALUES 2000000
+#define MAX_THREADS 8
+#define MAX_SHARDS 64
+
+int compare_int(void *a, void *b, void *data)
+{
+    int *ia = (int *)a;
+    int *ib = (int *)b;
+    return (*ia > *ib) - (*ia < *ib);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static sharded_red_black_tree_t tree;
+static int *keys;
+static int num_threads;
+
+// Each writer inserts, then removes, its share of the keys.
+static void *writer(void *arg)
+{
+    int id = (int)(size_t)arg;
+    int lo = (int)((long long)NUM_VALUES * id / num_threads);
+    int hi = (int)((long long)NUM_VALUES * (id + 1) / num_threads);
+
+    for (int i = lo; i < hi; i++)
+        sharded_red_black_tree_insert(tree, &keys[i], &keys[i], compare_int, NULL, NULL, NULL);
+    for (int i = lo; i < hi; i++)
+        sharded_red_black_tree_remove(tree, &keys[i], compare_int, NULL, NULL, NULL);
+    return NULL;
+}
+
+static double run(int number_shards, int threads)
+{
+    int splits[MAX_SHARDS];
+    void *split_keys[MAX_SHARDS];
+    pthread_t writers[MAX_THREADS];
+
+    // Keys are uniform over [0, RAND_MAX], so even splits balance the shards.
+    for (int i = 0; i < number_shards - 1; i++)
+    {
+        splits[i] = (int)((long long)RAND_MAX * (i + 1) / number_shards);
+        split_keys[i] = &splits[i];
+    }
+    tree = sharded_red_black_tree_create_inline(split_keys, number_shards - 1, sizeof(int), sizeof(int));
+    num_threads = threads;
+
+    double start = now();
+    for (int i = 0; i < threads; i++)
+        pthread_create(&writers[i], NULL, writer, (void *)(size_t)i);
+    for (int i = 0; i < threads; i++)
+        pthread_join(writers[i], NULL);
+    double elapsed = now() - start;
+
+    if (sharded_red_black_tree_number_entries(tree) != 0)
+    {
+        fprintf(stderr, "Error: entries left in the tree.\n");
+        exit(1);
+    }
+    sharded_red_black_tree_delete(tree, NULL, NULL, NULL);
+
+    return 2.0 * NUM_VALUES / elapsed;
+}
+
+int main()
+{
+    keys = (int *)malloc(NUM_VALUES * sizeof(int));
+    if (keys == NULL)
+    {
+        fprintf(stderr, "Error: no memory left.\n");
+        exit(1);
+    }
+
+    srand(time(NULL));
+    for (int i = 0; i < NUM_VALUES; i++)
+        keys[i] = rand();
+
+    printf("%d uniform keys inserted, then removed.\n", NUM_VALUES);
+
+    FILE *outputFile = fopen("Sharded_writers_data.csv", "w");
+
+    fprintf(outputFile, "Writers,1 Shard Ops per s,%d Shards Ops per s\n", MAX_SHARDS);
+
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        double single = run(1, threads);
+        double sharded = run(MAX_SHARDS, threads);
+
+        printf("%d writers: 1 shard %.2f M ops/s, %d shards %.2f M ops/s\n",
+               threads, single / 1e6, MAX_SHARDS, sharded / 1e6);
+        fprintf(outputFile, "%d,%.0f,%.0f\n", threads, single, sharded);
+    }
+
+    fclose(outputFile);
+    free(keys);
+
+    return 0;
+}
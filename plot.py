@@ -5,16 +5,24 @@ import numpy as np
 # Read the data from the CSV files
 search_data = pd.read_csv('SearchTrees/BST_tree_data.csv')
 rb_data = pd.read_csv('RedBlackTrees/RB_tree_data.csv')
+aa_data = pd.read_csv('AATrees/AA_tree_data.csv')
+bp_data = pd.read_csv('BPlusTrees/BP_tree_data.csv')
 
 search_entries = search_data['Number of Entries']
 search_height = search_data['Tree Height']
 rb_entries = rb_data['Number of Entries']
 rb_height = rb_data['Tree Height']
+aa_entries = aa_data['Number of Entries']
+aa_height = aa_data['Tree Height']
+bp_entries = bp_data['Number of Entries']
+bp_height = bp_data['Tree Height']
 optimal_height = np.log2(search_entries)
 
 plt.figure(figsize=(10, 6))
 plt.plot(search_entries, search_height, label='Search Tree')
 plt.plot(rb_entries, rb_height, label='RB Tree')
+plt.plot(aa_entries, aa_height, label='AA Tree')
+plt.plot(bp_entries, bp_height, label='B+ Tree')
 plt.plot(search_entries, optimal_height, label='Optimal Height', linestyle='--')
 
 
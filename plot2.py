@@ -4,17 +4,23 @@ import numpy as np
 
 search_data = pd.read_csv('SearchTrees/BST_tree_data_removal.csv')
 rb_data = pd.read_csv('RedBlackTrees/RB_tree_data_removal.csv')
+aa_data = pd.read_csv('AATrees/AA_tree_data_removal.csv')
+bp_data = pd.read_csv('BPlusTrees/BP_tree_data_removal.csv')
 
 search_data = search_data.iloc[::-1]
 rb_data = rb_data.iloc[::-1]
+aa_data = aa_data.iloc[::-1]
+bp_data = bp_data.iloc[::-1]
 
 plt.figure(figsize=(10, 5))
 plt.plot(search_data['Number of Entries'], search_data['Tree Height'], label='BST', color='blue', marker='o')
 
 plt.plot(rb_data['Number of Entries'], rb_data['Tree Height'], label='Red-Black Tree', color='red', marker='x')
+plt.plot(aa_data['Number of Entries'], aa_data['Tree Height'], label='AA Tree', color='orange', marker='+')
+plt.plot(bp_data['Number of Entries'], bp_data['Tree Height'], label='B+ Tree', color='purple', marker='.')
 plt.plot(search_data['Number of Entries'], np.log2(search_data['Number of Entries']), label='log2(entries)', linestyle='--', color='green')
 
-plt.title('Height vs. Entries for BST and Red-Black Tree (Removal)')
+plt.title('Height vs. Entries for BST, Red-Black, AA and B+ Tree (Removal)')
 plt.xlabel('Number of Entries')
 plt.ylabel('Tree Height')
 plt.gca().invert_xaxis()